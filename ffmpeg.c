@@ -123,7 +123,14 @@ const char *const forced_keyframes_const_names[] = {
     NULL
 };
 
-static void do_video_stats(OutputStream *ost, int frame_size);
+/* quality stats of an encoded video packet */
+typedef struct VideoStats {
+    int quality;
+    int pict_type;
+    int64_t error[4];
+} VideoStats;
+
+static void do_video_stats(OutputStream *ost, const VideoStats *stats, int frame_size);
 static int64_t getutime(void);
 static int64_t getmaxrss(void);
 
@@ -159,6 +166,7 @@ static int restore_tty;
 
 #if HAVE_PTHREADS
 static void free_input_threads(void);
+static void free_encoder_threads(void);
 #endif
 
 /* sub2video hack:
@@ -475,6 +483,10 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_PTHREADS
+    free_encoder_threads();
+#endif
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
@@ -567,6 +579,7 @@ static void ffmpeg_cleanup(int ret)
     if (vstats_file)
         fclose(vstats_file);
     av_freep(&vstats_filename);
+    av_freep(&filter_thread_type);
 
     av_freep(&input_streams);
     av_freep(&input_files);
@@ -636,6 +649,23 @@ static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream,
     }
 }
 
+static void get_video_stats(VideoStats *stats, AVPacket *pkt)
+{
+    uint8_t *sd = av_packet_get_side_data(pkt, AV_PKT_DATA_QUALITY_STATS,
+                                          NULL);
+    int i;
+
+    stats->quality   = sd ? AV_RL32(sd) : -1;
+    stats->pict_type = sd ? sd[4] : AV_PICTURE_TYPE_NONE;
+
+    for (i = 0; i<FF_ARRAY_ELEMS(stats->error); i++) {
+        if (sd && i < sd[5])
+            stats->error[i] = AV_RL64(sd + 8 + 8*i);
+        else
+            stats->error[i] = -1;
+    }
+}
+
 static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
 {
     AVBitStreamFilterContext *bsfc = ost->bitstream_filters;
@@ -669,18 +699,11 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
         ost->frame_number++;
     }
     if (avctx->codec_type == AVMEDIA_TYPE_VIDEO) {
-        int i;
-        uint8_t *sd = av_packet_get_side_data(pkt, AV_PKT_DATA_QUALITY_STATS,
-                                              NULL);
-        ost->quality = sd ? AV_RL32(sd) : -1;
-        ost->pict_type = sd ? sd[4] : AV_PICTURE_TYPE_NONE;
-
-        for (i = 0; i<FF_ARRAY_ELEMS(ost->error); i++) {
-            if (sd && i < sd[5])
-                ost->error[i] = AV_RL64(sd + 8 + 8*i);
-            else
-                ost->error[i] = -1;
-        }
+        VideoStats stats;
+        get_video_stats(&stats, pkt);
+        ost->quality   = stats.quality;
+        ost->pict_type = stats.pict_type;
+        memcpy(ost->error, stats.error, sizeof(ost->error));
     }
 
     if (bsfc)
@@ -814,6 +837,155 @@ static int check_recording_time(OutputStream *ost)
     return 1;
 }
 
+#if HAVE_PTHREADS
+/* maximum number of frames in flight for each encoder thread */
+#define ENCODER_THREAD_QUEUE_SIZE 8
+
+typedef struct EncoderJob {
+    AVFrame *frame;
+    int64_t sync_opts;          /* ost->sync_opts when the frame was sent */
+} EncoderJob;
+
+typedef struct EncoderResult {
+    AVPacket pkt;
+    int got_packet;
+    int ret;
+    int64_t sync_opts;
+    char *stats_out;            /* copy of the encoder stats_out for 2-pass */
+    VideoStats stats;           /* quality stats of the packet, for -vstats */
+} EncoderResult;
+
+/* check whether the encoder of ost can run in its own thread */
+static int use_encoder_thread(OutputStream *ost)
+{
+    AVFormatContext *s = output_files[ost->file_index]->ctx;
+    AVCodecContext *enc = ost->enc_ctx;
+
+    if (!ost->encoding_needed)
+        return 0;
+    if (enc->codec_type == AVMEDIA_TYPE_AUDIO)
+        return 1;
+    /* raw pictures are passed to the muxer without encoding */
+    return enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+           !(s->oformat->flags & AVFMT_RAWPICTURE &&
+             enc->codec->id == AV_CODEC_ID_RAWVIDEO);
+}
+
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    EncoderJob job;
+    EncoderResult res;
+    int ret;
+
+    while (av_thread_message_queue_recv(ost->enc_in_queue, &job, 0) >= 0) {
+        memset(&res, 0, sizeof(res));
+        av_init_packet(&res.pkt);
+        res.pkt.data  = NULL;
+        res.pkt.size  = 0;
+        res.sync_opts = job.sync_opts;
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO)
+            res.ret = avcodec_encode_video2(enc, &res.pkt, job.frame, &res.got_packet);
+        else
+            res.ret = avcodec_encode_audio2(enc, &res.pkt, job.frame, &res.got_packet);
+        av_frame_free(&job.frame);
+
+        if (res.ret >= 0 && res.got_packet && enc->stats_out)
+            res.stats_out = av_strdup(enc->stats_out);
+        if (res.ret >= 0 && res.got_packet && vstats_filename &&
+            enc->codec_type == AVMEDIA_TYPE_VIDEO)
+            get_video_stats(&res.stats, &res.pkt);
+
+        ret = av_thread_message_queue_send(ost->enc_out_queue, &res, 0);
+        if (ret < 0) {
+            av_free_packet(&res.pkt);
+            av_freep(&res.stats_out);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* move one result from the encoder thread to the results fifo */
+static void encoder_thread_receive(OutputStream *ost)
+{
+    EncoderResult res;
+    int ret;
+
+    ret = av_thread_message_queue_recv(ost->enc_out_queue, &res, 0);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Error receiving from the encoder thread: %s\n",
+               av_err2str(ret));
+        exit_program(1);
+    }
+    ost->enc_pending--;
+
+    if (!av_fifo_space(ost->enc_results)) {
+        ret = av_fifo_realloc2(ost->enc_results, 2 * av_fifo_size(ost->enc_results));
+        if (ret < 0) {
+            av_free_packet(&res.pkt);
+            av_freep(&res.stats_out);
+            exit_program(1);
+        }
+    }
+    av_fifo_generic_write(ost->enc_results, &res, sizeof(res), NULL);
+}
+
+/* wait until the encoder thread is idle, keeping its results for later */
+static void encoder_thread_wait(OutputStream *ost)
+{
+    if (!ost->enc_in_queue)
+        return;
+    while (ost->enc_pending > 0)
+        encoder_thread_receive(ost);
+}
+
+static void encoder_thread_send(OutputStream *ost, AVFrame *frame)
+{
+    EncoderJob job;
+    int ret;
+
+    /* make sure neither queue can fill up while we are not receiving */
+    while (ost->enc_pending >= ENCODER_THREAD_QUEUE_SIZE)
+        encoder_thread_receive(ost);
+
+    job.sync_opts = ost->sync_opts;
+    job.frame     = av_frame_clone(frame);
+    if (!job.frame) {
+        av_log(NULL, AV_LOG_FATAL, "Could not allocate frame\n");
+        exit_program(1);
+    }
+
+    ret = av_thread_message_queue_send(ost->enc_in_queue, &job, 0);
+    if (ret < 0) {
+        av_frame_free(&job.frame);
+        av_log(NULL, AV_LOG_FATAL, "Error sending a frame to the encoder thread: %s\n",
+               av_err2str(ret));
+        exit_program(1);
+    }
+    ost->enc_pending++;
+}
+#endif
+
+static void audio_encoded_out(AVFormatContext *s, OutputStream *ost, AVPacket *pkt)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+
+    av_packet_rescale_ts(pkt, enc->time_base, ost->st->time_base);
+
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder -> type:audio "
+               "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &ost->st->time_base),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &ost->st->time_base));
+    }
+
+    write_frame(s, pkt, ost);
+}
+
 static void do_audio_out(AVFormatContext *s, OutputStream *ost,
                          AVFrame *frame)
 {
@@ -843,24 +1015,21 @@ static void do_audio_out(AVFormatContext *s, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+#if HAVE_PTHREADS
+    if (ost->enc_in_queue) {
+        encoder_thread_send(ost, frame);
+        return;
+    }
+#endif
+
     if (avcodec_encode_audio2(enc, &pkt, frame, &got_packet) < 0) {
         av_log(NULL, AV_LOG_FATAL, "Audio encoding failed (avcodec_encode_audio2)\n");
         exit_program(1);
     }
     update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
 
-    if (got_packet) {
-        av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
-
-        if (debug_ts) {
-            av_log(NULL, AV_LOG_INFO, "encoder -> type:audio "
-                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                   av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->st->time_base),
-                   av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->st->time_base));
-        }
-
-        write_frame(s, &pkt, ost);
-    }
+    if (got_packet)
+        audio_encoded_out(s, ost, &pkt);
 }
 
 static void do_subtitle_out(AVFormatContext *s,
@@ -947,6 +1116,44 @@ static void do_subtitle_out(AVFormatContext *s,
     }
 }
 
+/* send an encoded video packet to the muxer, return its size */
+static int video_encoded_out(AVFormatContext *s, OutputStream *ost,
+                             AVPacket *pkt, int64_t sync_opts,
+                             const char *stats_out)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    int frame_size;
+
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+               "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
+    }
+
+    if (pkt->pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+        pkt->pts = sync_opts;
+
+    av_packet_rescale_ts(pkt, enc->time_base, ost->st->time_base);
+
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+            "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+            av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &ost->st->time_base),
+            av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &ost->st->time_base));
+    }
+
+    frame_size = pkt->size;
+    write_frame(s, pkt, ost);
+
+    /* if two pass, output log */
+    if (ost->logfile && stats_out) {
+        fprintf(ost->logfile, "%s", stats_out);
+    }
+
+    return frame_size;
+}
+
 static void do_video_out(AVFormatContext *s,
                          OutputStream *ost,
                          AVFrame *next_picture,
@@ -960,6 +1167,7 @@ static void do_video_out(AVFormatContext *s,
     double delta, delta0;
     double duration = 0;
     int frame_size = 0;
+    VideoStats stats;
     InputStream *ist = NULL;
     AVFilterContext *filter = ost->filter->filter;
 
@@ -1192,39 +1400,23 @@ static void do_video_out(AVFormatContext *s,
 
         ost->frames_encoded++;
 
-        ret = avcodec_encode_video2(enc, &pkt, in_picture, &got_packet);
-        update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
-        if (ret < 0) {
-            av_log(NULL, AV_LOG_FATAL, "Video encoding failed\n");
-            exit_program(1);
-        }
-
-        if (got_packet) {
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
-                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
-            }
-
-            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt.pts = ost->sync_opts;
-
-            av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
-
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->st->time_base),
-                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->st->time_base));
+#if HAVE_PTHREADS
+        if (ost->enc_in_queue) {
+            encoder_thread_send(ost, in_picture);
+        } else
+#endif
+        {
+            ret = avcodec_encode_video2(enc, &pkt, in_picture, &got_packet);
+            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_FATAL, "Video encoding failed\n");
+                exit_program(1);
             }
 
-            frame_size = pkt.size;
-            write_frame(s, &pkt, ost);
-
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
+            if (got_packet) {
+                get_video_stats(&stats, &pkt);
+                frame_size = video_encoded_out(s, ost, &pkt, ost->sync_opts,
+                                               enc->stats_out);
             }
         }
     }
@@ -1237,7 +1429,7 @@ static void do_video_out(AVFormatContext *s,
     ost->frame_number++;
 
     if (vstats_filename && frame_size)
-        do_video_stats(ost, frame_size);
+        do_video_stats(ost, &stats, frame_size);
   }
 
     if (!ost->last_frame)
@@ -1254,7 +1446,7 @@ static double psnr(double d)
     return -10.0 * log(d) / log(10.0);
 }
 
-static void do_video_stats(OutputStream *ost, int frame_size)
+static void do_video_stats(OutputStream *ost, const VideoStats *stats, int frame_size)
 {
     AVCodecContext *enc;
     int frame_number;
@@ -1273,10 +1465,10 @@ static void do_video_stats(OutputStream *ost, int frame_size)
     if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
         frame_number = ost->st->nb_frames;
         fprintf(vstats_file, "frame= %5d q= %2.1f ", frame_number,
-                ost->quality / (float)FF_QP2LAMBDA);
+                stats->quality / (float)FF_QP2LAMBDA);
 
-        if (ost->error[0]>=0 && (enc->flags & AV_CODEC_FLAG_PSNR))
-            fprintf(vstats_file, "PSNR= %6.2f ", psnr(ost->error[0] / (enc->width * enc->height * 255.0 * 255.0)));
+        if (stats->error[0]>=0 && (enc->flags & AV_CODEC_FLAG_PSNR))
+            fprintf(vstats_file, "PSNR= %6.2f ", psnr(stats->error[0] / (enc->width * enc->height * 255.0 * 255.0)));
 
         fprintf(vstats_file,"f_size= %6d ", frame_size);
         /* compute pts value */
@@ -1288,7 +1480,7 @@ static void do_video_stats(OutputStream *ost, int frame_size)
         avg_bitrate = (double)(ost->data_size * 8) / ti1 / 1000.0;
         fprintf(vstats_file, "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
                (double)ost->data_size / 1024, ti1, bitrate, avg_bitrate);
-        fprintf(vstats_file, "type= %c\n", av_get_picture_type_char(ost->pict_type));
+        fprintf(vstats_file, "type= %c\n", av_get_picture_type_char(stats->pict_type));
     }
 }
 
@@ -1311,6 +1503,41 @@ static void finish_output_stream(OutputStream *ost)
  *
  * @return  0 for success, <0 for severe errors
  */
+#if HAVE_PTHREADS
+/* wait for the encoder thread and send all its results to the muxer, in order */
+static void encoder_thread_collect(OutputStream *ost)
+{
+    AVFormatContext *s = output_files[ost->file_index]->ctx;
+    EncoderResult res;
+    int frame_size;
+
+    encoder_thread_wait(ost);
+
+    while (av_fifo_size(ost->enc_results) >= sizeof(res)) {
+        av_fifo_generic_read(ost->enc_results, &res, sizeof(res), NULL);
+
+        if (res.ret < 0) {
+            av_freep(&res.stats_out);
+            av_log(NULL, AV_LOG_FATAL, "%s encoding failed\n",
+                   ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO ? "Video" : "Audio");
+            exit_program(1);
+        }
+        if (!res.got_packet)
+            continue;
+
+        if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+            frame_size = video_encoded_out(s, ost, &res.pkt, res.sync_opts,
+                                           res.stats_out);
+            if (vstats_filename && frame_size)
+                do_video_stats(ost, &res.stats, frame_size);
+        } else {
+            audio_encoded_out(s, ost, &res.pkt);
+        }
+        av_freep(&res.stats_out);
+    }
+}
+#endif
+
 static int reap_filters(int flush)
 {
     AVFrame *filtered_frame = NULL;
@@ -1373,8 +1600,14 @@ static int reap_filters(int flush)
 
             switch (filter->inputs[0]->type) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
+                if (!ost->frame_aspect_ratio.num &&
+                    av_cmp_q(enc->sample_aspect_ratio, filtered_frame->sample_aspect_ratio)) {
+#if HAVE_PTHREADS
+                    /* the encoder thread may be using the context */
+                    encoder_thread_wait(ost);
+#endif
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
+                }
 
                 if (debug_ts) {
                     av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
@@ -1403,6 +1636,12 @@ static int reap_filters(int flush)
         }
     }
 
+#if HAVE_PTHREADS
+    for (i = 0; i < nb_output_streams; i++)
+        if (output_streams[i]->enc_in_queue)
+            encoder_thread_collect(output_streams[i]);
+#endif
+
     return 0;
 }
 
@@ -1736,6 +1975,7 @@ static void flush_encoders(void)
 
             if (encode) {
                 AVPacket pkt;
+                VideoStats stats;
                 int pkt_size;
                 int got_packet;
                 av_init_packet(&pkt);
@@ -1760,11 +2000,13 @@ static void flush_encoders(void)
                     av_free_packet(&pkt);
                     continue;
                 }
+                if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename)
+                    get_video_stats(&stats, &pkt);
                 av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
                 pkt_size = pkt.size;
                 write_frame(os, &pkt, ost);
                 if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename) {
-                    do_video_stats(ost, pkt_size);
+                    do_video_stats(ost, &stats, pkt_size);
                 }
             }
 
@@ -3553,6 +3795,80 @@ static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
                                         f->non_blocking ?
                                         AV_THREAD_MESSAGE_NONBLOCK : 0);
 }
+
+static void free_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        EncoderJob job;
+        EncoderResult res;
+
+        if (!ost || !ost->enc_in_queue)
+            continue;
+        av_thread_message_queue_set_err_recv(ost->enc_in_queue, AVERROR_EOF);
+        av_thread_message_queue_set_err_send(ost->enc_out_queue, AVERROR_EOF);
+        while (av_thread_message_queue_recv(ost->enc_in_queue, &job, AV_THREAD_MESSAGE_NONBLOCK) >= 0)
+            av_frame_free(&job.frame);
+
+        pthread_join(ost->enc_thread, NULL);
+
+        while (av_thread_message_queue_recv(ost->enc_out_queue, &res, AV_THREAD_MESSAGE_NONBLOCK) >= 0) {
+            av_free_packet(&res.pkt);
+            av_freep(&res.stats_out);
+        }
+        while (av_fifo_size(ost->enc_results) >= sizeof(res)) {
+            av_fifo_generic_read(ost->enc_results, &res, sizeof(res), NULL);
+            av_free_packet(&res.pkt);
+            av_freep(&res.stats_out);
+        }
+        av_fifo_freep(&ost->enc_results);
+        av_thread_message_queue_free(&ost->enc_in_queue);
+        av_thread_message_queue_free(&ost->enc_out_queue);
+        ost->enc_pending = 0;
+    }
+}
+
+static int init_encoder_threads(void)
+{
+    int i, ret, nb_encoders = 0;
+
+    if (!encoder_threads)
+        return 0;
+    for (i = 0; i < nb_output_streams; i++)
+        nb_encoders += use_encoder_thread(output_streams[i]);
+    if (nb_encoders < 2)
+        return 0;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!use_encoder_thread(ost))
+            continue;
+
+        ost->enc_results = av_fifo_alloc(ENCODER_THREAD_QUEUE_SIZE * sizeof(EncoderResult));
+        if (!ost->enc_results)
+            return AVERROR(ENOMEM);
+        if ((ret = av_thread_message_queue_alloc(&ost->enc_in_queue,
+                                                 ENCODER_THREAD_QUEUE_SIZE,
+                                                 sizeof(EncoderJob))) < 0 ||
+            (ret = av_thread_message_queue_alloc(&ost->enc_out_queue,
+                                                 ENCODER_THREAD_QUEUE_SIZE,
+                                                 sizeof(EncoderResult))) < 0) {
+            av_thread_message_queue_free(&ost->enc_in_queue);
+            return ret;
+        }
+
+        if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            av_thread_message_queue_free(&ost->enc_in_queue);
+            av_thread_message_queue_free(&ost->enc_out_queue);
+            return AVERROR(ret);
+        }
+    }
+    return 0;
+}
 #endif
 
 static int get_input_packet(InputFile *f, AVPacket *pkt)
@@ -3936,6 +4252,8 @@ static int transcode(void)
 #if HAVE_PTHREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if ((ret = init_encoder_threads()) < 0)
+        goto fail;
 #endif
 
     while (!received_sigterm) {
@@ -3979,6 +4297,9 @@ static int transcode(void)
             process_input_packet(ist, NULL);
         }
     }
+#if HAVE_PTHREADS
+    free_encoder_threads();
+#endif
     flush_encoders();
 
     term_exit();
@@ -4016,6 +4337,7 @@ static int transcode(void)
  fail:
 #if HAVE_PTHREADS
     free_input_threads();
+    free_encoder_threads();
 #endif
 
     if (output_streams) {
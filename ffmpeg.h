@@ -467,6 +467,14 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *enc_in_queue;  /* frames sent to the encoder thread */
+    AVThreadMessageQueue *enc_out_queue; /* results sent back by the encoder thread */
+    pthread_t enc_thread;       /* thread running the encoder of this stream */
+    int enc_pending;            /* number of frames whose result was not received yet */
+    AVFifoBuffer *enc_results;  /* received results not yet sent to the muxer */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -494,6 +502,7 @@ extern FilterGraph **filtergraphs;
 extern int        nb_filtergraphs;
 
 extern char *vstats_filename;
+extern char *filter_thread_type;
 extern char *sdp_filename;
 
 extern float audio_drift_threshold;
@@ -517,6 +526,7 @@ extern int exit_on_error;
 extern int print_stats;
 extern int qp_hist;
 extern int stdin_interaction;
+extern int encoder_threads;
 extern int frame_bits_per_raw_sample;
 extern AVIOContext *progress_avio;
 extern float max_error_rate;
@@ -956,6 +956,13 @@ int configure_filtergraph(FilterGraph *fg)
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
 
+    if (filter_thread_type &&
+        (ret = av_opt_set(fg->graph, "thread_type", filter_thread_type, 0)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid filter thread type '%s'\n",
+               filter_thread_type);
+        return ret;
+    }
+
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
         char args[512];
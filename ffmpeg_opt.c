@@ -84,6 +84,7 @@ const HWAccel hwaccels[] = {
 
 char *vstats_filename;
 char *sdp_filename;
+char *filter_thread_type;
 
 float audio_drift_threshold = 0.1;
 float dts_delta_threshold   = 10;
@@ -106,6 +107,7 @@ int exit_on_error     = 0;
 int print_stats       = -1;
 int qp_hist           = 0;
 int stdin_interaction = 1;
+int encoder_threads   = 0;
 int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 
@@ -3059,6 +3061,8 @@ const OptionDef options[] = {
       "write program-readable progress information", "url" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
       "enable or disable interaction on standard input" },
+    { "encoder_threads", OPT_BOOL | OPT_EXPERT,                      { &encoder_threads },
+      "run the encoder of each output stream in its own thread" },
     { "timelimit",      HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_timelimit },
         "set max runtime in seconds", "limit" },
     { "dump",           OPT_BOOL | OPT_EXPERT,                       { &do_pkt_dump },
@@ -3127,6 +3131,8 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
         "read complex filtergraph description from a file", "filename" },
+    { "filter_thread_type", HAS_ARG | OPT_STRING | OPT_EXPERT,        { &filter_thread_type },
+        "set the allowed thread types of filtergraphs", "flags" },
     { "stats",          OPT_BOOL,                                    { &print_stats },
         "print progress report during encoding", },
     { "attach",         HAS_ARG | OPT_PERFILE | OPT_EXPERT |
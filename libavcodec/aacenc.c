@@ -563,13 +563,76 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * Search the quantizers and the stereo coding of one channel element.
+ * Elements only read shared encoder state, so they run as slice jobs, each
+ * on its own copy of the context for the scratch buffers and cur_channel.
+ */
+static int search_element(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    AACEncContext *s = ((AACEncContext *)avctx->priv_data)->thread[threadnr];
+    ChannelElement *cpe = &s->cpe[jobnr];
+    const int tag   = s->chan_map[jobnr + 1];
+    const int chans = tag == TYPE_CPE ? 2 : 1;
+    FFPsyWindowInfo *wi = arg;
+    int i, ch, w, g, start_ch = 0;
+
+    for (i = 0; i < jobnr; i++)
+        start_ch += s->chan_map[i + 1] == TYPE_CPE ? 2 : 1;
+    wi += start_ch;
+
+    memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
+    memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
+    for (ch = 0; ch < chans; ch++) {
+        s->cur_channel = start_ch + ch;
+        s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
+    }
+    cpe->common_window = 0;
+    if (chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    if (s->options.pns && s->coder->search_for_pns) {
+        for (ch = 0; ch < chans; ch++) {
+            s->cur_channel = start_ch + ch;
+            s->coder->search_for_pns(s, avctx, &cpe->ch[ch]);
+        }
+    }
+    s->cur_channel = start_ch;
+    if (s->options.stereo_mode && cpe->common_window) {
+        if (s->options.stereo_mode > 0) {
+            IndividualChannelStream *ics = &cpe->ch[0].ics;
+            for (w = 0; w < ics->num_windows; w += ics->group_len[w])
+                for (g = 0;  g < ics->num_swb; g++)
+                    cpe->ms_mask[w*16+g] = 1;
+        } else if (s->coder->search_for_ms) {
+            s->coder->search_for_ms(s, cpe);
+        }
+    }
+    if (chans > 1 && s->options.intensity_stereo && s->coder->search_for_is)
+        s->coder->search_for_is(s, avctx, cpe);
+    if (s->coder->set_special_band_scalefactors)
+        for (ch = 0; ch < chans; ch++)
+            s->coder->set_special_band_scalefactors(s, &cpe->ch[ch]);
+    adjust_frame_information(cpe, chans);
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
     AACEncContext *s = avctx->priv_data;
     float **samples = s->planar_samples, *samples2, *la, *overlap;
     ChannelElement *cpe;
-    int i, ch, w, g, chans, tag, start_ch, ret, ms_mode = 0, is_mode = 0;
+    int i, ch, w, chans, tag, start_ch, ret, ms_mode = 0, is_mode = 0;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
 
@@ -662,62 +725,31 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
         if ((avctx->frame_number & 0xFF)==1 && !(avctx->flags & AV_CODEC_FLAG_BITEXACT))
             put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
-            FFPsyWindowInfo* wi = windows + start_ch;
             const float *coeffs[2];
             tag      = s->chan_map[i+1];
             chans    = tag == TYPE_CPE ? 2 : 1;
             cpe      = &s->cpe[i];
-            memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
-            memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++)
                 coeffs[ch] = cpe->ch[ch].coeffs;
-            s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            cpe->common_window = 0;
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            if (s->options.pns && s->coder->search_for_pns) {
-                for (ch = 0; ch < chans; ch++) {
-                    s->cur_channel = start_ch + ch;
-                    s->coder->search_for_pns(s, avctx, &cpe->ch[ch]);
-                }
-            }
-            s->cur_channel = start_ch;
-            if (s->options.stereo_mode && cpe->common_window) {
-                if (s->options.stereo_mode > 0) {
-                    IndividualChannelStream *ics = &cpe->ch[0].ics;
-                    for (w = 0; w < ics->num_windows; w += ics->group_len[w])
-                        for (g = 0;  g < ics->num_swb; g++)
-                            cpe->ms_mask[w*16+g] = 1;
-                } else if (s->coder->search_for_ms) {
-                    s->coder->search_for_ms(s, cpe);
-                }
-            }
-            if (chans > 1 && s->options.intensity_stereo && s->coder->search_for_is) {
-                s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-            }
-            if (s->coder->set_special_band_scalefactors)
-                for (ch = 0; ch < chans; ch++)
-                    s->coder->set_special_band_scalefactors(s, &cpe->ch[ch]);
-            adjust_frame_information(cpe, chans);
+            s->psy.model->analyze(&s->psy, start_ch, coeffs, windows + start_ch);
+            start_ch += chans;
+        }
+        for (i = 1; i < s->nb_threads; i++)
+            memcpy(s->thread[i], s, sizeof(*s));
+        avctx->execute2(avctx, search_element, windows, NULL, s->chan_map[0]);
+
+        start_ch = 0;
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
+            if (chans > 1 && s->options.intensity_stereo && s->coder->search_for_is &&
+                cpe->is_mode)
+                is_mode = 1;
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -777,12 +809,15 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     ff_mdct_end(&s->mdct1024);
     ff_mdct_end(&s->mdct128);
     ff_psy_end(&s->psy);
     if (s->psypp)
         ff_psy_preprocess_end(s->psypp);
+    for (i = 1; i < s->nb_threads; i++)
+        av_freep(&s->thread[i]);
     av_freep(&s->buffer.samples);
     av_freep(&s->cpe);
     av_freep(&s->fdsp);
@@ -888,6 +923,19 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
 
     s->lambda = avctx->global_quality > 0 ? avctx->global_quality : 120;
 
+    /* channel elements are searched in parallel, a thread never gets more
+     * than one of them at a time */
+    s->thread[0]  = s;
+    s->nb_threads = FFMIN(FFMAX(avctx->thread_count, 1), s->chan_map[0]);
+    for (i = 1; i < s->nb_threads; i++) {
+        s->thread[i] = av_malloc(sizeof(*s));
+        if (!s->thread[i]) {
+            s->nb_threads = i;
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+
     ff_aac_tableinit();
 
     avctx->initial_padding = 1024;
@@ -944,7 +992,7 @@ AVCodec ff_aac_encoder = {
     .close          = aac_encode_end,
     .supported_samplerates = mpeg4audio_sample_rates,
     .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_EXPERIMENTAL,
+                      AV_CODEC_CAP_EXPERIMENTAL | AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &aacenc_class,
@@ -93,6 +93,9 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    struct AACEncContext *thread[MAX_ELEM_ID]; ///< per-thread copies of the context, thread[0] is the context itself
+    int nb_threads;                              ///< number of thread contexts
 } AACEncContext;
 
 void ff_aac_coder_init_mips(AACEncContext *c);
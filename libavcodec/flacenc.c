@@ -44,6 +44,7 @@
 #define MAX_PARTITIONS     (1 << MAX_PARTITION_ORDER)
 #define MAX_LPC_PRECISION  15
 #define MAX_LPC_SHIFT      15
+#define MAX_FRAME_THREADS   8
 
 enum CodingMode {
     CODING_MODE_RICE  = 4,
@@ -82,11 +83,11 @@ typedef struct FlacSubframe {
     int shift;
 
     RiceContext rc;
-    uint32_t rc_udata[FLAC_MAX_BLOCKSIZE];
-    uint64_t rc_sums[32][MAX_PARTITIONS];
+    uint32_t *rc_udata;
+    uint64_t (*rc_sums)[MAX_PARTITIONS];
 
-    int32_t samples[FLAC_MAX_BLOCKSIZE];
-    int32_t residual[FLAC_MAX_BLOCKSIZE+11];
+    int32_t *samples;
+    int32_t *residual;
 } FlacSubframe;
 
 typedef struct FlacFrame {
@@ -96,11 +97,20 @@ typedef struct FlacFrame {
     uint8_t crc8;
     int ch_mode;
     int verbatim_only;
+    uint32_t number;
+
+    /* The frames of a batch are encoded concurrently, so each one has its
+     * own buffers, sized for the block size and channels of the stream. */
+    LPCContext lpc_ctx;
+    PutBitContext pb;
+    int max_framesize;
+    uint8_t *buf;
+    int out_bytes;
+    int64_t pts;
 } FlacFrame;
 
 typedef struct FlacEncodeContext {
     AVClass *class;
-    PutBitContext pb;
     int channels;
     int samplerate;
     int sr_code[2];
@@ -112,10 +122,8 @@ typedef struct FlacEncodeContext {
     uint32_t frame_count;
     uint64_t sample_count;
     uint8_t md5sum[16];
-    FlacFrame frame;
     CompressionOptions options;
     AVCodecContext *avctx;
-    LPCContext lpc_ctx;
     struct AVMD5 *md5ctx;
     uint8_t *md5_buffer;
     unsigned int md5_buffer_size;
@@ -124,6 +132,14 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* Frames are queued into frames[0..nb_queued-1], encoded together, then
+     * returned one per call in the order they were queued. */
+    FlacFrame *frames[MAX_FRAME_THREADS];
+    int nb_threads;
+    int nb_queued;
+    int nb_encoded;
+    int next_out;
 } FlacEncodeContext;
 
 
@@ -234,6 +250,58 @@ static av_cold void dprint_compression_options(FlacEncodeContext *s)
 }
 
 
+static av_cold void free_frame(FlacEncodeContext *s, FlacFrame **pframe)
+{
+    FlacFrame *frame = *pframe;
+    int ch;
+
+    if (!frame)
+        return;
+    for (ch = 0; ch < s->channels; ch++) {
+        FlacSubframe *sub = &frame->subframes[ch];
+        av_freep(&sub->rc_udata);
+        av_freep(&sub->rc_sums);
+        av_freep(&sub->samples);
+        av_freep(&sub->residual);
+    }
+    ff_lpc_end(&frame->lpc_ctx);
+    av_freep(&frame->buf);
+    av_freep(pframe);
+}
+
+
+static av_cold int alloc_frame(FlacEncodeContext *s, FlacFrame **pframe)
+{
+    FlacFrame *frame;
+    int ch, ret;
+
+    frame = *pframe = av_mallocz(sizeof(*frame));
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    for (ch = 0; ch < s->channels; ch++) {
+        FlacSubframe *sub = &frame->subframes[ch];
+        sub->rc_udata = av_malloc_array(s->max_blocksize, sizeof(*sub->rc_udata));
+        sub->rc_sums  = av_malloc_array(32, sizeof(*sub->rc_sums));
+        sub->samples  = av_malloc_array(s->max_blocksize, sizeof(*sub->samples));
+        sub->residual = av_malloc_array(s->max_blocksize + 11, sizeof(*sub->residual));
+        if (!sub->rc_udata || !sub->rc_sums || !sub->samples || !sub->residual)
+            return AVERROR(ENOMEM);
+    }
+
+    if ((ret = ff_lpc_init(&frame->lpc_ctx, s->max_blocksize,
+                           s->options.max_prediction_order,
+                           FF_LPC_TYPE_LEVINSON)) < 0)
+        return ret;
+
+    frame->buf = av_malloc(s->max_framesize);
+    if (!frame->buf)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+
 static av_cold int flac_encode_init(AVCodecContext *avctx)
 {
     int freq = avctx->sample_rate;
@@ -430,25 +498,25 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
         }
     }
 
-    ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
-                      s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
-
     ff_bswapdsp_init(&s->bdsp);
     ff_flacdsp_init(&s->flac_dsp, avctx->sample_fmt, channels,
                     avctx->bits_per_raw_sample);
 
+    /* one frame is queued per thread, up to MAX_FRAME_THREADS */
+    s->nb_threads = av_clip(avctx->thread_count, 1, MAX_FRAME_THREADS);
+    for (i = 0; i < s->nb_threads; i++)
+        if ((ret = alloc_frame(s, &s->frames[i])) < 0)
+            return ret;
+
     dprint_compression_options(s);
 
-    return ret;
+    return 0;
 }
 
 
-static void init_frame(FlacEncodeContext *s, int nb_samples)
+static void init_frame(FlacEncodeContext *s, FlacFrame *frame, int nb_samples)
 {
     int i, ch;
-    FlacFrame *frame;
-
-    frame = &s->frame;
 
     for (i = 0; i < 16; i++) {
         if (nb_samples == ff_flac_blocksize_table[i]) {
@@ -488,16 +556,15 @@ static void init_frame(FlacEncodeContext *s, int nb_samples)
 /**
  * Copy channel-interleaved input samples into separate subframes.
  */
-static void copy_samples(FlacEncodeContext *s, const void *samples)
+static void copy_samples(FlacEncodeContext *s, FlacFrame *frame,
+                         const void *samples)
 {
     int i, j, ch;
-    FlacFrame *frame;
     int shift = av_get_bytes_per_sample(s->avctx->sample_fmt) * 8 -
                 s->avctx->bits_per_raw_sample;
 
 #define COPY_SAMPLES(bits) do {                                     \
     const int ## bits ## _t *samples0 = samples;                    \
-    frame = &s->frame;                                              \
     for (i = 0, j = 0; i < frame->blocksize; i++)                   \
         for (ch = 0; ch < s->channels; ch++, j++)                   \
             frame->subframes[ch].samples[i] = samples0[j] >> shift; \
@@ -524,8 +591,8 @@ static uint64_t rice_count_exact(const int32_t *res, int n, int k)
 }
 
 
-static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
-                                     int pred_order)
+static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacFrame *frame,
+                                     FlacSubframe *sub, int pred_order)
 {
     int p, porder, psize;
     int i, part_end;
@@ -541,7 +608,7 @@ static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
     if (sub->type == FLAC_SUBFRAME_CONSTANT) {
         count += sub->obits;
     } else if (sub->type == FLAC_SUBFRAME_VERBATIM) {
-        count += s->frame.blocksize * sub->obits;
+        count += frame->blocksize * sub->obits;
     } else {
         /* warm-up samples */
         count += pred_order * sub->obits;
@@ -555,7 +622,7 @@ static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
 
         /* partition order */
         porder = sub->rc.porder;
-        psize  = s->frame.blocksize >> porder;
+        psize  = frame->blocksize >> porder;
         count += 4;
 
         /* residual */
@@ -566,7 +633,7 @@ static uint64_t subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
             count += sub->rc.coding_mode;
             count += rice_count_exact(&sub->residual[i], part_end - i, k);
             i = part_end;
-            part_end = FFMIN(s->frame.blocksize, part_end + psize);
+            part_end = FFMIN(frame->blocksize, part_end + psize);
         }
     }
 
@@ -727,19 +794,19 @@ static int get_max_p_order(int max_porder, int n, int order)
 }
 
 
-static uint64_t find_subframe_rice_params(FlacEncodeContext *s,
+static uint64_t find_subframe_rice_params(FlacEncodeContext *s, FlacFrame *frame,
                                           FlacSubframe *sub, int pred_order)
 {
     int pmin = get_max_p_order(s->options.min_partition_order,
-                               s->frame.blocksize, pred_order);
+                               frame->blocksize, pred_order);
     int pmax = get_max_p_order(s->options.max_partition_order,
-                               s->frame.blocksize, pred_order);
+                               frame->blocksize, pred_order);
 
     uint64_t bits = 8 + pred_order * sub->obits + 2 + sub->rc.coding_mode;
     if (sub->type == FLAC_SUBFRAME_LPC)
         bits += 4 + 5 + pred_order * s->options.lpc_coeff_precision;
     bits += calc_rice_params(&sub->rc, sub->rc_udata, sub->rc_sums, pmin, pmax, sub->residual,
-                             s->frame.blocksize, pred_order, s->options.exact_rice_parameters);
+                             frame->blocksize, pred_order, s->options.exact_rice_parameters);
     return bits;
 }
 
@@ -795,17 +862,15 @@ static void encode_residual_fixed(int32_t *res, const int32_t *smp, int n,
 }
 
 
-static int encode_residual_ch(FlacEncodeContext *s, int ch)
+static int encode_residual_ch(FlacEncodeContext *s, FlacFrame *frame, int ch)
 {
     int i, n;
     int min_order, max_order, opt_order, omethod;
-    FlacFrame *frame;
     FlacSubframe *sub;
     int32_t coefs[MAX_LPC_ORDER][MAX_LPC_ORDER];
     int shift[MAX_LPC_ORDER];
     int32_t *res, *smp;
 
-    frame = &s->frame;
     sub   = &frame->subframes[ch];
     res   = sub->residual;
     smp   = sub->samples;
@@ -818,14 +883,14 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
     if (i == n) {
         sub->type = sub->type_code = FLAC_SUBFRAME_CONSTANT;
         res[0] = smp[0];
-        return subframe_count_exact(s, sub, 0);
+        return subframe_count_exact(s, frame, sub, 0);
     }
 
     /* VERBATIM */
     if (frame->verbatim_only || n < 5) {
         sub->type = sub->type_code = FLAC_SUBFRAME_VERBATIM;
         memcpy(res, smp, n * sizeof(int32_t));
-        return subframe_count_exact(s, sub, 0);
+        return subframe_count_exact(s, frame, sub, 0);
     }
 
     min_order  = s->options.min_prediction_order;
@@ -843,7 +908,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         bits[0]   = UINT32_MAX;
         for (i = min_order; i <= max_order; i++) {
             encode_residual_fixed(res, smp, n, i);
-            bits[i] = find_subframe_rice_params(s, sub, i);
+            bits[i] = find_subframe_rice_params(s, frame, sub, i);
             if (bits[i] < bits[opt_order])
                 opt_order = i;
         }
@@ -851,14 +916,14 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         sub->type_code = sub->type | sub->order;
         if (sub->order != max_order) {
             encode_residual_fixed(res, smp, n, sub->order);
-            find_subframe_rice_params(s, sub, sub->order);
+            find_subframe_rice_params(s, frame, sub, sub->order);
         }
-        return subframe_count_exact(s, sub, sub->order);
+        return subframe_count_exact(s, frame, sub, sub->order);
     }
 
     /* LPC */
     sub->type = FLAC_SUBFRAME_LPC;
-    opt_order = ff_lpc_calc_coefs(&s->lpc_ctx, smp, n, min_order, max_order,
+    opt_order = ff_lpc_calc_coefs(&frame->lpc_ctx, smp, n, min_order, max_order,
                                   s->options.lpc_coeff_precision, coefs, shift, s->options.lpc_type,
                                   s->options.lpc_passes, omethod,
                                   MAX_LPC_SHIFT, 0);
@@ -885,7 +950,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
                 s->flac_dsp.lpc32_encode(res, smp, n, order+1, coefs[order],
                                          shift[order]);
             }
-            bits[i] = find_subframe_rice_params(s, sub, order+1);
+            bits[i] = find_subframe_rice_params(s, frame, sub, order+1);
             if (bits[i] < bits[opt_index]) {
                 opt_index = i;
                 opt_order = order;
@@ -903,7 +968,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
             } else {
                 s->flac_dsp.lpc32_encode(res, smp, n, i+1, coefs[i], shift[i]);
             }
-            bits[i] = find_subframe_rice_params(s, sub, i+1);
+            bits[i] = find_subframe_rice_params(s, frame, sub, i+1);
             if (bits[i] < bits[opt_order])
                 opt_order = i;
         }
@@ -925,7 +990,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
                 } else {
                     s->flac_dsp.lpc16_encode(res, smp, n, i+1, coefs[i], shift[i]);
                 }
-                bits[i] = find_subframe_rice_params(s, sub, i+1);
+                bits[i] = find_subframe_rice_params(s, frame, sub, i+1);
                 if (bits[i] < bits[opt_order])
                     opt_order = i;
             }
@@ -966,7 +1031,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
                 } else {
                     s->flac_dsp.lpc32_encode(res, smp, n, opt_order, lpc_try, shift[opt_order-1]);
                 }
-                score = find_subframe_rice_params(s, sub, opt_order);
+                score = find_subframe_rice_params(s, frame, sub, opt_order);
                 if (score < best_score) {
                     best_score = score;
                     memcpy(coefs[opt_order-1], lpc_try, sizeof(*coefs));
@@ -988,13 +1053,13 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         s->flac_dsp.lpc32_encode(res, smp, n, sub->order, sub->coefs, sub->shift);
     }
 
-    find_subframe_rice_params(s, sub, sub->order);
+    find_subframe_rice_params(s, frame, sub, sub->order);
 
-    return subframe_count_exact(s, sub, sub->order);
+    return subframe_count_exact(s, frame, sub, sub->order);
 }
 
 
-static int count_frame_header(FlacEncodeContext *s)
+static int count_frame_header(FlacEncodeContext *s, FlacFrame *frame)
 {
     uint8_t av_unused tmp;
     int count;
@@ -1012,12 +1077,12 @@ static int count_frame_header(FlacEncodeContext *s)
     count = 32;
 
     /* coded frame number */
-    PUT_UTF8(s->frame_count, tmp, count += 8;)
+    PUT_UTF8(frame->number, tmp, count += 8;)
 
     /* explicit block size */
-    if (s->frame.bs_code[0] == 6)
+    if (frame->bs_code[0] == 6)
         count += 8;
-    else if (s->frame.bs_code[0] == 7)
+    else if (frame->bs_code[0] == 7)
         count += 16;
 
     /* explicit sample rate */
@@ -1030,15 +1095,15 @@ static int count_frame_header(FlacEncodeContext *s)
 }
 
 
-static int encode_frame(FlacEncodeContext *s)
+static int encode_frame(FlacEncodeContext *s, FlacFrame *frame)
 {
     int ch;
     uint64_t count;
 
-    count = count_frame_header(s);
+    count = count_frame_header(s, frame);
 
     for (ch = 0; ch < s->channels; ch++)
-        count += encode_residual_ch(s, ch);
+        count += encode_residual_ch(s, frame, ch);
 
     count += (8 - (count & 7)) & 7; // byte alignment
     count += 16;                    // CRC-16
@@ -1050,15 +1115,15 @@ static int encode_frame(FlacEncodeContext *s)
 }
 
 
-static void remove_wasted_bits(FlacEncodeContext *s)
+static void remove_wasted_bits(FlacEncodeContext *s, FlacFrame *frame)
 {
     int ch, i;
 
     for (ch = 0; ch < s->channels; ch++) {
-        FlacSubframe *sub = &s->frame.subframes[ch];
+        FlacSubframe *sub = &frame->subframes[ch];
         int32_t v         = 0;
 
-        for (i = 0; i < s->frame.blocksize; i++) {
+        for (i = 0; i < frame->blocksize; i++) {
             v |= sub->samples[i];
             if (v & 1)
                 break;
@@ -1067,7 +1132,7 @@ static void remove_wasted_bits(FlacEncodeContext *s)
         if (v && !(v & 1)) {
             v = av_ctz(v);
 
-            for (i = 0; i < s->frame.blocksize; i++)
+            for (i = 0; i < frame->blocksize; i++)
                 sub->samples[i] >>= v;
 
             sub->wasted = v;
@@ -1126,13 +1191,11 @@ static int estimate_stereo_mode(const int32_t *left_ch, const int32_t *right_ch,
 /**
  * Perform stereo channel decorrelation.
  */
-static void channel_decorrelation(FlacEncodeContext *s)
+static void channel_decorrelation(FlacEncodeContext *s, FlacFrame *frame)
 {
-    FlacFrame *frame;
     int32_t *left, *right;
     int i, n;
 
-    frame = &s->frame;
     n     = frame->blocksize;
     left  = frame->subframes[0].samples;
     right = frame->subframes[1].samples;
@@ -1178,96 +1241,93 @@ static void write_utf8(PutBitContext *pb, uint32_t val)
 }
 
 
-static void write_frame_header(FlacEncodeContext *s)
+static void write_frame_header(FlacEncodeContext *s, FlacFrame *frame)
 {
-    FlacFrame *frame;
     int crc;
 
-    frame = &s->frame;
-
-    put_bits(&s->pb, 16, 0xFFF8);
-    put_bits(&s->pb, 4, frame->bs_code[0]);
-    put_bits(&s->pb, 4, s->sr_code[0]);
+    put_bits(&frame->pb, 16, 0xFFF8);
+    put_bits(&frame->pb, 4, frame->bs_code[0]);
+    put_bits(&frame->pb, 4, s->sr_code[0]);
 
     if (frame->ch_mode == FLAC_CHMODE_INDEPENDENT)
-        put_bits(&s->pb, 4, s->channels-1);
+        put_bits(&frame->pb, 4, s->channels-1);
     else
-        put_bits(&s->pb, 4, frame->ch_mode + FLAC_MAX_CHANNELS - 1);
+        put_bits(&frame->pb, 4, frame->ch_mode + FLAC_MAX_CHANNELS - 1);
 
-    put_bits(&s->pb, 3, s->bps_code);
-    put_bits(&s->pb, 1, 0);
-    write_utf8(&s->pb, s->frame_count);
+    put_bits(&frame->pb, 3, s->bps_code);
+    put_bits(&frame->pb, 1, 0);
+    write_utf8(&frame->pb, frame->number);
 
     if (frame->bs_code[0] == 6)
-        put_bits(&s->pb, 8, frame->bs_code[1]);
+        put_bits(&frame->pb, 8, frame->bs_code[1]);
     else if (frame->bs_code[0] == 7)
-        put_bits(&s->pb, 16, frame->bs_code[1]);
+        put_bits(&frame->pb, 16, frame->bs_code[1]);
 
     if (s->sr_code[0] == 12)
-        put_bits(&s->pb, 8, s->sr_code[1]);
+        put_bits(&frame->pb, 8, s->sr_code[1]);
     else if (s->sr_code[0] > 12)
-        put_bits(&s->pb, 16, s->sr_code[1]);
+        put_bits(&frame->pb, 16, s->sr_code[1]);
 
-    flush_put_bits(&s->pb);
-    crc = av_crc(av_crc_get_table(AV_CRC_8_ATM), 0, s->pb.buf,
-                 put_bits_count(&s->pb) >> 3);
-    put_bits(&s->pb, 8, crc);
+    flush_put_bits(&frame->pb);
+    crc = av_crc(av_crc_get_table(AV_CRC_8_ATM), 0, frame->pb.buf,
+                 put_bits_count(&frame->pb) >> 3);
+    put_bits(&frame->pb, 8, crc);
 }
 
 
-static void write_subframes(FlacEncodeContext *s)
+static void write_subframes(FlacEncodeContext *s, FlacFrame *frame)
 {
     int ch;
 
     for (ch = 0; ch < s->channels; ch++) {
-        FlacSubframe *sub = &s->frame.subframes[ch];
+        FlacSubframe *sub = &frame->subframes[ch];
         int i, p, porder, psize;
         int32_t *part_end;
         int32_t *res       =  sub->residual;
-        int32_t *frame_end = &sub->residual[s->frame.blocksize];
+        int32_t *frame_end = &sub->residual[frame->blocksize];
 
         /* subframe header */
-        put_bits(&s->pb, 1, 0);
-        put_bits(&s->pb, 6, sub->type_code);
-        put_bits(&s->pb, 1, !!sub->wasted);
+        put_bits(&frame->pb, 1, 0);
+        put_bits(&frame->pb, 6, sub->type_code);
+        put_bits(&frame->pb, 1, !!sub->wasted);
         if (sub->wasted)
-            put_bits(&s->pb, sub->wasted, 1);
+            put_bits(&frame->pb, sub->wasted, 1);
 
         /* subframe */
         if (sub->type == FLAC_SUBFRAME_CONSTANT) {
-            put_sbits(&s->pb, sub->obits, res[0]);
+            put_sbits(&frame->pb, sub->obits, res[0]);
         } else if (sub->type == FLAC_SUBFRAME_VERBATIM) {
             while (res < frame_end)
-                put_sbits(&s->pb, sub->obits, *res++);
+                put_sbits(&frame->pb, sub->obits, *res++);
         } else {
             /* warm-up samples */
             for (i = 0; i < sub->order; i++)
-                put_sbits(&s->pb, sub->obits, *res++);
+                put_sbits(&frame->pb, sub->obits, *res++);
 
             /* LPC coefficients */
             if (sub->type == FLAC_SUBFRAME_LPC) {
                 int cbits = s->options.lpc_coeff_precision;
-                put_bits( &s->pb, 4, cbits-1);
-                put_sbits(&s->pb, 5, sub->shift);
+                put_bits( &frame->pb, 4, cbits-1);
+                put_sbits(&frame->pb, 5, sub->shift);
                 for (i = 0; i < sub->order; i++)
-                    put_sbits(&s->pb, cbits, sub->coefs[i]);
+                    put_sbits(&frame->pb, cbits, sub->coefs[i]);
             }
 
             /* rice-encoded block */
-            put_bits(&s->pb, 2, sub->rc.coding_mode - 4);
+            put_bits(&frame->pb, 2, sub->rc.coding_mode - 4);
 
             /* partition order */
             porder  = sub->rc.porder;
-            psize   = s->frame.blocksize >> porder;
-            put_bits(&s->pb, 4, porder);
+            psize   = frame->blocksize >> porder;
+            put_bits(&frame->pb, 4, porder);
 
             /* residual */
             part_end  = &sub->residual[psize];
             for (p = 0; p < 1 << porder; p++) {
                 int k = sub->rc.params[p];
-                put_bits(&s->pb, sub->rc.coding_mode, k);
+                put_bits(&frame->pb, sub->rc.coding_mode, k);
                 while (res < part_end)
-                    set_sr_golomb_flac(&s->pb, *res++, k, INT32_MAX, 0);
+                    set_sr_golomb_flac(&frame->pb, *res++, k, INT32_MAX, 0);
                 part_end = FFMIN(frame_end, part_end + psize);
             }
         }
@@ -1275,31 +1335,33 @@ static void write_subframes(FlacEncodeContext *s)
 }
 
 
-static void write_frame_footer(FlacEncodeContext *s)
+static void write_frame_footer(FlacFrame *frame)
 {
     int crc;
-    flush_put_bits(&s->pb);
-    crc = av_bswap16(av_crc(av_crc_get_table(AV_CRC_16_ANSI), 0, s->pb.buf,
-                            put_bits_count(&s->pb)>>3));
-    put_bits(&s->pb, 16, crc);
-    flush_put_bits(&s->pb);
+    flush_put_bits(&frame->pb);
+    crc = av_bswap16(av_crc(av_crc_get_table(AV_CRC_16_ANSI), 0, frame->pb.buf,
+                            put_bits_count(&frame->pb)>>3));
+    put_bits(&frame->pb, 16, crc);
+    flush_put_bits(&frame->pb);
 }
 
 
-static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
+static int write_frame(FlacEncodeContext *s, FlacFrame *frame, uint8_t *buf,
+                       int buf_size)
 {
-    init_put_bits(&s->pb, avpkt->data, avpkt->size);
-    write_frame_header(s);
-    write_subframes(s);
-    write_frame_footer(s);
-    return put_bits_count(&s->pb) >> 3;
+    init_put_bits(&frame->pb, buf, buf_size);
+    write_frame_header(s, frame);
+    write_subframes(s, frame);
+    write_frame_footer(frame);
+    return put_bits_count(&frame->pb) >> 3;
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1320,7 +1382,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1332,14 +1394,105 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+/**
+ * Encode one queued frame. The frames of a batch only share read-only
+ * state, so they are encoded as slice jobs.
+ */
+static int encode_frame_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacFrame *frame     = s->frames[jobnr];
+    int frame_bytes;
+
+    channel_decorrelation(s, frame);
+
+    remove_wasted_bits(s, frame);
+
+    frame_bytes = encode_frame(s, frame);
+
+    /* Fall back on verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame_bytes < 0 || frame_bytes > frame->max_framesize) {
+        frame->verbatim_only = 1;
+        frame_bytes = encode_frame(s, frame);
+        if (frame_bytes < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
+            frame->out_bytes = frame_bytes;
+            return frame_bytes;
+        }
+    }
+
+    frame->out_bytes = write_frame(s, frame, frame->buf, frame_bytes);
+    return 0;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
     FlacEncodeContext *s;
-    int frame_bytes, out_bytes, ret;
+    FlacFrame *f;
+    int ret;
 
     s = avctx->priv_data;
 
+    if (frame) {
+        f = s->frames[s->nb_queued++];
+
+        /* change max_framesize for small final frame */
+        if (frame->nb_samples < avctx->frame_size)
+            f->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
+                                                          s->channels,
+                                                          avctx->bits_per_raw_sample);
+        else
+            f->max_framesize = s->max_framesize;
+
+        init_frame(s, f, frame->nb_samples);
+
+        copy_samples(s, f, frame->data[0]);
+
+        f->number = s->frame_count++;
+        f->pts    = frame->pts;
+
+        s->sample_count += frame->nb_samples;
+        if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+            return ret;
+        }
+    }
+
+    /* encode the queued frames once the previous batch has been returned */
+    if (s->next_out == s->nb_encoded && s->nb_queued &&
+        (s->nb_queued == s->nb_threads || !frame)) {
+        avctx->execute2(avctx, encode_frame_job, NULL, NULL, s->nb_queued);
+        s->nb_encoded = s->nb_queued;
+        s->nb_queued  = 0;
+        s->next_out   = 0;
+    }
+
+    if (s->next_out < s->nb_encoded) {
+        f = s->frames[s->next_out++];
+        if (f->out_bytes < 0)
+            return f->out_bytes;
+
+        if ((ret = ff_alloc_packet2(avctx, avpkt, f->out_bytes, 0)) < 0)
+            return ret;
+        memcpy(avpkt->data, f->buf, f->out_bytes);
+
+        if (f->out_bytes > s->max_encoded_framesize)
+            s->max_encoded_framesize = f->out_bytes;
+        if (f->out_bytes < s->min_framesize)
+            s->min_framesize = f->out_bytes;
+
+        avpkt->pts      = f->pts;
+        avpkt->duration = ff_samples_to_time_base(avctx, f->blocksize);
+
+        s->next_pts = avpkt->pts + avpkt->duration;
+
+        *got_packet_ptr = 1;
+        return 0;
+    }
+
     /* when the last block is reached, update the header in extradata */
     if (!frame) {
         s->max_framesize = s->max_encoded_framesize;
@@ -1358,61 +1511,8 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             *got_packet_ptr = 1;
             s->flushed = 1;
         }
-
-        return 0;
-    }
-
-    /* change max_framesize for small final frame */
-    if (frame->nb_samples < s->frame.blocksize) {
-        s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
-                                                      s->channels,
-                                                      avctx->bits_per_raw_sample);
-    }
-
-    init_frame(s, frame->nb_samples);
-
-    copy_samples(s, frame->data[0]);
-
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
-
-    frame_bytes = encode_frame(s);
-
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
-    }
-
-    if ((ret = ff_alloc_packet2(avctx, avpkt, frame_bytes, 0)) < 0)
-        return ret;
-
-    out_bytes = write_frame(s, avpkt);
-
-    s->frame_count++;
-    s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
-        return ret;
     }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
 
-    avpkt->pts      = frame->pts;
-    avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
-    avpkt->size     = out_bytes;
-
-    s->next_pts = avpkt->pts + avpkt->duration;
-
-    *got_packet_ptr = 1;
     return 0;
 }
 
@@ -1421,9 +1521,11 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     if (avctx->priv_data) {
         FlacEncodeContext *s = avctx->priv_data;
+        int i;
+        for (i = 0; i < MAX_FRAME_THREADS; i++)
+            free_frame(s, &s->frames[i]);
         av_freep(&s->md5ctx);
         av_freep(&s->md5_buffer);
-        ff_lpc_end(&s->lpc_ctx);
     }
     av_freep(&avctx->extradata);
     avctx->extradata_size = 0;
@@ -1475,7 +1577,8 @@ AVCodec ff_flac_encoder = {
     .init           = flac_encode_init,
     .encode2        = flac_encode_frame,
     .close          = flac_encode_close,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_LOSSLESS,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_LOSSLESS |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S16,
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
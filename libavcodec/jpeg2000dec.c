@@ -83,6 +83,15 @@ typedef struct Jpeg2000Tile {
     int coord[2][2];                    // border coordinates {{x0, x1}, {y0, y1}}
 } Jpeg2000Tile;
 
+/* A code-block of a tile, decoded and dequantized by one slice thread job */
+typedef struct Jpeg2000CblkJob {
+    Jpeg2000Component   *comp;
+    Jpeg2000CodingStyle *codsty;
+    Jpeg2000Band        *band;
+    Jpeg2000Cblk        *cblk;
+    int                 bandpos;
+} Jpeg2000CblkJob;
+
 typedef struct Jpeg2000DecoderContext {
     AVClass         *class;
     AVCodecContext  *avctx;
@@ -116,6 +125,10 @@ typedef struct Jpeg2000DecoderContext {
     Jpeg2000Tile    *tile;
     Jpeg2000DSPContext dsp;
 
+    Jpeg2000T1Context *t1;      // tier-1 scratch, one per slice thread
+    Jpeg2000CblkJob *cblk_jobs;
+    unsigned int    cblk_jobs_size;
+
     /*options parameters*/
     int             reduction_factor;
 } Jpeg2000DecoderContext;
@@ -1614,6 +1627,46 @@ static inline void mct_decode(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
     s->dsp.mct_decode[tile->codsty[0].transform](src[0], src[1], src[2], csize);
 }
 
+static int decode_cblk_job(AVCodecContext *avctx, void *arg,
+                           int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000CblkJob *job      = (Jpeg2000CblkJob *)arg + jobnr;
+    Jpeg2000T1Context *t1     = s->t1 + threadnr;
+    Jpeg2000Cblk *cblk        = job->cblk;
+    int x, y;
+
+    t1->stride = (1<<job->codsty->log2_cblk_width) + 2;
+    decode_cblk(s, job->codsty, t1, cblk,
+                cblk->coord[0][1] - cblk->coord[0][0],
+                cblk->coord[1][1] - cblk->coord[1][0],
+                job->bandpos);
+
+    x = cblk->coord[0][0] - job->band->coord[0][0];
+    y = cblk->coord[1][0] - job->band->coord[1][0];
+
+    if (job->codsty->transform == FF_DWT97)
+        dequantization_float(x, y, cblk, job->comp, t1, job->band);
+    else if (job->codsty->transform == FF_DWT97_INT)
+        dequantization_int_97(x, y, cblk, job->comp, t1, job->band);
+    else
+        dequantization_int(x, y, cblk, job->comp, t1, job->band);
+
+    return 0;
+}
+
+static int dwt_decode_job(AVCodecContext *avctx, void *arg,
+                          int compno, int threadnr)
+{
+    Jpeg2000Tile *tile      = arg;
+    Jpeg2000Component *comp = tile->comp + compno;
+
+    ff_dwt_decode(&comp->dwt, tile->codsty[compno].transform == FF_DWT97 ?
+                  (void*)comp->f_data : (void*)comp->i_data);
+
+    return 0;
+}
+
 static int jpeg2000_decode_tile(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
                                 AVFrame *picture)
 {
@@ -1622,17 +1675,16 @@ static int jpeg2000_decode_tile(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
     int x, y;
     int planar    = !!(pixdesc->flags & AV_PIX_FMT_FLAG_PLANAR);
     int pixelsize = planar ? 1 : pixdesc->nb_components;
+    int nb_cblks  = 0;
 
     uint8_t *line;
-    Jpeg2000T1Context t1;
 
-    /* Loop on tile components */
+    /* Code-blocks are independent, collect those of all components
+     * and decode them in parallel */
     for (compno = 0; compno < s->ncomponents; compno++) {
         Jpeg2000Component *comp     = tile->comp + compno;
         Jpeg2000CodingStyle *codsty = tile->codsty + compno;
 
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
-
         /* Loop on resolution levels */
         for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
             Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
@@ -1655,31 +1707,29 @@ static int jpeg2000_decode_tile(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
 
                     /* Loop on codeblocks */
                     for (cblkno = 0; cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height; cblkno++) {
-                        int x, y;
-                        Jpeg2000Cblk *cblk = prec->cblk + cblkno;
-                        decode_cblk(s, codsty, &t1, cblk,
-                                    cblk->coord[0][1] - cblk->coord[0][0],
-                                    cblk->coord[1][1] - cblk->coord[1][0],
-                                    bandpos);
-
-                        x = cblk->coord[0][0] - band->coord[0][0];
-                        y = cblk->coord[1][0] - band->coord[1][0];
-
-                        if (codsty->transform == FF_DWT97)
-                            dequantization_float(x, y, cblk, comp, &t1, band);
-                        else if (codsty->transform == FF_DWT97_INT)
-                            dequantization_int_97(x, y, cblk, comp, &t1, band);
-                        else
-                            dequantization_int(x, y, cblk, comp, &t1, band);
+                        Jpeg2000CblkJob *job = av_fast_realloc(s->cblk_jobs, &s->cblk_jobs_size,
+                                                               (nb_cblks + 1) * sizeof(*job));
+                        if (!job)
+                            return AVERROR(ENOMEM);
+                        s->cblk_jobs = job;
+                        job += nb_cblks++;
+
+                        job->comp    = comp;
+                        job->codsty  = codsty;
+                        job->band    = band;
+                        job->cblk    = prec->cblk + cblkno;
+                        job->bandpos = bandpos;
                    } /* end cblk */
                 } /*end prec */
             } /* end band */
         } /* end reslevel */
-
-        /* inverse DWT */
-        ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
     } /*end comp */
 
+    s->avctx->execute2(s->avctx, decode_cblk_job, s->cblk_jobs, NULL, nb_cblks);
+
+    /* inverse DWT */
+    s->avctx->execute2(s->avctx, dwt_decode_job, tile, NULL, s->ncomponents);
+
     /* inverse MCT transformation */
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
@@ -2052,6 +2102,17 @@ static av_cold int jpeg2000_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+static av_cold int jpeg2000_decode_end(AVCodecContext *avctx)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+
+    av_freep(&s->t1);
+    av_freep(&s->cblk_jobs);
+    s->cblk_jobs_size = 0;
+
+    return 0;
+}
+
 static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
                                  int *got_frame, AVPacket *avpkt)
 {
@@ -2105,6 +2166,15 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     if (ret = jpeg2000_read_bitstream_packets(s))
         goto end;
 
+    if (!s->t1) {
+        int nb_t1 = avctx->active_thread_type & FF_THREAD_SLICE ? avctx->thread_count : 1;
+        s->t1 = av_malloc_array(FFMAX(nb_t1, 1), sizeof(*s->t1));
+        if (!s->t1) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+    }
+
     for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++)
         if (ret = jpeg2000_decode_tile(s, s->tile + tileno, picture))
             goto end;
@@ -2159,11 +2229,13 @@ AVCodec ff_jpeg2000_decoder = {
     .long_name        = NULL_IF_CONFIG_SMALL("JPEG 2000"),
     .type             = AVMEDIA_TYPE_VIDEO,
     .id               = AV_CODEC_ID_JPEG2000,
-    .capabilities     = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_DR1,
+    .capabilities     = AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS |
+                        AV_CODEC_CAP_DR1,
     .priv_data_size   = sizeof(Jpeg2000DecoderContext),
     .init_static_data = jpeg2000_init_static_data,
     .init             = jpeg2000_decode_init,
     .decode           = jpeg2000_decode_frame,
+    .close            = jpeg2000_decode_end,
     .priv_class       = &jpeg2000_class,
     .max_lowres       = 5,
     .profiles         = NULL_IF_CONFIG_SMALL(profiles)
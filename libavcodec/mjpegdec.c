@@ -47,6 +47,8 @@
 #include "exif.h"
 #include "bytestream.h"
 
+#define MAX_RESTART_JOBS 32
+
 
 static int build_vlc(VLC *vlc, const uint8_t *bits_table,
                      const uint8_t *val_table, int nb_codes,
@@ -1214,39 +1216,30 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
-static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
-                             int Al, const uint8_t *mb_bitmask,
-                             int mb_bitmask_size,
-                             const AVFrame *reference)
+/* decode nb_mcus MCUs of a scan, starting at MCU mcu_start in raster order */
+static int decode_scan_mcus(MJpegDecodeContext *s, int nb_components, int Ah,
+                            int Al, GetBitContext *mb_bitmask_gb,
+                            const AVFrame *reference,
+                            int mcu_start, int nb_mcus)
 {
     int i, mb_x, mb_y;
     uint8_t *data[MAX_COMPONENTS];
     const uint8_t *reference_data[MAX_COMPONENTS];
     int linesize[MAX_COMPONENTS];
-    GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
     int bytes_per_pixel = 1 + (s->bits > 8);
 
-    if (mb_bitmask) {
-        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
-            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
-            return AVERROR_INVALIDDATA;
-        }
-        init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
-    }
-
-    s->restart_count = 0;
-
     for (i = 0; i < nb_components; i++) {
         int c   = s->comp_index[i];
         data[c] = s->picture_ptr->data[c];
         reference_data[c] = reference ? reference->data[c] : NULL;
         linesize[c] = s->linesize[c];
-        s->coefs_finished[c] |= 1;
     }
 
-    for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
-        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
-            const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
+    mb_x = mcu_start % s->mb_width;
+    mb_y = mcu_start / s->mb_width;
+    for (; mb_y < s->mb_height && nb_mcus > 0; mb_y++, mb_x = 0) {
+        for (; mb_x < s->mb_width && nb_mcus > 0; mb_x++, nb_mcus--) {
+            const int copy_mb = mb_bitmask_gb && !get_bits1(mb_bitmask_gb);
 
             if (s->restart_interval && !s->restart_count)
                 s->restart_count = s->restart_interval;
@@ -1330,6 +1323,131 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
     return 0;
 }
 
+typedef struct RestartSliceArgs {
+    int nb_components, Ah, Al;
+    int scan_start;     ///< byte offset of the first restart interval
+    int nb_intervals;
+    int nb_jobs;
+    int end_bits;       ///< bit position after the last MCU of the scan
+} RestartSliceArgs;
+
+static int decode_restart_intervals(AVCodecContext *avctx, void *arg,
+                                    int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data, *t = &s->slice_ctx[jobnr];
+    RestartSliceArgs *rs = arg;
+    int first = (int64_t)jobnr * rs->nb_intervals / rs->nb_jobs;
+    int last  = (int64_t)(jobnr + 1) * rs->nb_intervals / rs->nb_jobs;
+    int buf_size = s->gb.size_in_bits >> 3;
+    int n, i, ret;
+
+    for (n = first; n < last; n++) {
+        int offset = n ? s->rst_offsets[n - 1] : rs->scan_start;
+
+        init_get_bits8(&t->gb, s->gb.buffer + offset, buf_size - offset);
+        for (i = 0; i < rs->nb_components; i++)
+            t->last_dc[i] = (4 << s->bits);
+        ret = decode_scan_mcus(t, rs->nb_components, rs->Ah, rs->Al, NULL, NULL,
+                               n * s->restart_interval, s->restart_interval);
+        if (ret < 0)
+            return ret;
+        if (n == rs->nb_intervals - 1)
+            rs->end_bits = offset * 8 + get_bits_count(&t->gb);
+    }
+
+    return 0;
+}
+
+/* Restart intervals can be decoded independently of each other. Find the
+ * RST markers of this scan among the ones recorded while unescaping it, and
+ * decode runs of consecutive intervals in parallel. Returns 1 if the scan
+ * cannot be split, e.g. because markers are missing or out of sequence. */
+static int decode_scan_sliced(MJpegDecodeContext *s, int nb_components,
+                              int Ah, int Al)
+{
+    AVCodecContext *avctx = s->avctx;
+    RestartSliceArgs rs = { nb_components, Ah, Al };
+    int nb_mcus = s->mb_width * s->mb_height;
+    int ret[MAX_RESTART_JOBS];
+    int i, first_rst;
+
+    if (get_bits_count(&s->gb) & 7)
+        return 1;
+    rs.scan_start   = get_bits_count(&s->gb) >> 3;
+    rs.nb_intervals = (nb_mcus + s->restart_interval - 1) / s->restart_interval;
+    rs.nb_jobs      = FFMIN3(rs.nb_intervals, avctx->thread_count, MAX_RESTART_JOBS);
+    if (rs.nb_jobs < 2)
+        return 1;
+
+    // with several fields in one buffer, skip the markers of earlier fields
+    for (first_rst = 0; first_rst < s->nb_rst; first_rst++)
+        if (s->rst_offsets[first_rst] > rs.scan_start)
+            break;
+    if (s->nb_rst - first_rst < rs.nb_intervals - 1)
+        return 1;
+    for (i = 0; i < rs.nb_intervals - 1; i++)
+        if ((s->gb.buffer[s->rst_offsets[first_rst + i] - 1] & 7) != (i & 7))
+            return 1;
+
+    if (!s->slice_ctx) {
+        s->slice_ctx = av_malloc_array(MAX_RESTART_JOBS, sizeof(*s->slice_ctx));
+        if (!s->slice_ctx)
+            return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < rs.nb_jobs; i++) {
+        memcpy(&s->slice_ctx[i], s, sizeof(*s));
+        s->slice_ctx[i].restart_interval = 0;
+        s->slice_ctx[i].rst_offsets      = s->rst_offsets + first_rst;
+    }
+
+    avctx->execute2(avctx, decode_restart_intervals, &rs, ret, rs.nb_jobs);
+    for (i = 0; i < rs.nb_jobs; i++)
+        if (ret[i] < 0)
+            return ret[i];
+
+    // leave the bitreader where sequential decoding would have left it,
+    // including a RST marker following the last MCU
+    skip_bits_long(&s->gb, rs.end_bits - get_bits_count(&s->gb));
+    s->restart_count = nb_mcus % s->restart_interval ? 2 : 1;
+    handle_rstn(s, nb_components);
+
+    return 0;
+}
+
+static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
+                             int Al, const uint8_t *mb_bitmask,
+                             int mb_bitmask_size,
+                             const AVFrame *reference)
+{
+    GetBitContext mb_bitmask_gb;
+    int i, ret;
+
+    if (mb_bitmask) {
+        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
+            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
+            return AVERROR_INVALIDDATA;
+        }
+        init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
+    }
+
+    s->restart_count = 0;
+
+    for (i = 0; i < nb_components; i++)
+        s->coefs_finished[s->comp_index[i]] |= 1;
+
+    if (s->restart_interval && !s->progressive && !mb_bitmask &&
+        s->avctx->active_thread_type & FF_THREAD_SLICE &&
+        s->avctx->codec_id != AV_CODEC_ID_THP) {
+        ret = decode_scan_sliced(s, nb_components, Ah, Al);
+        if (ret <= 0)
+            return ret;
+    }
+
+    return decode_scan_mcus(s, nb_components, Ah, Al,
+                            mb_bitmask ? &mb_bitmask_gb : NULL, reference,
+                            0, s->mb_width * s->mb_height);
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                                             int se, int Ah, int Al)
 {
@@ -1885,7 +2003,9 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
     if (start_code == SOS && !s->ls) {
         const uint8_t *src = *buf_ptr;
         uint8_t *dst = s->buffer;
+        int record_rst = s->avctx->active_thread_type & FF_THREAD_SLICE;
 
+        s->nb_rst = 0;
         while (src < buf_end) {
             uint8_t x = *(src++);
 
@@ -1895,9 +2015,17 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                     while (src < buf_end && x == 0xff)
                         x = *(src++);
 
-                    if (x >= 0xd0 && x <= 0xd7)
+                    if (x >= 0xd0 && x <= 0xd7) {
                         *(dst++) = x;
-                    else if (x)
+                        if (record_rst) {
+                            int *rst_offsets = av_fast_realloc(s->rst_offsets, &s->rst_offsets_size,
+                                                               (s->nb_rst + 1) * sizeof(*s->rst_offsets));
+                            if (!rst_offsets)
+                                return AVERROR(ENOMEM);
+                            s->rst_offsets = rst_offsets;
+                            s->rst_offsets[s->nb_rst++] = dst - s->buffer;
+                        }
+                    } else if (x)
                         break;
                 }
             }
@@ -2359,6 +2487,9 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
+    av_freep(&s->rst_offsets);
+    s->rst_offsets_size = 0;
+    av_freep(&s->slice_ctx);
 
     for (i = 0; i < 3; i++) {
         for (j = 0; j < 4; j++)
@@ -2404,7 +2535,7 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
@@ -110,6 +110,10 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    int *rst_offsets;   ///< offsets of the data following each RST marker of the current scan
+    unsigned int rst_offsets_size;
+    int nb_rst;
+    struct MJpegDecodeContext *slice_ctx; ///< per job copies for decoding restart intervals in parallel
 
     int buggy_avid;
     int cs_itu601;
@@ -151,6 +151,8 @@ typedef struct OpusStreamContext {
     int delayed_samples;
 
     OpusPacket packet;
+    /* start of this stream's data in the current packet, NULL when draining */
+    const uint8_t *packet_data;
 
     int redundancy_idx;
 } OpusStreamContext;
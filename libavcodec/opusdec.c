@@ -444,6 +444,18 @@ finish:
     return output_samples;
 }
 
+static int opus_decode_substream(AVCodecContext *avctx, void *arg,
+                                 int stream_idx, int threadnr)
+{
+    OpusContext *c       = avctx->priv_data;
+    OpusStreamContext *s = &c->streams[stream_idx];
+    int coded_samples    = *(int*)arg;
+
+    return opus_decode_subpacket(s, s->packet_data, s->packet.data_size,
+                                 c->out + 2 * stream_idx,
+                                 c->out_size[stream_idx], coded_samples);
+}
+
 static int opus_decode_packet(AVCodecContext *avctx, void *data,
                               int *got_frame_ptr, AVPacket *avpkt)
 {
@@ -529,7 +541,7 @@ static int opus_decode_packet(AVCodecContext *avctx, void *data,
         c->out_size[i] = frame->linesize[0] - ret * sizeof(float);
     }
 
-    /* decode each sub-packet */
+    /* parse the header of each sub-packet */
     for (i = 0; i < c->nb_streams; i++) {
         OpusStreamContext *s = &c->streams[i];
 
@@ -548,15 +560,25 @@ static int opus_decode_packet(AVCodecContext *avctx, void *data,
             s->silk_samplerate = get_silk_samplerate(s->packet.config);
         }
 
-        ret = opus_decode_subpacket(&c->streams[i], buf, s->packet.data_size,
-                                    c->out + 2 * i, c->out_size[i], coded_samples);
-        if (ret < 0)
-            return ret;
-        c->decoded_samples[i] = ret;
-        decoded_samples       = FFMIN(decoded_samples, ret);
+        s->packet_data = buf;
+        if (buf) {
+            buf      += s->packet.packet_size;
+            buf_size -= s->packet.packet_size;
+        }
+    }
 
-        buf      += s->packet.packet_size;
-        buf_size -= s->packet.packet_size;
+    /* the streams are independent, decode them in parallel; a single
+     * stream is decoded directly, without waking the slice threads */
+    if (c->nb_streams > 1)
+        avctx->execute2(avctx, opus_decode_substream, &coded_samples,
+                        c->decoded_samples, c->nb_streams);
+    else
+        c->decoded_samples[0] = opus_decode_substream(avctx, &coded_samples, 0, 0);
+
+    for (i = 0; i < c->nb_streams; i++) {
+        if (c->decoded_samples[i] < 0)
+            return c->decoded_samples[i];
+        decoded_samples = FFMIN(decoded_samples, c->decoded_samples[i]);
     }
 
     /* buffer the extra samples */
@@ -753,5 +775,5 @@ AVCodec ff_opus_decoder = {
     .close           = opus_decode_close,
     .decode          = opus_decode_packet,
     .flush           = opus_decode_flush,
-    .capabilities    = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .capabilities    = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS,
 };
@@ -30,6 +30,7 @@
 #include "mpegutils.h"
 #include "mpegvideo.h"
 #include "msmpeg4data.h"
+#include "thread.h"
 #include "unary.h"
 #include "vc1.h"
 #include "vc1_pred.h"
@@ -66,6 +67,21 @@ static inline void init_block_index(VC1Context *v)
 
 /** @} */ //Bitplane group
 
+/**
+ * Report the MB rows of a reference frame that are final to the frame
+ * threads waiting on them. Overlap smoothing and the loop filter run up to
+ * two rows behind the decoding loop, hence the lag. Field pictures are only
+ * reported as a whole when the frame is finished.
+ */
+static void vc1_report_row_progress(VC1Context *v)
+{
+    MpegEncContext *s = &v->s;
+
+    if (s->mb_y >= 2 && !v->field_mode && s->pict_type != AV_PICTURE_TYPE_B &&
+        !s->er.error_occurred)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, s->mb_y - 2, 0);
+}
+
 static void vc1_put_signed_blocks_clamped(VC1Context *v)
 {
     MpegEncContext *s = &v->s;
@@ -2617,6 +2633,7 @@ static void vc1_decode_i_blocks(VC1Context *v)
         else if (s->mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
 
+        vc1_report_row_progress(v);
         s->first_slice_line = 0;
     }
     if (v->s.loop_filter)
@@ -2687,6 +2704,17 @@ static void vc1_decode_i_blocks_adv(VC1Context *v)
             s->current_picture.mb_type[mb_pos + v->mb_off]                         = MB_TYPE_INTRA;
             s->current_picture.motion_val[1][s->block_index[0] + v->blocks_off][0] = 0;
             s->current_picture.motion_val[1][s->block_index[0] + v->blocks_off][1] = 0;
+            if (v->fcm == ILACE_FRAME &&
+                s->avctx->active_thread_type & FF_THREAD_FRAME) {
+                /* Direct mode of interlaced frame B pictures reads block 2
+                 * too. With frame threads these tables come from another
+                 * thread's picture, so do not leave them stale. Serial
+                 * decoding keeps its previous output. */
+                for (k = 1; k < 4; k++) {
+                    s->current_picture.motion_val[1][s->block_index[k]][0] = 0;
+                    s->current_picture.motion_val[1][s->block_index[k]][1] = 0;
+                }
+            }
 
             // do actual MB decoding and displaying
             if (v->fieldtx_is_raw)
@@ -2745,6 +2773,7 @@ static void vc1_decode_i_blocks_adv(VC1Context *v)
             ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
         else if (s->mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y-1) * 16, 16);
+        vc1_report_row_progress(v);
         s->first_slice_line = 0;
     }
 
@@ -2824,6 +2853,7 @@ static void vc1_decode_p_blocks(VC1Context *v)
         memmove(v->luma_mv_base,  v->luma_mv,  sizeof(v->luma_mv_base[0])  * s->mb_stride);
         if (s->mb_y != s->start_mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
+        vc1_report_row_progress(v);
         s->first_slice_line = 0;
     }
     if (apply_loop_filter) {
@@ -2871,6 +2901,10 @@ static void vc1_decode_b_blocks(VC1Context *v)
 
     s->first_slice_line = 1;
     for (s->mb_y = s->start_mb_y; s->mb_y < s->end_mb_y; s->mb_y++) {
+        /* direct mode uses the co-located MVs of the next anchor */
+        ff_thread_await_progress(&s->next_picture.tf,
+                                 FFMIN(((s->mb_y + 1) << v->field_mode) - 1,
+                                       s->mb_height - 1), 0);
         s->mb_x = 0;
         init_block_index(v);
         for (; s->mb_x < s->mb_width; s->mb_x++) {
@@ -2917,10 +2951,12 @@ static void vc1_decode_skip_blocks(VC1Context *v)
         s->mb_x = 0;
         init_block_index(v);
         ff_update_block_index(s);
+        ff_thread_await_progress(&s->last_picture.tf, s->mb_y, 0);
         memcpy(s->dest[0], s->last_picture.f->data[0] + s->mb_y * 16 * s->linesize,   s->linesize   * 16);
         memcpy(s->dest[1], s->last_picture.f->data[1] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         memcpy(s->dest[2], s->last_picture.f->data[2] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
+        ff_thread_report_progress(&s->current_picture_ptr->tf, s->mb_y, 0);
         s->first_slice_line = 0;
     }
     s->pict_type = AV_PICTURE_TYPE_P;
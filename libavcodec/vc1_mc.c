@@ -30,8 +30,23 @@
 #include "h264chroma.h"
 #include "mathops.h"
 #include "mpegvideo.h"
+#include "thread.h"
 #include "vc1.h"
 
+/**
+ * Wait until another frame thread has decoded the MB rows of a reference
+ * picture that a block reads from.
+ * @param y_end first luma line below the lines read, in the coordinates
+ *              of the referenced field or frame
+ */
+static void vc1_await_reference(VC1Context *v, Picture *ref, int y_end)
+{
+    MpegEncContext *s = &v->s;
+    int row = ((FFMAX(y_end, 1) << v->field_mode) - 1) >> 4;
+
+    ff_thread_await_progress(&ref->tf, FFMIN(row, s->mb_height - 1), 0);
+}
+
 static av_always_inline void vc1_scale_luma(uint8_t *srcY,
                                             int k, int linesize)
 {
@@ -179,6 +194,7 @@ void ff_vc1_mc_1mv(VC1Context *v, int dir)
     int i;
     uint8_t (*luty)[256], (*lutuv)[256];
     int use_ic;
+    Picture *ref = NULL;
 
     if ((!v->field_mode ||
          (v->ref_field_type[dir] == 1 && v->cur_field_type == 1)) &&
@@ -227,6 +243,7 @@ void ff_vc1_mc_1mv(VC1Context *v, int dir)
             luty  = v->last_luty;
             lutuv = v->last_lutuv;
             use_ic = v->last_use_ic;
+            ref    = &s->last_picture;
         }
     } else {
         srcY = s->next_picture.f->data[0];
@@ -235,6 +252,7 @@ void ff_vc1_mc_1mv(VC1Context *v, int dir)
         luty  = v->next_luty;
         lutuv = v->next_lutuv;
         use_ic = v->next_use_ic;
+        ref    = &s->next_picture;
     }
 
     if (!srcY || !srcU) {
@@ -259,6 +277,9 @@ void ff_vc1_mc_1mv(VC1Context *v, int dir)
         uvsrc_y = av_clip(uvsrc_y,  -8, s->avctx->coded_height >> 1);
     }
 
+    if (ref)
+        vc1_await_reference(v, ref, FFMAX(src_y + 19, 2 * uvsrc_y + 18));
+
     srcY += src_y   * s->linesize   + src_x;
     srcU += uvsrc_y * s->uvlinesize + uvsrc_x;
     srcV += uvsrc_y * s->uvlinesize + uvsrc_x;
@@ -358,6 +379,7 @@ void ff_vc1_mc_4mv_luma(VC1Context *v, int n, int dir, int avg)
     int v_edge_pos = s->v_edge_pos >> v->field_mode;
     uint8_t (*luty)[256];
     int use_ic;
+    Picture *ref = NULL;
 
     if ((!v->field_mode ||
          (v->ref_field_type[dir] == 1 && v->cur_field_type == 1)) &&
@@ -376,11 +398,13 @@ void ff_vc1_mc_4mv_luma(VC1Context *v, int n, int dir, int avg)
             srcY = s->last_picture.f->data[0];
             luty = v->last_luty;
             use_ic = v->last_use_ic;
+            ref  = &s->last_picture;
         }
     } else {
         srcY = s->next_picture.f->data[0];
         luty = v->next_luty;
         use_ic = v->next_use_ic;
+        ref  = &s->next_picture;
     }
 
     if (!srcY) {
@@ -449,6 +473,9 @@ void ff_vc1_mc_4mv_luma(VC1Context *v, int n, int dir, int avg)
         }
     }
 
+    if (ref)
+        vc1_await_reference(v, ref, src_y + ((8 + 3) << fieldmv));
+
     srcY += src_y * s->linesize + src_x;
     if (v->field_mode && v->ref_field_type[dir])
         srcY += s->current_picture_ptr->f->linesize[0];
@@ -515,6 +542,7 @@ void ff_vc1_mc_4mv_chroma(VC1Context *v, int dir)
     int v_edge_pos = s->v_edge_pos >> v->field_mode;
     uint8_t (*lutuv)[256];
     int use_ic;
+    Picture *ref = NULL;
 
     if (!v->field_mode && !v->s.last_picture.f->data[0])
         return;
@@ -575,12 +603,14 @@ void ff_vc1_mc_4mv_chroma(VC1Context *v, int dir)
             srcV = s->last_picture.f->data[2];
             lutuv = v->last_lutuv;
             use_ic = v->last_use_ic;
+            ref    = &s->last_picture;
         }
     } else {
         srcU = s->next_picture.f->data[1];
         srcV = s->next_picture.f->data[2];
         lutuv = v->next_lutuv;
         use_ic = v->next_use_ic;
+        ref    = &s->next_picture;
     }
 
     if (!srcU) {
@@ -588,6 +618,9 @@ void ff_vc1_mc_4mv_chroma(VC1Context *v, int dir)
         return;
     }
 
+    if (ref)
+        vc1_await_reference(v, ref, 2 * uvsrc_y + 18);
+
     srcU += uvsrc_y * s->uvlinesize + uvsrc_x;
     srcV += uvsrc_y * s->uvlinesize + uvsrc_x;
 
@@ -654,6 +687,7 @@ void ff_vc1_mc_4mv_chroma4(VC1Context *v, int dir, int dir2, int avg)
     int v_edge_pos = s->v_edge_pos >> 1;
     int use_ic;
     uint8_t (*lutuv)[256];
+    Picture *ref;
 
     if (CONFIG_GRAY && s->avctx->flags & AV_CODEC_FLAG_GRAY)
         return;
@@ -681,14 +715,17 @@ void ff_vc1_mc_4mv_chroma4(VC1Context *v, int dir, int dir2, int avg)
             srcV = s->next_picture.f->data[2];
             lutuv  = v->next_lutuv;
             use_ic = v->next_use_ic;
+            ref    = &s->next_picture;
         } else {
             srcU = s->last_picture.f->data[1];
             srcV = s->last_picture.f->data[2];
             lutuv  = v->last_lutuv;
             use_ic = v->last_use_ic;
+            ref    = &s->last_picture;
         }
         if (!srcU)
             return;
+        vc1_await_reference(v, ref, 2 * (uvsrc_y + (5 << fieldmv)));
         srcU += uvsrc_y * s->uvlinesize + uvsrc_x;
         srcV += uvsrc_y * s->uvlinesize + uvsrc_x;
         uvmx_field[i] = (uvmx_field[i] & 3) << 1;
@@ -790,6 +827,8 @@ void ff_vc1_interp_mc(VC1Context *v)
         uvsrc_y = av_clip(uvsrc_y,  -8, s->avctx->coded_height >> 1);
     }
 
+    vc1_await_reference(v, &s->next_picture, FFMAX(src_y + 19, 2 * uvsrc_y + 18));
+
     srcY += src_y   * s->linesize   + src_x;
     srcU += uvsrc_y * s->uvlinesize + uvsrc_x;
     srcV += uvsrc_y * s->uvlinesize + uvsrc_x;
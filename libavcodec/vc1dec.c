@@ -34,6 +34,7 @@
 #include "mpegvideo.h"
 #include "msmpeg4.h"
 #include "msmpeg4data.h"
+#include "thread.h"
 #include "vc1.h"
 #include "vc1data.h"
 #include "vdpau_compat.h"
@@ -528,6 +529,8 @@ static av_cold int vc1_decode_init(AVCodecContext *avctx)
     if (!v->sprite_output_frame)
         return AVERROR(ENOMEM);
 
+    avctx->internal->allocate_progress = 1;
+
     avctx->profile = v->profile;
     if (v->profile == PROFILE_ADVANCED)
         avctx->level = v->level;
@@ -607,6 +610,84 @@ av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
     return 0;
 }
 
+#if HAVE_THREADS
+static av_cold int vc1_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    VC1Context *v = avctx->priv_data;
+
+    v->s.avctx = avctx;
+    v->sprite_output_frame = av_frame_alloc();
+    if (!v->sprite_output_frame)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static int vc1_update_thread_context(AVCodecContext *dst,
+                                     const AVCodecContext *src)
+{
+    VC1Context *v = dst->priv_data, *v1 = src->priv_data;
+    MpegEncContext *s = &v->s, *s1 = &v1->s;
+    int i, ret;
+
+    if (dst == src || !s1->context_initialized)
+        return 0;
+
+    if (s->context_initialized &&
+        (s->width != s1->width || s->height != s1->height))
+        ff_vc1_decode_end(dst);
+
+    if ((ret = ff_mpeg_update_thread_context(dst, src)) < 0)
+        return ret;
+
+    if (!v->mv_type_mb_plane &&
+        (ret = ff_vc1_decode_init_alloc_tables(v)) < 0)
+        return ret;
+
+    /* entry point header */
+    v->broken_link      = v1->broken_link;
+    v->closed_entry     = v1->closed_entry;
+    v->panscanflag      = v1->panscanflag;
+    v->refdist_flag     = v1->refdist_flag;
+    s->loop_filter      = s1->loop_filter;
+    v->fastuvmc         = v1->fastuvmc;
+    v->extended_mv      = v1->extended_mv;
+    v->dquant           = v1->dquant;
+    v->vstransform      = v1->vstransform;
+    v->overlap          = v1->overlap;
+    v->quantizer_mode   = v1->quantizer_mode;
+    v->extended_dmv     = v1->extended_dmv;
+    v->range_mapy_flag  = v1->range_mapy_flag;
+    v->range_mapy       = v1->range_mapy;
+    v->range_mapuv_flag = v1->range_mapuv_flag;
+    v->range_mapuv      = v1->range_mapuv;
+
+    /* state carried over from the previous pictures */
+    v->rnd         = v1->rnd;
+    v->refdist     = v1->refdist;
+    v->cbpcy_vlc   = v1->cbpcy_vlc;
+    v->last_use_ic = v1->last_use_ic;
+    v->next_use_ic = v1->next_use_ic;
+    v->aux_use_ic  = v1->aux_use_ic;
+    memcpy(v->last_luty,  v1->last_luty,  sizeof(v->last_luty));
+    memcpy(v->last_lutuv, v1->last_lutuv, sizeof(v->last_lutuv));
+    memcpy(v->next_luty,  v1->next_luty,  sizeof(v->next_luty));
+    memcpy(v->next_lutuv, v1->next_lutuv, sizeof(v->next_lutuv));
+    memcpy(v->aux_luty,   v1->aux_luty,   sizeof(v->aux_luty));
+    memcpy(v->aux_lutuv,  v1->aux_lutuv,  sizeof(v->aux_lutuv));
+
+    /* field MV direction of the last anchor, used by B field pictures */
+    for (i = 0; i < 2; i++) {
+        int mb_height = FFALIGN(s->mb_height, 2);
+        int offset    = s->b8_stride + 1;
+        memcpy(v->mv_f_next[i] - offset, v1->mv_f_next[i] - offset,
+               s->b8_stride * (mb_height * 2 + 1) +
+               s->mb_stride * (mb_height + 1) * 2);
+    }
+
+    return 0;
+}
+#endif
 
 /** Decode a VC1/WMV3 frame
  * @todo TODO: Handle VC-1 IDUs (Transport level?)
@@ -621,7 +702,7 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
     AVFrame *pict = data;
     uint8_t *buf2 = NULL;
     const uint8_t *buf_start = buf, *buf_start_second_field = NULL;
-    int mb_height, n_slices1=-1;
+    int mb_height, n_slices1=-1, frame_started = 0;
     struct {
         uint8_t *buf;
         GetBitContext gb;
@@ -853,6 +934,7 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
     if (ff_mpv_frame_start(s, avctx) < 0) {
         goto err;
     }
+    frame_started = 1;
 
     v->s.current_picture_ptr->field_picture = v->field_mode;
     v->s.current_picture_ptr->f->interlaced_frame = (v->fcm != PROGRESSIVE);
@@ -870,6 +952,12 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
         s->current_picture_ptr->f->repeat_pict = v->rptfrm * 2;
     }
 
+    /* Field pictures double the line sizes and rotate the field MV tables
+     * while decoding, so the next frame thread is only released once they
+     * are done. */
+    if (!v->field_mode && !avctx->hwaccel)
+        ff_thread_finish_setup(avctx);
+
     s->me.qpel_put = s->qdsp.put_qpel_pixels_tab;
     s->me.qpel_avg = s->qdsp.avg_qpel_pixels_tab;
 
@@ -1055,6 +1143,8 @@ end:
     return buf_size;
 
 err:
+    if (frame_started)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, INT_MAX, 0);
     av_free(buf2);
     for (i = 0; i < n_slices; i++)
         av_free(slices[i].buf);
@@ -1098,7 +1188,10 @@ AVCodec ff_vc1_decoder = {
     .close          = ff_vc1_decode_end,
     .decode         = vc1_decode_frame,
     .flush          = ff_mpeg_flush,
-    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vc1_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context),
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_FRAME_THREADS,
     .pix_fmts       = vc1_hwaccel_pixfmt_list_420,
     .profiles       = NULL_IF_CONFIG_SMALL(profiles)
 };
@@ -1114,7 +1207,10 @@ AVCodec ff_wmv3_decoder = {
     .close          = ff_vc1_decode_end,
     .decode         = vc1_decode_frame,
     .flush          = ff_mpeg_flush,
-    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vc1_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context),
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_FRAME_THREADS,
     .pix_fmts       = vc1_hwaccel_pixfmt_list_420,
     .profiles       = NULL_IF_CONFIG_SMALL(profiles)
 };
@@ -32,6 +32,7 @@
 #include "vp9dsp.h"
 #include "libavutil/avassert.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 
 #define VP9_SYNCCODE 0x498342
 
@@ -254,6 +255,16 @@ typedef struct VP9Context {
     DECLARE_ALIGNED(32, uint8_t, tmp_uv)[2][64 * 64 * 2];
     uint16_t mvscale[3][2];
     uint8_t mvstep[3][2];
+
+    // slice threading over tile columns; every tile column is decoded in
+    // its own copy of this context, the loopfilter runs behind the slowest
+    // tile column one sb64 row at a time
+    struct VP9Context *tile_ctx;
+    int n_tile_ctx;
+    int sbrows_done;    // per tile context, number of decoded sb64 rows
+    int lf_sbrow;       // next sb64 row to loopfilter
+    int lf_busy;
+    AVMutex lf_lock;
 } VP9Context;
 
 static const uint8_t bwh_tab[2][N_BS_SIZES][2] = {
@@ -313,7 +324,7 @@ static int update_size(AVCodecContext *ctx, int w, int h, enum AVPixelFormat fmt
 {
     VP9Context *s = ctx->priv_data;
     uint8_t *p;
-    int bytesperpixel = s->bytesperpixel;
+    int bytesperpixel = s->bytesperpixel, lflvl_rows, i;
 
     av_assert0(w > 0 && h > 0);
 
@@ -327,13 +338,17 @@ static int update_size(AVCodecContext *ctx, int w, int h, enum AVPixelFormat fmt
     s->sb_rows   = (h + 63) >> 6;
     s->cols      = (w + 7) >> 3;
     s->rows      = (h + 7) >> 3;
+    // with tile threads, decoding may run several sb64 rows ahead of the
+    // loopfilter, so keep the filter masks of every row
+    lflvl_rows   = ctx->active_thread_type == FF_THREAD_SLICE ? s->sb_rows : 1;
 
 #define assign(var, type, n) var = (type) p; p += s->sb_cols * (n) * sizeof(*var)
     av_freep(&s->intra_pred_data[0]);
     // FIXME we slightly over-allocate here for subsampled chroma, but a little
     // bit of padding shouldn't affect performance...
     p = av_malloc(s->sb_cols * (128 + 192 * bytesperpixel +
-                                sizeof(*s->lflvl) + 16 * sizeof(*s->above_mv_ctx)));
+                                lflvl_rows * sizeof(*s->lflvl) +
+                                16 * sizeof(*s->above_mv_ctx)));
     if (!p)
         return AVERROR(ENOMEM);
     assign(s->intra_pred_data[0],  uint8_t *,             64 * bytesperpixel);
@@ -352,12 +367,16 @@ static int update_size(AVCodecContext *ctx, int w, int h, enum AVPixelFormat fmt
     assign(s->above_comp_ctx,      uint8_t *,              8);
     assign(s->above_ref_ctx,       uint8_t *,              8);
     assign(s->above_filter_ctx,    uint8_t *,              8);
-    assign(s->lflvl,               struct VP9Filter *,     1);
+    assign(s->lflvl,               struct VP9Filter *,     lflvl_rows);
 #undef assign
 
     // these will be re-allocated a little later
     av_freep(&s->b_base);
     av_freep(&s->block_base);
+    for (i = 0; i < s->n_tile_ctx; i++) {
+        av_freep(&s->tile_ctx[i].b_base);
+        av_freep(&s->tile_ctx[i].block_base);
+    }
 
     if (s->bpp != s->last_bpp) {
         ff_vp9dsp_init(&s->dsp, s->bpp);
@@ -368,9 +387,8 @@ static int update_size(AVCodecContext *ctx, int w, int h, enum AVPixelFormat fmt
     return 0;
 }
 
-static int update_block_buffers(AVCodecContext *ctx)
+static int update_block_buffers(VP9Context *s)
 {
-    VP9Context *s = ctx->priv_data;
     int chroma_blocks, chroma_eobs, bytesperpixel = s->bytesperpixel;
 
     if (s->b_base && s->block_base && s->block_alloc_using_2pass == s->frames[CUR_FRAME].uses_2pass)
@@ -1454,7 +1472,7 @@ static av_always_inline void setctx_2d(uint8_t *ptr, int w, int h,
     }
 }
 
-static void decode_mode(AVCodecContext *ctx)
+static void decode_mode(VP9Context *s)
 {
     static const uint8_t left_ctx[N_BS_SIZES] = {
         0x0, 0x8, 0x0, 0x8, 0xc, 0x8, 0xc, 0xe, 0xc, 0xe, 0xf, 0xe, 0xf
@@ -1466,7 +1484,6 @@ static void decode_mode(AVCodecContext *ctx)
         TX_32X32, TX_32X32, TX_32X32, TX_32X32, TX_16X16, TX_16X16,
         TX_16X16, TX_8X8, TX_8X8, TX_8X8, TX_4X4, TX_4X4, TX_4X4
     };
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     int row = s->row, col = s->col, row7 = s->row7;
     enum TxfmMode max_tx = max_tx_for_bl_bp[b->bs];
@@ -2322,9 +2339,8 @@ static int decode_coeffs_b32_16bpp(VP9Context *s, int16_t *coef, int n_coeffs,
                                    nnz, scan, nb, band_counts, qmul);
 }
 
-static av_always_inline int decode_coeffs(AVCodecContext *ctx, int is8bitsperpixel)
+static av_always_inline int decode_coeffs(VP9Context *s, int is8bitsperpixel)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     int row = s->row, col = s->col;
     uint8_t (*p)[6][11] = s->prob.coef[b->tx][0 /* y */][!b->intra];
@@ -2489,14 +2505,14 @@ static av_always_inline int decode_coeffs(AVCodecContext *ctx, int is8bitsperpix
     return total_coeff;
 }
 
-static int decode_coeffs_8bpp(AVCodecContext *ctx)
+static int decode_coeffs_8bpp(VP9Context *s)
 {
-    return decode_coeffs(ctx, 1);
+    return decode_coeffs(s, 1);
 }
 
-static int decode_coeffs_16bpp(AVCodecContext *ctx)
+static int decode_coeffs_16bpp(VP9Context *s)
 {
-    return decode_coeffs(ctx, 0);
+    return decode_coeffs(s, 0);
 }
 
 static av_always_inline int check_intra_mode(VP9Context *s, int mode, uint8_t **a,
@@ -2680,10 +2696,9 @@ static av_always_inline int check_intra_mode(VP9Context *s, int mode, uint8_t **
     return mode;
 }
 
-static av_always_inline void intra_recon(AVCodecContext *ctx, ptrdiff_t y_off,
+static av_always_inline void intra_recon(VP9Context *s, ptrdiff_t y_off,
                                          ptrdiff_t uv_off, int bytesperpixel)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     int row = s->row, col = s->col;
     int w4 = bwh_tab[1][b->bs][0] << 1, step1d = 1 << b->tx, n;
@@ -2750,14 +2765,14 @@ static av_always_inline void intra_recon(AVCodecContext *ctx, ptrdiff_t y_off,
     }
 }
 
-static void intra_recon_8bpp(AVCodecContext *ctx, ptrdiff_t y_off, ptrdiff_t uv_off)
+static void intra_recon_8bpp(VP9Context *s, ptrdiff_t y_off, ptrdiff_t uv_off)
 {
-    intra_recon(ctx, y_off, uv_off, 1);
+    intra_recon(s, y_off, uv_off, 1);
 }
 
-static void intra_recon_16bpp(AVCodecContext *ctx, ptrdiff_t y_off, ptrdiff_t uv_off)
+static void intra_recon_16bpp(VP9Context *s, ptrdiff_t y_off, ptrdiff_t uv_off)
 {
-    intra_recon(ctx, y_off, uv_off, 2);
+    intra_recon(s, y_off, uv_off, 2);
 }
 
 static av_always_inline void mc_luma_scaled(VP9Context *s, vp9_scaled_mc_func smc,
@@ -3000,23 +3015,22 @@ static av_always_inline void mc_chroma_unscaled(VP9Context *s, vp9_mc_func (*mc)
 #undef BYTES_PER_PIXEL
 #undef SCALED
 
-static av_always_inline void inter_recon(AVCodecContext *ctx, int bytesperpixel)
+static av_always_inline void inter_recon(VP9Context *s, int bytesperpixel)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     int row = s->row, col = s->col;
 
     if (s->mvscale[b->ref[0]][0] || (b->comp && s->mvscale[b->ref[1]][0])) {
         if (bytesperpixel == 1) {
-            inter_pred_scaled_8bpp(ctx);
+            inter_pred_scaled_8bpp(s);
         } else {
-            inter_pred_scaled_16bpp(ctx);
+            inter_pred_scaled_16bpp(s);
         }
     } else {
         if (bytesperpixel == 1) {
-            inter_pred_8bpp(ctx);
+            inter_pred_8bpp(s);
         } else {
-            inter_pred_16bpp(ctx);
+            inter_pred_16bpp(s);
         }
     }
     if (!b->skip) {
@@ -3066,14 +3080,14 @@ static av_always_inline void inter_recon(AVCodecContext *ctx, int bytesperpixel)
     }
 }
 
-static void inter_recon_8bpp(AVCodecContext *ctx)
+static void inter_recon_8bpp(VP9Context *s)
 {
-    inter_recon(ctx, 1);
+    inter_recon(s, 1);
 }
 
-static void inter_recon_16bpp(AVCodecContext *ctx)
+static void inter_recon_16bpp(VP9Context *s)
 {
-    inter_recon(ctx, 2);
+    inter_recon(s, 2);
 }
 
 static av_always_inline void mask_edges(uint8_t (*mask)[8][4], int ss_h, int ss_v,
@@ -3198,11 +3212,25 @@ static av_always_inline void mask_edges(uint8_t (*mask)[8][4], int ss_h, int ss_
     }
 }
 
-static void decode_b(AVCodecContext *ctx, int row, int col,
+static void init_filter_lut(VP9Context *s, int lvl)
+{
+    int sharp = s->filter.sharpness;
+    int limit = lvl;
+
+    if (sharp > 0) {
+        limit >>= (sharp + 3) >> 2;
+        limit = FFMIN(limit, 9 - sharp);
+    }
+    limit = FFMAX(limit, 1);
+
+    s->filter.lim_lut[lvl] = limit;
+    s->filter.mblim_lut[lvl] = 2 * (lvl + 2) + limit;
+}
+
+static void decode_b(VP9Context *s, int row, int col,
                      struct VP9Filter *lflvl, ptrdiff_t yoff, ptrdiff_t uvoff,
                      enum BlockLevel bl, enum BlockPartition bp)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     enum BlockSize bs = bl * 3 + bp;
     int bytesperpixel = s->bytesperpixel;
@@ -3222,7 +3250,7 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
         b->bs = bs;
         b->bl = bl;
         b->bp = bp;
-        decode_mode(ctx);
+        decode_mode(s);
         b->uvtx = b->tx - ((s->ss_h && w4 * 2 == (1 << b->tx)) ||
                            (s->ss_v && h4 * 2 == (1 << b->tx)));
 
@@ -3230,9 +3258,9 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
             int has_coeffs;
 
             if (bytesperpixel == 1) {
-                has_coeffs = decode_coeffs_8bpp(ctx);
+                has_coeffs = decode_coeffs_8bpp(s);
             } else {
-                has_coeffs = decode_coeffs_16bpp(ctx);
+                has_coeffs = decode_coeffs_16bpp(s);
             }
             if (!has_coeffs && b->bs <= BS_8x8 && !b->intra) {
                 b->skip = 1;
@@ -3313,15 +3341,15 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
     }
     if (b->intra) {
         if (s->bpp > 8) {
-            intra_recon_16bpp(ctx, yoff, uvoff);
+            intra_recon_16bpp(s, yoff, uvoff);
         } else {
-            intra_recon_8bpp(ctx, yoff, uvoff);
+            intra_recon_8bpp(s, yoff, uvoff);
         }
     } else {
         if (s->bpp > 8) {
-            inter_recon_16bpp(ctx);
+            inter_recon_16bpp(s);
         } else {
-            inter_recon_8bpp(ctx);
+            inter_recon_8bpp(s);
         }
     }
     if (emu[0]) {
@@ -3371,19 +3399,8 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
                        s->rows & 1 && row + h4 >= s->rows ? s->rows & 7 : 0,
                        b->uvtx, skip_inter);
 
-        if (!s->filter.lim_lut[lvl]) {
-            int sharp = s->filter.sharpness;
-            int limit = lvl;
-
-            if (sharp > 0) {
-                limit >>= (sharp + 3) >> 2;
-                limit = FFMIN(limit, 9 - sharp);
-            }
-            limit = FFMAX(limit, 1);
-
-            s->filter.lim_lut[lvl] = limit;
-            s->filter.mblim_lut[lvl] = 2 * (lvl + 2) + limit;
-        }
+        if (!s->filter.lim_lut[lvl])
+            init_filter_lut(s, lvl);
     }
 
     if (s->pass == 2) {
@@ -3397,10 +3414,9 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
     }
 }
 
-static void decode_sb(AVCodecContext *ctx, int row, int col, struct VP9Filter *lflvl,
+static void decode_sb(VP9Context *s, int row, int col, struct VP9Filter *lflvl,
                       ptrdiff_t yoff, ptrdiff_t uvoff, enum BlockLevel bl)
 {
-    VP9Context *s = ctx->priv_data;
     int c = ((s->above_partition_ctx[col] >> (3 - bl)) & 1) |
             (((s->left_partition_ctx[row & 0x7] >> (3 - bl)) & 1) << 1);
     const uint8_t *p = s->keyframe || s->intraonly ? vp9_default_kf_partition_probs[bl][c] :
@@ -3413,35 +3429,35 @@ static void decode_sb(AVCodecContext *ctx, int row, int col, struct VP9Filter *l
 
     if (bl == BL_8X8) {
         bp = vp8_rac_get_tree(&s->c, vp9_partition_tree, p);
-        decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+        decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
     } else if (col + hbs < s->cols) { // FIXME why not <=?
         if (row + hbs < s->rows) { // FIXME why not <=?
             bp = vp8_rac_get_tree(&s->c, vp9_partition_tree, p);
             switch (bp) {
             case PARTITION_NONE:
-                decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
                 break;
             case PARTITION_H:
-                decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
                 yoff  += hbs * 8 * y_stride;
                 uvoff += hbs * 8 * uv_stride >> s->ss_v;
-                decode_b(ctx, row + hbs, col, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row + hbs, col, lflvl, yoff, uvoff, bl, bp);
                 break;
             case PARTITION_V:
-                decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
                 yoff  += hbs * 8 * bytesperpixel;
                 uvoff += hbs * 8 * bytesperpixel >> s->ss_h;
-                decode_b(ctx, row, col + hbs, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row, col + hbs, lflvl, yoff, uvoff, bl, bp);
                 break;
             case PARTITION_SPLIT:
-                decode_sb(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
-                decode_sb(ctx, row, col + hbs, lflvl,
+                decode_sb(s, row, col, lflvl, yoff, uvoff, bl + 1);
+                decode_sb(s, row, col + hbs, lflvl,
                           yoff + 8 * hbs * bytesperpixel,
                           uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
                 yoff  += hbs * 8 * y_stride;
                 uvoff += hbs * 8 * uv_stride >> s->ss_v;
-                decode_sb(ctx, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
-                decode_sb(ctx, row + hbs, col + hbs, lflvl,
+                decode_sb(s, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
+                decode_sb(s, row + hbs, col + hbs, lflvl,
                           yoff + 8 * hbs * bytesperpixel,
                           uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
                 break;
@@ -3450,36 +3466,35 @@ static void decode_sb(AVCodecContext *ctx, int row, int col, struct VP9Filter *l
             }
         } else if (vp56_rac_get_prob_branchy(&s->c, p[1])) {
             bp = PARTITION_SPLIT;
-            decode_sb(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
-            decode_sb(ctx, row, col + hbs, lflvl,
+            decode_sb(s, row, col, lflvl, yoff, uvoff, bl + 1);
+            decode_sb(s, row, col + hbs, lflvl,
                       yoff + 8 * hbs * bytesperpixel,
                       uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
         } else {
             bp = PARTITION_H;
-            decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+            decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
         }
     } else if (row + hbs < s->rows) { // FIXME why not <=?
         if (vp56_rac_get_prob_branchy(&s->c, p[2])) {
             bp = PARTITION_SPLIT;
-            decode_sb(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
+            decode_sb(s, row, col, lflvl, yoff, uvoff, bl + 1);
             yoff  += hbs * 8 * y_stride;
             uvoff += hbs * 8 * uv_stride >> s->ss_v;
-            decode_sb(ctx, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
+            decode_sb(s, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
         } else {
             bp = PARTITION_V;
-            decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+            decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
         }
     } else {
         bp = PARTITION_SPLIT;
-        decode_sb(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
+        decode_sb(s, row, col, lflvl, yoff, uvoff, bl + 1);
     }
     s->counts.partition[bl][c][bp]++;
 }
 
-static void decode_sb_mem(AVCodecContext *ctx, int row, int col, struct VP9Filter *lflvl,
+static void decode_sb_mem(VP9Context *s, int row, int col, struct VP9Filter *lflvl,
                           ptrdiff_t yoff, ptrdiff_t uvoff, enum BlockLevel bl)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     ptrdiff_t hbs = 4 >> bl;
     AVFrame *f = s->frames[CUR_FRAME].tf.f;
@@ -3488,39 +3503,39 @@ static void decode_sb_mem(AVCodecContext *ctx, int row, int col, struct VP9Filte
 
     if (bl == BL_8X8) {
         av_assert2(b->bl == BL_8X8);
-        decode_b(ctx, row, col, lflvl, yoff, uvoff, b->bl, b->bp);
+        decode_b(s, row, col, lflvl, yoff, uvoff, b->bl, b->bp);
     } else if (s->b->bl == bl) {
-        decode_b(ctx, row, col, lflvl, yoff, uvoff, b->bl, b->bp);
+        decode_b(s, row, col, lflvl, yoff, uvoff, b->bl, b->bp);
         if (b->bp == PARTITION_H && row + hbs < s->rows) {
             yoff  += hbs * 8 * y_stride;
             uvoff += hbs * 8 * uv_stride >> s->ss_v;
-            decode_b(ctx, row + hbs, col, lflvl, yoff, uvoff, b->bl, b->bp);
+            decode_b(s, row + hbs, col, lflvl, yoff, uvoff, b->bl, b->bp);
         } else if (b->bp == PARTITION_V && col + hbs < s->cols) {
             yoff  += hbs * 8 * bytesperpixel;
             uvoff += hbs * 8 * bytesperpixel >> s->ss_h;
-            decode_b(ctx, row, col + hbs, lflvl, yoff, uvoff, b->bl, b->bp);
+            decode_b(s, row, col + hbs, lflvl, yoff, uvoff, b->bl, b->bp);
         }
     } else {
-        decode_sb_mem(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
+        decode_sb_mem(s, row, col, lflvl, yoff, uvoff, bl + 1);
         if (col + hbs < s->cols) { // FIXME why not <=?
             if (row + hbs < s->rows) {
-                decode_sb_mem(ctx, row, col + hbs, lflvl, yoff + 8 * hbs * bytesperpixel,
+                decode_sb_mem(s, row, col + hbs, lflvl, yoff + 8 * hbs * bytesperpixel,
                               uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
                 yoff  += hbs * 8 * y_stride;
                 uvoff += hbs * 8 * uv_stride >> s->ss_v;
-                decode_sb_mem(ctx, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
-                decode_sb_mem(ctx, row + hbs, col + hbs, lflvl,
+                decode_sb_mem(s, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
+                decode_sb_mem(s, row + hbs, col + hbs, lflvl,
                               yoff + 8 * hbs * bytesperpixel,
                               uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
             } else {
                 yoff  += hbs * 8 * bytesperpixel;
                 uvoff += hbs * 8 * bytesperpixel >> s->ss_h;
-                decode_sb_mem(ctx, row, col + hbs, lflvl, yoff, uvoff, bl + 1);
+                decode_sb_mem(s, row, col + hbs, lflvl, yoff, uvoff, bl + 1);
             }
         } else if (row + hbs < s->rows) {
             yoff  += hbs * 8 * y_stride;
             uvoff += hbs * 8 * uv_stride >> s->ss_v;
-            decode_sb_mem(ctx, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
+            decode_sb_mem(s, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
         }
     }
 }
@@ -3953,9 +3968,15 @@ static void adapt_probs(VP9Context *s)
 
 static void free_buffers(VP9Context *s)
 {
+    int i;
+
     av_freep(&s->intra_pred_data[0]);
     av_freep(&s->b_base);
     av_freep(&s->block_base);
+    for (i = 0; i < s->n_tile_ctx; i++) {
+        av_freep(&s->tile_ctx[i].b_base);
+        av_freep(&s->tile_ctx[i].block_base);
+    }
 }
 
 static av_cold int vp9_decode_free(AVCodecContext *ctx)
@@ -3977,25 +3998,376 @@ static av_cold int vp9_decode_free(AVCodecContext *ctx)
         av_frame_free(&s->next_refs[i].f);
     }
     free_buffers(s);
+    av_freep(&s->tile_ctx);
+    s->n_tile_ctx = 0;
     av_freep(&s->c_b);
     s->c_b_size = 0;
+    ff_mutex_destroy(&s->lf_lock);
 
     return 0;
 }
 
 
+static void loopfilter_sbrow(AVCodecContext *ctx, struct VP9Filter *lflvl_ptr,
+                             int row, ptrdiff_t yoff, ptrdiff_t uvoff)
+{
+    VP9Context *s = ctx->priv_data;
+    int col;
+
+    // loopfilter one row
+    if (s->filter.level) {
+        for (col = 0; col < s->cols;
+             col += 8, yoff += 64 * s->bytesperpixel,
+             uvoff += 64 * s->bytesperpixel >> s->ss_h, lflvl_ptr++) {
+            loopfilter_sb(ctx, lflvl_ptr, row, col, yoff, uvoff);
+        }
+    }
+
+    // FIXME maybe we can make this more finegrained by running the
+    // loopfilter per-block instead of after each sbrow
+    // In fact that would also make intra pred left preparation easier?
+    ff_thread_report_progress(&s->frames[CUR_FRAME].tf, row >> 3, 0);
+}
+
+static int decode_tiles(AVCodecContext *ctx,
+                        const uint8_t *data, int size)
+{
+    VP9Context *s = ctx->priv_data;
+    AVFrame *f = s->frames[CUR_FRAME].tf.f;
+    int tile_row, tile_col, row, col;
+    ptrdiff_t yoff, uvoff, ls_y, ls_uv;
+    int bytesperpixel = s->bytesperpixel;
+
+    ls_y = f->linesize[0];
+    ls_uv = f->linesize[1];
+
+    yoff = uvoff = 0;
+    s->b = s->b_base;
+    s->block = s->block_base;
+    s->uvblock[0] = s->uvblock_base[0];
+    s->uvblock[1] = s->uvblock_base[1];
+    s->eob = s->eob_base;
+    s->uveob[0] = s->uveob_base[0];
+    s->uveob[1] = s->uveob_base[1];
+
+    for (tile_row = 0; tile_row < s->tiling.tile_rows; tile_row++) {
+        set_tile_offset(&s->tiling.tile_row_start, &s->tiling.tile_row_end,
+                        tile_row, s->tiling.log2_tile_rows, s->sb_rows);
+        if (s->pass != 2) {
+            for (tile_col = 0; tile_col < s->tiling.tile_cols; tile_col++) {
+                int64_t tile_size;
+
+                if (tile_col == s->tiling.tile_cols - 1 &&
+                    tile_row == s->tiling.tile_rows - 1) {
+                    tile_size = size;
+                } else {
+                    tile_size = AV_RB32(data);
+                    data += 4;
+                    size -= 4;
+                }
+                if (tile_size > size) {
+                    ff_thread_report_progress(&s->frames[CUR_FRAME].tf, INT_MAX, 0);
+                    return AVERROR_INVALIDDATA;
+                }
+                ff_vp56_init_range_decoder(&s->c_b[tile_col], data, tile_size);
+                if (vp56_rac_get_prob_branchy(&s->c_b[tile_col], 128)) { // marker bit
+                    ff_thread_report_progress(&s->frames[CUR_FRAME].tf, INT_MAX, 0);
+                    return AVERROR_INVALIDDATA;
+                }
+                data += tile_size;
+                size -= tile_size;
+            }
+        }
+
+        for (row = s->tiling.tile_row_start; row < s->tiling.tile_row_end;
+             row += 8, yoff += ls_y * 64, uvoff += ls_uv * 64 >> s->ss_v) {
+            struct VP9Filter *lflvl_ptr = s->lflvl;
+            ptrdiff_t yoff2 = yoff, uvoff2 = uvoff;
+
+            for (tile_col = 0; tile_col < s->tiling.tile_cols; tile_col++) {
+                set_tile_offset(&s->tiling.tile_col_start, &s->tiling.tile_col_end,
+                                tile_col, s->tiling.log2_tile_cols, s->sb_cols);
+
+                if (s->pass != 2) {
+                    memset(s->left_partition_ctx, 0, 8);
+                    memset(s->left_skip_ctx, 0, 8);
+                    if (s->keyframe || s->intraonly) {
+                        memset(s->left_mode_ctx, DC_PRED, 16);
+                    } else {
+                        memset(s->left_mode_ctx, NEARESTMV, 8);
+                    }
+                    memset(s->left_y_nnz_ctx, 0, 16);
+                    memset(s->left_uv_nnz_ctx, 0, 32);
+                    memset(s->left_segpred_ctx, 0, 8);
+
+                    memcpy(&s->c, &s->c_b[tile_col], sizeof(s->c));
+                }
+
+                for (col = s->tiling.tile_col_start;
+                     col < s->tiling.tile_col_end;
+                     col += 8, yoff2 += 64 * bytesperpixel,
+                     uvoff2 += 64 * bytesperpixel >> s->ss_h, lflvl_ptr++) {
+                    // FIXME integrate with lf code (i.e. zero after each
+                    // use, similar to invtxfm coefficients, or similar)
+                    if (s->pass != 1) {
+                        memset(lflvl_ptr->mask, 0, sizeof(lflvl_ptr->mask));
+                    }
+
+                    if (s->pass == 2) {
+                        decode_sb_mem(s, row, col, lflvl_ptr,
+                                      yoff2, uvoff2, BL_64X64);
+                    } else {
+                        decode_sb(s, row, col, lflvl_ptr,
+                                  yoff2, uvoff2, BL_64X64);
+                    }
+                }
+                if (s->pass != 2) {
+                    memcpy(&s->c_b[tile_col], &s->c, sizeof(s->c));
+                }
+            }
+
+            if (s->pass == 1) {
+                continue;
+            }
+
+            // backup pre-loopfilter reconstruction data for intra
+            // prediction of next row of sb64s
+            if (row + 8 < s->rows) {
+                memcpy(s->intra_pred_data[0],
+                       f->data[0] + yoff + 63 * ls_y,
+                       8 * s->cols * bytesperpixel);
+                memcpy(s->intra_pred_data[1],
+                       f->data[1] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv,
+                       8 * s->cols * bytesperpixel >> s->ss_h);
+                memcpy(s->intra_pred_data[2],
+                       f->data[2] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv,
+                       8 * s->cols * bytesperpixel >> s->ss_h);
+            }
+
+            loopfilter_sbrow(ctx, s->lflvl, row, yoff, uvoff);
+        }
+    }
+
+    return 0;
+}
+
+#define COPY_FIELDS(dst, src, first, last)                                   \
+    memcpy(&(dst)->first, &(src)->first,                                    \
+           offsetof(VP9Context, last) + sizeof((src)->last) -               \
+           offsetof(VP9Context, first))
+
+/* Set up a tile context with the frame state of the main context. Block
+ * buffers, counts and the left context are owned by the tile context, the
+ * threading state only lives in the main context and is not copied. */
+static int update_tile_context(VP9Context *dst, VP9Context *src)
+{
+    dst->dsp  = src->dsp;
+    dst->vdsp = src->vdsp;
+    dst->pass = src->pass;
+    // bitstream header up to the frame dimensions
+    COPY_FIELDS(dst, src, keyframe, cols);
+    dst->prob         = src->prob;
+    dst->txfmmode     = src->txfmmode;
+    dst->comppredmode = src->comppredmode;
+    // above context and whole-frame cache
+    COPY_FIELDS(dst, src, above_partition_ctx, lflvl);
+    memcpy(dst->mvscale, src->mvscale, sizeof(dst->mvscale));
+    memcpy(dst->mvstep,  src->mvstep,  sizeof(dst->mvstep));
+    dst->sbrows_done = 0;
+    memset(&dst->counts, 0, sizeof(dst->counts));
+
+    return update_block_buffers(dst);
+}
+
+/* Called by a tile thread after it has decoded (and backed up the intra
+ * prediction edge of) a sb64 row. The thread which completes the last
+ * outstanding tile of a row filters it, unless another thread is already
+ * filtering, in which case that thread picks the row up afterwards. */
+static void tile_sbrow_done(AVCodecContext *ctx, VP9Context *ts, int row)
+{
+    VP9Context *s = ctx->priv_data;
+    AVFrame *f = s->frames[CUR_FRAME].tf.f;
+    ptrdiff_t ls_y = f->linesize[0], ls_uv = f->linesize[1];
+    int i, done;
+
+    ff_mutex_lock(&s->lf_lock);
+    ts->sbrows_done = (row >> 3) + 1;
+    if (!s->lf_busy) {
+        s->lf_busy = 1;
+        for (;;) {
+            done = INT_MAX;
+            for (i = 0; i < s->tiling.tile_cols; i++)
+                done = FFMIN(done, s->tile_ctx[i].sbrows_done);
+            if (s->lf_sbrow >= done)
+                break;
+            row = s->lf_sbrow;
+            ff_mutex_unlock(&s->lf_lock);
+            loopfilter_sbrow(ctx, s->lflvl + row * s->sb_cols, row << 3,
+                             row * ls_y * 64, row * (ls_uv * 64 >> s->ss_v));
+            ff_mutex_lock(&s->lf_lock);
+            s->lf_sbrow++;
+        }
+        s->lf_busy = 0;
+    }
+    ff_mutex_unlock(&s->lf_lock);
+}
+
+static int decode_tile_col_sliced(AVCodecContext *ctx, void *tdata,
+                                  int jobnr, int threadnr)
+{
+    VP9Context *s = ctx->priv_data, *ts = &s->tile_ctx[jobnr];
+    AVFrame *f = s->frames[CUR_FRAME].tf.f;
+    ptrdiff_t ls_y = f->linesize[0], ls_uv = f->linesize[1];
+    int bytesperpixel = s->bytesperpixel;
+    int col_start = ts->tiling.tile_col_start;
+    int col_end = FFMIN(ts->tiling.tile_col_end, s->cols);
+    ptrdiff_t yoff  = (ts->tiling.tile_row_start >> 3) * ls_y * 64;
+    ptrdiff_t uvoff = (ts->tiling.tile_row_start >> 3) * (ls_uv * 64 >> s->ss_v);
+    int row, col, p;
+
+    ts->b = ts->b_base;
+    ts->block = ts->block_base;
+    ts->uvblock[0] = ts->uvblock_base[0];
+    ts->uvblock[1] = ts->uvblock_base[1];
+    ts->eob = ts->eob_base;
+    ts->uveob[0] = ts->uveob_base[0];
+    ts->uveob[1] = ts->uveob_base[1];
+
+    for (row = ts->tiling.tile_row_start; row < ts->tiling.tile_row_end;
+         row += 8, yoff += ls_y * 64, uvoff += ls_uv * 64 >> s->ss_v) {
+        struct VP9Filter *lflvl_ptr = s->lflvl + (row >> 3) * s->sb_cols +
+                                      (col_start >> 3);
+        ptrdiff_t yoff2  = yoff  + (col_start >> 3) * 64 * bytesperpixel;
+        ptrdiff_t uvoff2 = uvoff + (col_start >> 3) * (64 * bytesperpixel >> s->ss_h);
+
+        memset(ts->left_partition_ctx, 0, 8);
+        memset(ts->left_skip_ctx, 0, 8);
+        if (ts->keyframe || ts->intraonly) {
+            memset(ts->left_mode_ctx, DC_PRED, 16);
+        } else {
+            memset(ts->left_mode_ctx, NEARESTMV, 8);
+        }
+        memset(ts->left_y_nnz_ctx, 0, 16);
+        memset(ts->left_uv_nnz_ctx, 0, 32);
+        memset(ts->left_segpred_ctx, 0, 8);
+
+        for (col = col_start; col < ts->tiling.tile_col_end;
+             col += 8, yoff2 += 64 * bytesperpixel,
+             uvoff2 += 64 * bytesperpixel >> s->ss_h, lflvl_ptr++) {
+            memset(lflvl_ptr->mask, 0, sizeof(lflvl_ptr->mask));
+            decode_sb(ts, row, col, lflvl_ptr, yoff2, uvoff2, BL_64X64);
+        }
+
+        // backup pre-loopfilter reconstruction data for intra
+        // prediction of next row of sb64s, for the columns of this tile
+        if (row + 8 < s->rows) {
+            memcpy(s->intra_pred_data[0] + col_start * 8 * bytesperpixel,
+                   f->data[0] + yoff + 63 * ls_y + col_start * 8 * bytesperpixel,
+                   8 * (col_end - col_start) * bytesperpixel);
+            for (p = 1; p < 3; p++)
+                memcpy(s->intra_pred_data[p] + (col_start * 8 * bytesperpixel >> s->ss_h),
+                       f->data[p] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv +
+                       (col_start * 8 * bytesperpixel >> s->ss_h),
+                       8 * (col_end - col_start) * bytesperpixel >> s->ss_h);
+        }
+
+        tile_sbrow_done(ctx, ts, row);
+    }
+
+    return 0;
+}
+
+static int decode_tiles_sliced(AVCodecContext *ctx,
+                               const uint8_t *data, int size)
+{
+    VP9Context *s = ctx->priv_data;
+    int tile_row, tile_col, i, res;
+
+    if (s->n_tile_ctx < s->tiling.tile_cols) {
+        for (i = 0; i < s->n_tile_ctx; i++) {
+            av_freep(&s->tile_ctx[i].b_base);
+            av_freep(&s->tile_ctx[i].block_base);
+        }
+        av_freep(&s->tile_ctx);
+        s->n_tile_ctx = 0;
+        s->tile_ctx = av_mallocz_array(s->tiling.tile_cols, sizeof(*s->tile_ctx));
+        if (!s->tile_ctx)
+            return AVERROR(ENOMEM);
+        s->n_tile_ctx = s->tiling.tile_cols;
+    }
+    // the loopfilter runs on this context while the tiles are decoded, so
+    // fill the limit LUTs for all levels upfront instead of in decode_b()
+    for (i = 1; i < 64; i++)
+        if (!s->filter.lim_lut[i])
+            init_filter_lut(s, i);
+    for (tile_col = 0; tile_col < s->tiling.tile_cols; tile_col++) {
+        if ((res = update_tile_context(&s->tile_ctx[tile_col], s)) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Failed to allocate block buffers\n");
+            return res;
+        }
+    }
+    s->lf_sbrow = 0;
+    s->lf_busy  = 0;
+
+    for (tile_row = 0; tile_row < s->tiling.tile_rows; tile_row++) {
+        set_tile_offset(&s->tiling.tile_row_start, &s->tiling.tile_row_end,
+                        tile_row, s->tiling.log2_tile_rows, s->sb_rows);
+        for (tile_col = 0; tile_col < s->tiling.tile_cols; tile_col++) {
+            VP9Context *ts = &s->tile_ctx[tile_col];
+            int64_t tile_size;
+
+            if (tile_col == s->tiling.tile_cols - 1 &&
+                tile_row == s->tiling.tile_rows - 1) {
+                tile_size = size;
+            } else {
+                tile_size = AV_RB32(data);
+                data += 4;
+                size -= 4;
+            }
+            if (tile_size > size) {
+                ff_thread_report_progress(&s->frames[CUR_FRAME].tf, INT_MAX, 0);
+                return AVERROR_INVALIDDATA;
+            }
+            ff_vp56_init_range_decoder(&ts->c, data, tile_size);
+            if (vp56_rac_get_prob_branchy(&ts->c, 128)) { // marker bit
+                ff_thread_report_progress(&s->frames[CUR_FRAME].tf, INT_MAX, 0);
+                return AVERROR_INVALIDDATA;
+            }
+            data += tile_size;
+            size -= tile_size;
+
+            ts->tiling.tile_row_start = s->tiling.tile_row_start;
+            ts->tiling.tile_row_end   = s->tiling.tile_row_end;
+            set_tile_offset(&ts->tiling.tile_col_start, &ts->tiling.tile_col_end,
+                            tile_col, s->tiling.log2_tile_cols, s->sb_cols);
+        }
+
+        ctx->execute2(ctx, decode_tile_col_sliced, s->tile_ctx, NULL,
+                      s->tiling.tile_cols);
+    }
+
+    // the symbol counts of all tiles feed the backward adaptation
+    for (tile_col = 0; tile_col < s->tiling.tile_cols; tile_col++) {
+        unsigned *dst = (unsigned *) &s->counts;
+        unsigned *src = (unsigned *) &s->tile_ctx[tile_col].counts;
+
+        for (i = 0; i < sizeof(s->counts) / sizeof(unsigned); i++)
+            dst[i] += src[i];
+    }
+
+    return 0;
+}
+
 static int vp9_decode_frame(AVCodecContext *ctx, void *frame,
                             int *got_frame, AVPacket *pkt)
 {
     const uint8_t *data = pkt->data;
     int size = pkt->size;
     VP9Context *s = ctx->priv_data;
-    int res, tile_row, tile_col, i, ref, row, col;
+    int res, i, ref;
     int retain_segmap_ref = s->segmentation.enabled && !s->segmentation.update_map
                             && s->frames[REF_FRAME_SEGMAP].segmentation_map;
-    ptrdiff_t yoff, uvoff, ls_y, ls_uv;
     AVFrame *f;
-    int bytesperpixel;
 
     if ((res = decode_frame_header(ctx, data, size, &ref)) < 0) {
         return res;
@@ -4040,8 +4412,6 @@ static int vp9_decode_frame(AVCodecContext *ctx, void *frame,
     f = s->frames[CUR_FRAME].tf.f;
     f->key_frame = s->keyframe;
     f->pict_type = (s->keyframe || s->intraonly) ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_P;
-    ls_y = f->linesize[0];
-    ls_uv =f->linesize[1];
 
     // ref frame setup
     for (i = 0; i < 8; i++) {
@@ -4057,7 +4427,6 @@ static int vp9_decode_frame(AVCodecContext *ctx, void *frame,
     }
 
     // main tile decode loop
-    bytesperpixel = s->bytesperpixel;
     memset(s->above_partition_ctx, 0, s->cols);
     memset(s->above_skip_ctx, 0, s->cols);
     if (s->keyframe || s->intraonly) {
@@ -4071,7 +4440,7 @@ static int vp9_decode_frame(AVCodecContext *ctx, void *frame,
     memset(s->above_segpred_ctx, 0, s->cols);
     s->pass = s->frames[CUR_FRAME].uses_2pass =
         ctx->active_thread_type == FF_THREAD_FRAME && s->refreshctx && !s->parallelmode;
-    if ((res = update_block_buffers(ctx)) < 0) {
+    if ((res = update_block_buffers(s)) < 0) {
         av_log(ctx, AV_LOG_ERROR,
                "Failed to allocate block buffers\n");
         return res;
@@ -4096,128 +4465,12 @@ static int vp9_decode_frame(AVCodecContext *ctx, void *frame,
     }
 
     do {
-        yoff = uvoff = 0;
-        s->b = s->b_base;
-        s->block = s->block_base;
-        s->uvblock[0] = s->uvblock_base[0];
-        s->uvblock[1] = s->uvblock_base[1];
-        s->eob = s->eob_base;
-        s->uveob[0] = s->uveob_base[0];
-        s->uveob[1] = s->uveob_base[1];
-
-        for (tile_row = 0; tile_row < s->tiling.tile_rows; tile_row++) {
-            set_tile_offset(&s->tiling.tile_row_start, &s->tiling.tile_row_end,
-                            tile_row, s->tiling.log2_tile_rows, s->sb_rows);
-            if (s->pass != 2) {
-                for (tile_col = 0; tile_col < s->tiling.tile_cols; tile_col++) {
-                    int64_t tile_size;
-
-                    if (tile_col == s->tiling.tile_cols - 1 &&
-                        tile_row == s->tiling.tile_rows - 1) {
-                        tile_size = size;
-                    } else {
-                        tile_size = AV_RB32(data);
-                        data += 4;
-                        size -= 4;
-                    }
-                    if (tile_size > size) {
-                        ff_thread_report_progress(&s->frames[CUR_FRAME].tf, INT_MAX, 0);
-                        return AVERROR_INVALIDDATA;
-                    }
-                    ff_vp56_init_range_decoder(&s->c_b[tile_col], data, tile_size);
-                    if (vp56_rac_get_prob_branchy(&s->c_b[tile_col], 128)) { // marker bit
-                        ff_thread_report_progress(&s->frames[CUR_FRAME].tf, INT_MAX, 0);
-                        return AVERROR_INVALIDDATA;
-                    }
-                    data += tile_size;
-                    size -= tile_size;
-                }
-            }
-
-            for (row = s->tiling.tile_row_start; row < s->tiling.tile_row_end;
-                 row += 8, yoff += ls_y * 64, uvoff += ls_uv * 64 >> s->ss_v) {
-                struct VP9Filter *lflvl_ptr = s->lflvl;
-                ptrdiff_t yoff2 = yoff, uvoff2 = uvoff;
-
-                for (tile_col = 0; tile_col < s->tiling.tile_cols; tile_col++) {
-                    set_tile_offset(&s->tiling.tile_col_start, &s->tiling.tile_col_end,
-                                    tile_col, s->tiling.log2_tile_cols, s->sb_cols);
-
-                    if (s->pass != 2) {
-                        memset(s->left_partition_ctx, 0, 8);
-                        memset(s->left_skip_ctx, 0, 8);
-                        if (s->keyframe || s->intraonly) {
-                            memset(s->left_mode_ctx, DC_PRED, 16);
-                        } else {
-                            memset(s->left_mode_ctx, NEARESTMV, 8);
-                        }
-                        memset(s->left_y_nnz_ctx, 0, 16);
-                        memset(s->left_uv_nnz_ctx, 0, 32);
-                        memset(s->left_segpred_ctx, 0, 8);
-
-                        memcpy(&s->c, &s->c_b[tile_col], sizeof(s->c));
-                    }
-
-                    for (col = s->tiling.tile_col_start;
-                         col < s->tiling.tile_col_end;
-                         col += 8, yoff2 += 64 * bytesperpixel,
-                         uvoff2 += 64 * bytesperpixel >> s->ss_h, lflvl_ptr++) {
-                        // FIXME integrate with lf code (i.e. zero after each
-                        // use, similar to invtxfm coefficients, or similar)
-                        if (s->pass != 1) {
-                            memset(lflvl_ptr->mask, 0, sizeof(lflvl_ptr->mask));
-                        }
-
-                        if (s->pass == 2) {
-                            decode_sb_mem(ctx, row, col, lflvl_ptr,
-                                          yoff2, uvoff2, BL_64X64);
-                        } else {
-                            decode_sb(ctx, row, col, lflvl_ptr,
-                                      yoff2, uvoff2, BL_64X64);
-                        }
-                    }
-                    if (s->pass != 2) {
-                        memcpy(&s->c_b[tile_col], &s->c, sizeof(s->c));
-                    }
-                }
-
-                if (s->pass == 1) {
-                    continue;
-                }
-
-                // backup pre-loopfilter reconstruction data for intra
-                // prediction of next row of sb64s
-                if (row + 8 < s->rows) {
-                    memcpy(s->intra_pred_data[0],
-                           f->data[0] + yoff + 63 * ls_y,
-                           8 * s->cols * bytesperpixel);
-                    memcpy(s->intra_pred_data[1],
-                           f->data[1] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv,
-                           8 * s->cols * bytesperpixel >> s->ss_h);
-                    memcpy(s->intra_pred_data[2],
-                           f->data[2] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv,
-                           8 * s->cols * bytesperpixel >> s->ss_h);
-                }
-
-                // loopfilter one row
-                if (s->filter.level) {
-                    yoff2 = yoff;
-                    uvoff2 = uvoff;
-                    lflvl_ptr = s->lflvl;
-                    for (col = 0; col < s->cols;
-                         col += 8, yoff2 += 64 * bytesperpixel,
-                         uvoff2 += 64 * bytesperpixel >> s->ss_h, lflvl_ptr++) {
-                        loopfilter_sb(ctx, lflvl_ptr, row, col, yoff2, uvoff2);
-                    }
-                }
-
-                // FIXME maybe we can make this more finegrained by running the
-                // loopfilter per-block instead of after each sbrow
-                // In fact that would also make intra pred left preparation easier?
-                ff_thread_report_progress(&s->frames[CUR_FRAME].tf, row >> 3, 0);
-            }
-        }
-
+        if (ctx->active_thread_type == FF_THREAD_SLICE && s->tiling.tile_cols > 1)
+            res = decode_tiles_sliced(ctx, data, size);
+        else
+            res = decode_tiles(ctx, data, size);
+        if (res < 0)
+            return res;
         if (s->pass < 2 && s->refreshctx && !s->parallelmode) {
             adapt_probs(s);
             ff_thread_finish_setup(ctx);
@@ -4281,16 +4534,27 @@ static int init_frames(AVCodecContext *ctx)
 static av_cold int vp9_decode_init(AVCodecContext *ctx)
 {
     VP9Context *s = ctx->priv_data;
+    int ret;
 
     ctx->internal->allocate_progress = 1;
     s->last_bpp = 0;
     s->filter.sharpness = -1;
+    if ((ret = ff_mutex_init(&s->lf_lock, NULL)))
+        return AVERROR(ret);
 
     return init_frames(ctx);
 }
 
 static av_cold int vp9_decode_init_thread_copy(AVCodecContext *avctx)
 {
+    VP9Context *s = avctx->priv_data;
+    int ret;
+
+    s->tile_ctx = NULL;
+    s->n_tile_ctx = 0;
+    if ((ret = ff_mutex_init(&s->lf_lock, NULL)))
+        return AVERROR(ret);
+
     return init_frames(avctx);
 }
 
@@ -4358,7 +4622,8 @@ AVCodec ff_vp9_decoder = {
     .init                  = vp9_decode_init,
     .close                 = vp9_decode_free,
     .decode                = vp9_decode_frame,
-    .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS,
+    .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                             AV_CODEC_CAP_SLICE_THREADS,
     .flush                 = vp9_decode_flush,
     .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vp9_decode_init_thread_copy),
     .update_thread_context = ONLY_IF_THREADS_ENABLED(vp9_decode_update_thread_context),
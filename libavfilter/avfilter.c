@@ -35,6 +35,7 @@
 #include "audio.h"
 #include "avfilter.h"
 #include "formats.h"
+#include "framepool.h"
 #include "internal.h"
 
 #include "libavutil/ffversion.h"
@@ -168,6 +169,7 @@ void avfilter_link_free(AVFilterLink **link)
         return;
 
     av_frame_free(&(*link)->partial_buf);
+    ff_frame_pool_uninit((FFFramePool**)&(*link)->frame_pool);
 
     av_freep(link);
 }
@@ -247,6 +249,7 @@ int avfilter_config_links(AVFilterContext *filter)
             return 0;
         case AVLINK_UNINIT:
             link->init_state = AVLINK_STARTINIT;
+            ff_frame_pool_uninit((FFFramePool**)&link->frame_pool);
 
             if ((ret = avfilter_config_links(link->src)) < 0)
                 return ret;
@@ -453,8 +456,11 @@ void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
         return;
     link->current_pts = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
     /* TODO use duration */
-    if (link->graph && link->age_index >= 0)
+    if (link->graph && link->age_index >= 0) {
+        ff_graph_lock(link->graph);
         ff_avfilter_graph_update_heap(link->graph, link);
+        ff_graph_unlock(link->graph);
+    }
 }
 
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags)
@@ -701,9 +707,19 @@ int avfilter_open(AVFilterContext **filter_ctx, AVFilter *filter, const char *in
 
 static void free_link(AVFilterLink *link)
 {
+    uint64_t hits, misses;
+
     if (!link)
         return;
 
+    if (link->frame_pool && link->src && link->dst) {
+        ff_frame_pool_get_stats(link->frame_pool, &hits, &misses);
+        av_log(link->dst, AV_LOG_DEBUG,
+               "frame pool of link %s:%s -> %s:%s: %"PRIu64" hits, %"PRIu64" misses\n",
+               link->src->name, link->srcpad->name,
+               link->dst->name, link->dstpad->name, hits, misses);
+    }
+
     if (link->src)
         link->src->outputs[link->srcpad - link->src->output_pads] = NULL;
     if (link->dst)
@@ -1173,6 +1189,53 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
     }
 }
 
+static int filter_frame_output(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AVFrame **frames = arg;
+
+    if (!frames[jobnr])
+        return 0;
+    return ff_filter_frame(ctx->outputs[jobnr], frames[jobnr]);
+}
+
+int ff_filter_frame_outputs(AVFilterContext *ctx, AVFrame **frames)
+{
+    int *rets;
+    int i, ret = 0;
+
+    if (ctx->internal->concurrent_outputs && ctx->graph->internal->frame_execute) {
+        rets = av_malloc_array(ctx->nb_outputs, sizeof(*rets));
+        if (!rets) {
+            for (i = 0; i < ctx->nb_outputs; i++)
+                av_frame_free(&frames[i]);
+            return AVERROR(ENOMEM);
+        }
+        ctx->graph->internal->frame_execute(ctx, filter_frame_output, frames,
+                                            rets, ctx->nb_outputs);
+        for (i = 0; i < ctx->nb_outputs; i++) {
+            if (rets[i] < 0) {
+                ret = rets[i];
+                break;
+            }
+        }
+        av_free(rets);
+        return ret;
+    }
+
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        if (!frames[i])
+            continue;
+        ret = ff_filter_frame(ctx->outputs[i], frames[i]);
+        frames[i] = NULL;
+        if (ret < 0)
+            break;
+    }
+    for (; i < ctx->nb_outputs; i++)
+        av_frame_free(&frames[i]);
+
+    return ret;
+}
+
 const AVClass *avfilter_get_class(void)
 {
     return &avfilter_class;
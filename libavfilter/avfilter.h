@@ -627,6 +627,13 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Process independent branches of a graph concurrently, e.g. the chains fed
+ * by the outputs of a split filter when they do not share any filter.
+ * Only meaningful for AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_FRAME (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -860,6 +867,11 @@ struct AVFilterLink {
      * Number of past frames sent through the link.
      */
     int64_t frame_count;
+
+    /**
+     * A pointer to a FFFramePool struct.
+     */
+    void *frame_pool;
 };
 
 /**
@@ -43,6 +43,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = FLAGS, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, FLAGS },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
@@ -71,6 +72,14 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+void ff_graph_lock(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_unlock(AVFilterGraph *graph)
+{
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -1199,6 +1208,87 @@ static int graph_insert_fifos(AVFilterGraph *graph, AVClass *log_ctx)
     return 0;
 }
 
+static int filter_index(AVFilterGraph *graph, AVFilterContext *f)
+{
+    int i;
+
+    for (i = 0; i < graph->nb_filters; i++)
+        if (graph->filters[i] == f)
+            return i;
+    return -1;
+}
+
+/**
+ * Mark with id all the filters connected to f, without going through stop.
+ *
+ * @return 1 if a filter already belonging to another branch is reached,
+ * 0 otherwise
+ */
+static int mark_branch(AVFilterGraph *graph, int *marks, AVFilterContext *f,
+                       AVFilterContext *stop, int id)
+{
+    int i, idx;
+
+    if (f == stop)
+        return 0;
+    idx = filter_index(graph, f);
+    if (idx < 0 || marks[idx] == id)
+        return 0;
+    if (marks[idx] >= 0)
+        return 1;
+    marks[idx] = id;
+
+    for (i = 0; i < f->nb_inputs; i++)
+        if (f->inputs[i] &&
+            mark_branch(graph, marks, f->inputs[i]->src, stop, id))
+            return 1;
+    for (i = 0; i < f->nb_outputs; i++)
+        if (f->outputs[i] &&
+            mark_branch(graph, marks, f->outputs[i]->dst, stop, id))
+            return 1;
+    return 0;
+}
+
+/**
+ * Find the filters whose outputs lead to disjoint parts of the graph,
+ * which can then be run concurrently.
+ */
+static int graph_config_branches(AVFilterGraph *graph, AVClass *log_ctx)
+{
+    int *marks;
+    int i, j, shared;
+
+    if (!graph->internal->frame_execute)
+        return 0;
+
+    marks = av_malloc_array(graph->nb_filters, sizeof(*marks));
+    if (!marks)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (f->nb_outputs < 2)
+            continue;
+
+        for (j = 0; j < graph->nb_filters; j++)
+            marks[j] = -1;
+        shared = 0;
+        for (j = 0; j < f->nb_outputs && !shared; j++)
+            if (f->outputs[j])
+                shared = mark_branch(graph, marks, f->outputs[j]->dst, f, j);
+        if (shared)
+            continue;
+
+        f->internal->concurrent_outputs = 1;
+        av_log(log_ctx, AV_LOG_VERBOSE,
+               "The outputs of '%s' will be processed concurrently\n", f->name);
+    }
+
+    av_free(marks);
+    return 0;
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
@@ -1213,6 +1303,8 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = graph_config_branches(graphctx, log_ctx)))
+        return ret;
 
     return 0;
 }
@@ -156,10 +156,21 @@ struct AVFilterPad {
 struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
+
+    /* pool running independent branches of the graph, AVFILTER_THREAD_FRAME */
+    void *frame_thread;
+    avfilter_execute_func *frame_execute;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+
+    /**
+     * Set when the outputs of the filter lead to disjoint parts of the
+     * graph, so that ff_filter_frame_outputs() may push to them
+     * concurrently.
+     */
+    int concurrent_outputs;
 };
 
 #if FF_API_AVFILTERBUFFER
@@ -365,6 +376,22 @@ int ff_buffersink_read_samples_compat(AVFilterContext *ctx, AVFilterBufferRef **
  */
 int ff_filter_frame(AVFilterLink *link, AVFrame *frame);
 
+/**
+ * Send a frame on each output of a filter.
+ *
+ * If the outputs feed independent branches of the graph and the graph uses
+ * AVFILTER_THREAD_FRAME, the branches are run concurrently and this function
+ * returns once all of them have processed their frame.
+ *
+ * @param ctx    the filter sending the frames
+ * @param frames array of ctx->nb_outputs frames, NULL entries are skipped;
+ *               all the references are taken over by this function
+ *
+ * @return >= 0 on success, the first negative AVERROR returned by an
+ * output otherwise
+ */
+int ff_filter_frame_outputs(AVFilterContext *ctx, AVFrame **frames);
+
 /**
  * Flags for AVFilterLink.flags.
  */
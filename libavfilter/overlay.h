@@ -0,0 +1,60 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef LIBAVFILTER_OVERLAY_H
+#define LIBAVFILTER_OVERLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Number of pixels the row functions process at a time; their width
+ * argument is always a multiple of it.
+ */
+#define OVERLAY_DSP_BLOCK 16
+
+typedef struct OverlayDSPContext {
+    /**
+     * Blend w pixels of s on to d with the overlay alpha in a, for a plane
+     * that is not subsampled and a main picture without alpha.
+     */
+    void (*blend_row)(uint8_t *d, const uint8_t *s, const uint8_t *a, int w);
+
+    /**
+     * Same as blend_row() for a 2x2 subsampled chroma plane; the alpha of
+     * each pixel is the average of the 2x2 block of a it covers.
+     */
+    void (*blend_row_420)(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                          ptrdiff_t alinesize, int w);
+
+    /**
+     * Blend w packed 32-bit pixels of s on to d, both with alpha and the
+     * same component order; the overlay alpha is un-premultiplied against
+     * the main alpha, which is then composited.
+     */
+    void (*blend_row_rgba)(uint8_t *d, const uint8_t *s, int w);
+} OverlayDSPContext;
+
+/**
+ * @param alpha_pos byte offset of the alpha component of packed RGB main
+ *                  pictures, -1 for planar YUV
+ */
+void ff_overlay_init(OverlayDSPContext *dsp, int alpha_pos);
+void ff_overlay_init_x86(OverlayDSPContext *dsp, int alpha_pos);
+
+#endif /* LIBAVFILTER_OVERLAY_H */
@@ -60,6 +60,11 @@ typedef struct ThreadContext {
     int current_job;
     unsigned int current_execute;
     int done;
+
+    /* serializes callers submitting jobs to this pool */
+    pthread_mutex_t execute_lock;
+    /* protects graph state shared between jobs, see ff_graph_lock() */
+    pthread_mutex_t state_lock;
 } ThreadContext;
 
 static void* attribute_align_arg worker(void *v)
@@ -109,6 +114,8 @@ static void slice_thread_uninit(ThreadContext *c)
          pthread_join(c->workers[i], NULL);
 
     pthread_mutex_destroy(&c->current_job_lock);
+    pthread_mutex_destroy(&c->execute_lock);
+    pthread_mutex_destroy(&c->state_lock);
     pthread_cond_destroy(&c->current_job_cond);
     pthread_cond_destroy(&c->last_job_cond);
     av_freep(&c->workers);
@@ -121,15 +128,12 @@ static void slice_thread_park_workers(ThreadContext *c)
     pthread_mutex_unlock(&c->current_job_lock);
 }
 
-static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
-                          void *arg, int *ret, int nb_jobs)
+static void execute_jobs(ThreadContext *c, AVFilterContext *ctx,
+                         avfilter_action_func *func, void *arg, int *ret,
+                         int nb_jobs)
 {
-    ThreadContext *c = ctx->graph->internal->thread;
     int dummy_ret;
 
-    if (nb_jobs <= 0)
-        return 0;
-
     pthread_mutex_lock(&c->current_job_lock);
 
     c->current_job = c->nb_threads;
@@ -149,6 +153,47 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     pthread_cond_broadcast(&c->current_job_cond);
 
     slice_thread_park_workers(c);
+}
+
+static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                          void *arg, int *ret, int nb_jobs)
+{
+    ThreadContext *c = ctx->graph->internal->thread;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    /* independent branches of the graph may run slice threaded filters
+     * at the same time */
+    pthread_mutex_lock(&c->execute_lock);
+    execute_jobs(c, ctx, func, arg, ret, nb_jobs);
+    pthread_mutex_unlock(&c->execute_lock);
+
+    return 0;
+}
+
+static int frame_thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                                void *arg, int *ret, int nb_jobs)
+{
+    ThreadContext *c = ctx->graph->internal->frame_thread;
+    int i, r;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    /* the pool is busy, e.g. because this is a fan-out nested inside one
+     * of the branches it is already running: run the jobs in this thread */
+    if (pthread_mutex_trylock(&c->execute_lock)) {
+        for (i = 0; i < nb_jobs; i++) {
+            r = func(ctx, arg, i, nb_jobs);
+            if (ret)
+                ret[i] = r;
+        }
+        return 0;
+    }
+
+    execute_jobs(c, ctx, func, arg, ret, nb_jobs);
+    pthread_mutex_unlock(&c->execute_lock);
 
     return 0;
 }
@@ -181,6 +226,8 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     pthread_cond_init(&c->current_job_cond, NULL);
     pthread_cond_init(&c->last_job_cond,    NULL);
 
+    pthread_mutex_init(&c->execute_lock, NULL);
+    pthread_mutex_init(&c->state_lock, NULL);
     pthread_mutex_init(&c->current_job_lock, NULL);
     pthread_mutex_lock(&c->current_job_lock);
     for (i = 0; i < nb_threads; i++) {
@@ -226,6 +273,21 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_FRAME) {
+        graph->internal->frame_thread = av_mallocz(sizeof(ThreadContext));
+        if (!graph->internal->frame_thread)
+            return AVERROR(ENOMEM);
+
+        ret = thread_init_internal(graph->internal->frame_thread, graph->nb_threads);
+        if (ret <= 1) {
+            av_freep(&graph->internal->frame_thread);
+            graph->thread_type &= ~AVFILTER_THREAD_FRAME;
+            return (ret < 0) ? ret : 0;
+        }
+
+        graph->internal->frame_execute = frame_thread_execute;
+    }
+
     return 0;
 }
 
@@ -234,4 +296,24 @@ void ff_graph_thread_free(AVFilterGraph *graph)
     if (graph->internal->thread)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
+
+    if (graph->internal->frame_thread)
+        slice_thread_uninit(graph->internal->frame_thread);
+    av_freep(&graph->internal->frame_thread);
+}
+
+void ff_graph_lock(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph->internal->frame_thread;
+
+    if (c)
+        pthread_mutex_lock(&c->state_lock);
+}
+
+void ff_graph_unlock(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph->internal->frame_thread;
+
+    if (c)
+        pthread_mutex_unlock(&c->state_lock);
 }
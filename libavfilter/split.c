@@ -72,24 +72,37 @@ static av_cold void split_uninit(AVFilterContext *ctx)
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
-    int i, ret = AVERROR_EOF;
+    AVFrame **frames;
+    int i, nb_frames = 0, ret = 0;
 
-    for (i = 0; i < ctx->nb_outputs; i++) {
-        AVFrame *buf_out;
+    frames = av_calloc(ctx->nb_outputs, sizeof(*frames));
+    if (!frames) {
+        av_frame_free(&frame);
+        return AVERROR(ENOMEM);
+    }
 
+    for (i = 0; i < ctx->nb_outputs; i++) {
         if (ctx->outputs[i]->closed)
             continue;
-        buf_out = av_frame_clone(frame);
-        if (!buf_out) {
+        frames[i] = av_frame_clone(frame);
+        if (!frames[i]) {
             ret = AVERROR(ENOMEM);
             break;
         }
-
-        ret = ff_filter_frame(ctx->outputs[i], buf_out);
-        if (ret < 0)
-            break;
+        nb_frames++;
     }
     av_frame_free(&frame);
+
+    if (ret < 0) {
+        while (i--)
+            av_frame_free(&frames[i]);
+    } else if (!nb_frames) {
+        ret = AVERROR_EOF;
+    } else {
+        ret = ff_filter_frame_outputs(ctx, frames);
+    }
+
+    av_free(frames);
     return ret;
 }
 
@@ -26,4 +26,12 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Lock/unlock the graph-wide state (e.g. the sink links heap) which may be
+ * updated concurrently when independent branches of the graph are processed
+ * by different threads. No-ops unless AVFILTER_THREAD_FRAME is active.
+ */
+void ff_graph_lock(AVFilterGraph *graph);
+void ff_graph_unlock(AVFilterGraph *graph);
+
 #endif /* AVFILTER_THREAD_H */
@@ -31,6 +31,7 @@
 #include "config.h"
 #include "libavutil/attributes.h"
 #include "libavutil/common.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
@@ -41,6 +42,22 @@
 #include "video.h"
 #include "vf_hqdn3d.h"
 
+/**
+ * With the bands option, planes are cut into bands of at least this many
+ * rows, which are filtered in parallel. The band layout only depends on the
+ * plane height, so the output does not depend on the number of threads.
+ */
+#define BAND_MIN_HEIGHT 256
+/**
+ * Number of rows above a band the spatial filter runs over to rebuild its
+ * vertical state, which hides the band boundary.
+ */
+#define BAND_OVERLAP     16
+
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
 #define LUT_BITS (depth==16 ? 8 : 4)
 #define LOAD(x) (((depth == 8 ? src[x] : AV_RN16A(src + (x) * 2)) << (16 - depth))\
                  + (((1 << (16 - depth)) - 1) >> 1))
@@ -76,11 +93,40 @@ static void denoise_temporal(uint8_t *src, uint8_t *dst,
     }
 }
 
+/**
+ * Run the spatial filter over the h rows above a band, so that line_ant holds
+ * the vertical context a serial pass would have had at its first row.
+ */
+av_always_inline
+static void prime_spatial(uint8_t *src, uint16_t *line_ant,
+                          int w, int h, int sstride,
+                          int16_t *spatial, int depth)
+{
+    long x, y;
+    uint32_t pixel_ant;
+
+    spatial += 256 << LUT_BITS;
+
+    pixel_ant = LOAD(0);
+    for (x = 0; x < w; x++)
+        line_ant[x] = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
+
+    for (y = 1; y < h; y++) {
+        src += sstride;
+        pixel_ant = LOAD(0);
+        for (x = 0; x < w-1; x++) {
+            line_ant[x] = lowpass(line_ant[x], pixel_ant, spatial, depth);
+            pixel_ant = lowpass(pixel_ant, LOAD(x+1), spatial, depth);
+        }
+        line_ant[x] = lowpass(line_ant[x], pixel_ant, spatial, depth);
+    }
+}
+
 av_always_inline
 static void denoise_spatial(HQDN3DContext *s,
                             uint8_t *src, uint8_t *dst,
                             uint16_t *line_ant, uint16_t *frame_ant,
-                            int w, int h, int sstride, int dstride,
+                            int w, int h, int primed, int sstride, int dstride,
                             int16_t *spatial, int16_t *temporal, int depth)
 {
     long x, y;
@@ -90,83 +136,113 @@ static void denoise_spatial(HQDN3DContext *s,
     spatial  += 256 << LUT_BITS;
     temporal += 256 << LUT_BITS;
 
-    /* First line has no top neighbor. Only left one for each tmp and
-     * last frame */
-    pixel_ant = LOAD(0);
-    for (x = 0; x < w; x++) {
-        line_ant[x] = tmp = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
-        frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
-        STORE(x, tmp);
-    }
-
-    for (y = 1; y < h; y++) {
+    if (!primed) {
+        /* First line has no top neighbor. Only left one for each tmp and
+         * last frame */
+        pixel_ant = LOAD(0);
+        for (x = 0; x < w; x++) {
+            line_ant[x] = tmp = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
+            frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+            STORE(x, tmp);
+        }
         src += sstride;
         dst += dstride;
         frame_ant += w;
+        h--;
+    }
+
+    for (y = 0; y < h; y++) {
         if (s->denoise_row[depth]) {
             s->denoise_row[depth](src, dst, line_ant, frame_ant, w, spatial, temporal);
-            continue;
-        }
-        pixel_ant = LOAD(0);
-        for (x = 0; x < w-1; x++) {
+        } else {
+            pixel_ant = LOAD(0);
+            for (x = 0; x < w-1; x++) {
+                line_ant[x] = tmp = lowpass(line_ant[x], pixel_ant, spatial, depth);
+                pixel_ant = lowpass(pixel_ant, LOAD(x+1), spatial, depth);
+                frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+                STORE(x, tmp);
+            }
             line_ant[x] = tmp = lowpass(line_ant[x], pixel_ant, spatial, depth);
-            pixel_ant = lowpass(pixel_ant, LOAD(x+1), spatial, depth);
             frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
             STORE(x, tmp);
         }
-        line_ant[x] = tmp = lowpass(line_ant[x], pixel_ant, spatial, depth);
-        frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
-        STORE(x, tmp);
+        src += sstride;
+        dst += dstride;
+        frame_ant += w;
     }
 }
 
 av_always_inline
-static int denoise_depth(HQDN3DContext *s,
-                         uint8_t *src, uint8_t *dst,
-                         uint16_t *line_ant, uint16_t **frame_ant_ptr,
-                         int w, int h, int sstride, int dstride,
-                         int16_t *spatial, int16_t *temporal, int depth)
+static void denoise_depth(HQDN3DContext *s,
+                          uint8_t *src, uint8_t *dst,
+                          uint16_t *line_ant, uint16_t *frame_ant,
+                          int w, int h, int sstride, int dstride,
+                          int16_t *spatial, int16_t *temporal, int depth)
 {
-    // FIXME: For 16bit depth, frame_ant could be a pointer to the previous
-    // filtered frame rather than a separate buffer.
-    long x, y;
-    uint16_t *frame_ant = *frame_ant_ptr;
-    if (!frame_ant) {
-        uint8_t *frame_src = src;
-        *frame_ant_ptr = frame_ant = av_malloc_array(w, h*sizeof(uint16_t));
-        if (!frame_ant)
-            return AVERROR(ENOMEM);
-        for (y = 0; y < h; y++, src += sstride, frame_ant += w)
-            for (x = 0; x < w; x++)
-                frame_ant[x] = LOAD(x);
-        src = frame_src;
-        frame_ant = *frame_ant_ptr;
-    }
-
     if (spatial[0])
         denoise_spatial(s, src, dst, line_ant, frame_ant,
-                        w, h, sstride, dstride, spatial, temporal, depth);
+                        w, h, 0, sstride, dstride, spatial, temporal, depth);
     else
         denoise_temporal(src, dst, frame_ant,
                          w, h, sstride, dstride, temporal, depth);
     emms_c();
+}
+
+/* Filter a band that does not start at the top of the plane, priming the
+ * spatial filter from the BAND_OVERLAP saved rows above it. */
+av_always_inline
+static void denoise_band_depth(HQDN3DContext *s, uint8_t *overlap,
+                               uint8_t *src, uint8_t *dst,
+                               uint16_t *line_ant, uint16_t *frame_ant,
+                               int w, int h, int ostride, int sstride, int dstride,
+                               int16_t *spatial, int16_t *temporal, int depth)
+{
+    if (spatial[0]) {
+        prime_spatial(overlap, line_ant, w, BAND_OVERLAP, ostride, spatial, depth);
+        denoise_spatial(s, src, dst, line_ant, frame_ant,
+                        w, h, 1, sstride, dstride, spatial, temporal, depth);
+    } else {
+        denoise_temporal(src, dst, frame_ant,
+                         w, h, sstride, dstride, temporal, depth);
+    }
+    emms_c();
+}
+
+av_always_inline
+static int init_frame_ant(uint8_t *src, uint16_t **frame_ant_ptr,
+                          int w, int h, int sstride, int depth)
+{
+    // FIXME: For 16bit depth, frame_ant could be a pointer to the previous
+    // filtered frame rather than a separate buffer.
+    long x, y;
+    uint16_t *frame_ant = av_malloc_array(w, h*sizeof(uint16_t));
+
+    if (!frame_ant)
+        return AVERROR(ENOMEM);
+    *frame_ant_ptr = frame_ant;
+    for (y = 0; y < h; y++, src += sstride, frame_ant += w)
+        for (x = 0; x < w; x++)
+            frame_ant[x] = LOAD(x);
     return 0;
 }
 
 #define denoise(...)                                                          \
     do {                                                                      \
-        int ret = AVERROR_BUG;                                                \
         switch (s->depth) {                                                   \
-            case  8: ret = denoise_depth(__VA_ARGS__,  8); break;             \
-            case  9: ret = denoise_depth(__VA_ARGS__,  9); break;             \
-            case 10: ret = denoise_depth(__VA_ARGS__, 10); break;             \
-            case 16: ret = denoise_depth(__VA_ARGS__, 16); break;             \
+            case  8: denoise_depth(__VA_ARGS__,  8); break;                   \
+            case  9: denoise_depth(__VA_ARGS__,  9); break;                   \
+            case 10: denoise_depth(__VA_ARGS__, 10); break;                   \
+            case 16: denoise_depth(__VA_ARGS__, 16); break;                   \
         }                                                                     \
-        if (ret < 0) {                                                        \
-            av_frame_free(&out);                                              \
-            if (!direct)                                                      \
-                av_frame_free(&in);                                           \
-            return ret;                                                       \
+    } while (0)
+
+#define denoise_band(...)                                                     \
+    do {                                                                      \
+        switch (s->depth) {                                                   \
+            case  8: denoise_band_depth(__VA_ARGS__,  8); break;              \
+            case  9: denoise_band_depth(__VA_ARGS__,  9); break;              \
+            case 10: denoise_band_depth(__VA_ARGS__, 10); break;              \
+            case 16: denoise_band_depth(__VA_ARGS__, 16); break;              \
         }                                                                     \
     } while (0)
 
@@ -224,6 +300,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->coefs[2]);
     av_freep(&s->coefs[3]);
     av_freep(&s->line);
+    av_freep(&s->overlap);
     av_freep(&s->frame_prev[0]);
     av_freep(&s->frame_prev[1]);
     av_freep(&s->frame_prev[2]);
@@ -271,10 +348,24 @@ static int config_input(AVFilterLink *inlink)
     s->vsub  = desc->log2_chroma_h;
     s->depth = desc->comp[0].depth_minus1+1;
 
-    s->line = av_malloc_array(inlink->w, sizeof(*s->line));
+    s->nb_jobs = 0;
+    for (i = 0; i < 3; i++) {
+        int h = FF_CEIL_RSHIFT(inlink->h, (!!i * s->vsub));
+        s->nb_bands[i] = s->bands ? FFMAX(1, h / BAND_MIN_HEIGHT) : 1;
+        s->nb_jobs    += s->nb_bands[i];
+    }
+
+    s->line = av_malloc_array(inlink->w, s->nb_jobs * sizeof(*s->line));
     if (!s->line)
         return AVERROR(ENOMEM);
 
+    if (s->nb_jobs > 3) {
+        s->overlap_stride = inlink->w * (s->depth > 8 ? 2 : 1);
+        s->overlap = av_malloc_array(s->nb_jobs, BAND_OVERLAP * s->overlap_stride);
+        if (!s->overlap)
+            return AVERROR(ENOMEM);
+    }
+
     for (i = 0; i < 4; i++) {
         s->coefs[i] = precalc_coefs(s->strength[i], s->depth);
         if (!s->coefs[i])
@@ -287,14 +378,94 @@ static int config_input(AVFilterLink *inlink)
     return 0;
 }
 
+static int do_denoise(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    int c = 0, band = jobnr;
+    int w, h, y0, y1;
+
+    while (band >= s->nb_bands[c])
+        band -= s->nb_bands[c++];
+
+    w  = FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub));
+    h  = FF_CEIL_RSHIFT(in->height, (!!c * s->vsub));
+    y0 = h *  band      / s->nb_bands[c];
+    y1 = h * (band + 1) / s->nb_bands[c];
+
+    if (band)
+        denoise_band(s, s->overlap + jobnr * BAND_OVERLAP * s->overlap_stride,
+                     in->data[c] + y0 * in->linesize[c],
+                     out->data[c] + y0 * out->linesize[c],
+                     s->line + jobnr * in->width, s->frame_prev[c] + y0 * w,
+                     w, y1 - y0, s->overlap_stride,
+                     in->linesize[c], out->linesize[c],
+                     s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
+                     s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
+    else
+        denoise(s, in->data[c] + y0 * in->linesize[c],
+                out->data[c] + y0 * out->linesize[c],
+                s->line + jobnr * in->width, s->frame_prev[c] + y0 * w,
+                w, y1 - y0, in->linesize[c], out->linesize[c],
+                s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
+                s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
+    return 0;
+}
+
+/**
+ * Save the source rows above each band, which the spatial filter is primed
+ * from, as the band above may overwrite them when filtering in place.
+ */
+static void save_band_overlap(HQDN3DContext *s, AVFrame *in)
+{
+    int c, band, jobnr = 0;
+
+    for (c = 0; c < 3; c++) {
+        int w = FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub));
+        int h = FF_CEIL_RSHIFT(in->height, (!!c * s->vsub));
+
+        for (band = 0; band < s->nb_bands[c]; band++, jobnr++) {
+            int y0 = h * band / s->nb_bands[c];
+
+            if (band)
+                av_image_copy_plane(s->overlap + jobnr * BAND_OVERLAP * s->overlap_stride,
+                                    s->overlap_stride,
+                                    in->data[c] + (y0 - BAND_OVERLAP) * in->linesize[c],
+                                    in->linesize[c], w * (s->depth > 8 ? 2 : 1),
+                                    BAND_OVERLAP);
+        }
+    }
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx  = inlink->dst;
     HQDN3DContext *s = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
+    ThreadData td;
 
     AVFrame *out;
-    int c, direct = av_frame_is_writable(in) && !ctx->is_disabled;
+    int c, ret = 0;
+    int direct = av_frame_is_writable(in) && !ctx->is_disabled;
+
+    for (c = 0; c < 3; c++) {
+        int w = FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub));
+        int h = FF_CEIL_RSHIFT(in->height, (!!c * s->vsub));
+
+        if (s->frame_prev[c])
+            continue;
+        switch (s->depth) {
+        case  8: ret = init_frame_ant(in->data[c], &s->frame_prev[c], w, h, in->linesize[c],  8); break;
+        case  9: ret = init_frame_ant(in->data[c], &s->frame_prev[c], w, h, in->linesize[c],  9); break;
+        case 10: ret = init_frame_ant(in->data[c], &s->frame_prev[c], w, h, in->linesize[c], 10); break;
+        case 16: ret = init_frame_ant(in->data[c], &s->frame_prev[c], w, h, in->linesize[c], 16); break;
+        }
+        if (ret < 0) {
+            av_frame_free(&in);
+            return ret;
+        }
+    }
 
     if (direct) {
         out = in;
@@ -308,15 +479,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         av_frame_copy_props(out, in);
     }
 
-    for (c = 0; c < 3; c++) {
-        denoise(s, in->data[c], out->data[c],
-                s->line, &s->frame_prev[c],
-                FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub)),
-                FF_CEIL_RSHIFT(in->height, (!!c * s->vsub)),
-                in->linesize[c], out->linesize[c],
-                s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
-                s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
-    }
+    if (s->nb_jobs > 3)
+        save_band_overlap(s, in);
+
+    td.in  = in;
+    td.out = out;
+    ctx->internal->execute(ctx, do_denoise, &td, NULL, s->nb_jobs);
 
     if (ctx->is_disabled) {
         av_frame_free(&out);
@@ -336,6 +504,7 @@ static const AVOption hqdn3d_options[] = {
     { "chroma_spatial", "spatial chroma strength",  OFFSET(strength[CHROMA_SPATIAL]), AV_OPT_TYPE_DOUBLE, { .dbl = 0.0 }, 0, DBL_MAX, FLAGS },
     { "luma_tmp",       "temporal luma strength",   OFFSET(strength[LUMA_TMP]),       AV_OPT_TYPE_DOUBLE, { .dbl = 0.0 }, 0, DBL_MAX, FLAGS },
     { "chroma_tmp",     "temporal chroma strength", OFFSET(strength[CHROMA_TMP]),     AV_OPT_TYPE_DOUBLE, { .dbl = 0.0 }, 0, DBL_MAX, FLAGS },
+    { "bands",          "filter bands of tall planes in parallel, not bit-exact", OFFSET(bands), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, FLAGS },
     { NULL }
 };
 
@@ -370,5 +539,5 @@ AVFilter ff_vf_hqdn3d = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_hqdn3d_inputs,
     .outputs       = avfilter_vf_hqdn3d_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
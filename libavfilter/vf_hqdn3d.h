@@ -31,7 +31,12 @@
 typedef struct HQDN3DContext {
     const AVClass *class;
     int16_t *coefs[4];
-    uint16_t *line;
+    uint16_t *line;             ///< one line buffer per job
+    int nb_bands[3];            ///< number of row bands of each plane
+    int nb_jobs;
+    int bands;                  ///< split tall planes into bands
+    uint8_t *overlap;           ///< source rows above each band, one block per job
+    int overlap_stride;
     uint16_t *frame_prev[3];
     double strength[4];
     int hsub, vsub;
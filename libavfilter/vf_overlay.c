@@ -38,6 +38,7 @@
 #include "internal.h"
 #include "dualinput.h"
 #include "drawutils.h"
+#include "overlay.h"
 #include "video.h"
 
 static const char *const var_names[] = {
@@ -132,6 +133,8 @@ typedef struct OverlayContext {
     int eof_action;             ///< action to take on EOF from source
 
     AVExpr *x_pexpr, *y_pexpr;
+
+    OverlayDSPContext dsp;
 } OverlayContext;
 
 static av_cold void uninit(AVFilterContext *ctx)
@@ -359,6 +362,8 @@ static int config_output(AVFilterLink *outlink)
     outlink->h = ctx->inputs[MAIN]->h;
     outlink->time_base = ctx->inputs[MAIN]->time_base;
 
+    ff_overlay_init(&s->dsp, s->main_is_packed_rgb ? s->main_rgba_map[A] : -1);
+
     return 0;
 }
 
@@ -372,195 +377,350 @@ static int config_output(AVFilterLink *outlink)
 // ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
+static void blend_row_c(uint8_t *d, const uint8_t *s, const uint8_t *a, int w)
+{
+    int k;
+
+    for (k = 0; k < w; k++)
+        d[k] = FAST_DIV255(d[k] * (255 - a[k]) + s[k] * a[k]);
+}
+
+static void blend_row_420_c(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                            ptrdiff_t alinesize, int w)
+{
+    int k;
+
+    for (k = 0; k < w; k++) {
+        int alpha = (a[2*k] + a[2*k + alinesize] +
+                     a[2*k + 1] + a[2*k + alinesize + 1]) >> 2;
+        d[k] = FAST_DIV255(d[k] * (255 - alpha) + s[k] * alpha);
+    }
+}
+
+static av_always_inline void blend_row_rgba_c(uint8_t *d, const uint8_t *s,
+                                              int w, int da)
+{
+    int j, c;
+
+    for (j = 0; j < w; j++, d += 4, s += 4) {
+        int alpha = s[da];
+
+        if (alpha != 0 && alpha != 255)
+            alpha = UNPREMULTIPLY_ALPHA(alpha, d[da]);
+        switch (alpha) {
+        case 0:
+            break;
+        case 255:
+            memcpy(d, s, 4);
+            break;
+        default:
+            for (c = 0; c < 4; c++)
+                if (c != da)
+                    d[c] = FAST_DIV255(d[c] * (255 - alpha) + s[c] * alpha);
+            d[da] += FAST_DIV255((255 - d[da]) * s[da]);
+        }
+    }
+}
+
+static void blend_row_rgba_a0_c(uint8_t *d, const uint8_t *s, int w)
+{
+    blend_row_rgba_c(d, s, w, 0);
+}
+
+static void blend_row_rgba_a3_c(uint8_t *d, const uint8_t *s, int w)
+{
+    blend_row_rgba_c(d, s, w, 3);
+}
+
+av_cold void ff_overlay_init(OverlayDSPContext *dsp, int alpha_pos)
+{
+    dsp->blend_row      = blend_row_c;
+    dsp->blend_row_420  = blend_row_420_c;
+    dsp->blend_row_rgba = alpha_pos == 0 ? blend_row_rgba_a0_c :
+                          alpha_pos == 3 ? blend_row_rgba_a3_c : NULL;
+
+    if (ARCH_X86)
+        ff_overlay_init_x86(dsp, alpha_pos);
+}
+
+typedef struct ThreadData {
+    AVFrame *dst;
+    const AVFrame *src;
+} ThreadData;
+
 /**
- * Blend image in src to destination buffer dst at position (x, y).
+ * Compute the range [*start, *end) of overlay rows handled by slice jobnr.
+ * The boundaries are multiples of 1 << vsub, so that each chroma row and
+ * the luma/alpha rows it is computed from belong to the same slice.
  */
-static void blend_image(AVFilterContext *ctx,
-                        AVFrame *dst, const AVFrame *src,
-                        int x, int y)
+static void get_slice_rows(int imin, int imax, int vsub, int jobnr, int nb_jobs,
+                           int *start, int *end)
+{
+    int units = FF_CEIL_RSHIFT(imax - imin, vsub);
+
+    *start = imin + ((units *  jobnr     / nb_jobs) << vsub);
+    *end   = imin + ((units * (jobnr + 1) / nb_jobs) << vsub);
+    *end   = FFMIN(*end, imax);
+}
+
+static void blend_slice_packed_rgb(AVFilterContext *ctx,
+                                   AVFrame *dst, const AVFrame *src,
+                                   int x, int y, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
-    int i, imax, j, jmax, k, kmax;
+    int i, imax, j, jmax, slice_start, slice_end;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
     const int dst_h = dst->height;
+    uint8_t alpha;          ///< the amount of overlay to blend on to main
+    const int dr = s->main_rgba_map[R];
+    const int dg = s->main_rgba_map[G];
+    const int db = s->main_rgba_map[B];
+    const int da = s->main_rgba_map[A];
+    const int dstep = s->main_pix_step[0];
+    const int sr = s->overlay_rgba_map[R];
+    const int sg = s->overlay_rgba_map[G];
+    const int sb = s->overlay_rgba_map[B];
+    const int sa = s->overlay_rgba_map[A];
+    const int sstep = s->overlay_pix_step[0];
+    const int main_has_alpha = s->main_has_alpha;
+    void (*blend_row_rgba)(uint8_t *d, const uint8_t *s, int w) =
+        main_has_alpha && dstep == 4 && sstep == 4 &&
+        !memcmp(s->main_rgba_map, s->overlay_rgba_map, 4) ?
+        s->dsp.blend_row_rgba : NULL;
+    uint8_t *sp, *dp;
+
+    get_slice_rows(FFMAX(-y, 0), FFMIN(-y + dst_h, src_h), 0, jobnr, nb_jobs,
+                   &slice_start, &slice_end);
+
+    i  = slice_start;
+    sp = src->data[0] + i     * src->linesize[0];
+    dp = dst->data[0] + (y+i) * dst->linesize[0];
+
+    for (imax = slice_end; i < imax; i++) {
+        uint8_t *s, *d;
+
+        j = FFMAX(-x, 0);
+        jmax = FFMIN(-x + dst_w, src_w);
+        s = sp + j     * sstep;
+        d = dp + (x+j) * dstep;
+
+        if (blend_row_rgba && jmax - j >= OVERLAY_DSP_BLOCK) {
+            int w = (jmax - j) & ~(OVERLAY_DSP_BLOCK - 1);
+            blend_row_rgba(d, s, w);
+            d += w * dstep;
+            s += w * sstep;
+            j += w;
+        }
 
-    if (x >= dst_w || x+src_w < 0 ||
-        y >= dst_h || y+src_h < 0)
-        return; /* no intersection */
+        for (; j < jmax; j++) {
+            alpha = s[sa];
 
-    if (s->main_is_packed_rgb) {
-        uint8_t alpha;          ///< the amount of overlay to blend on to main
-        const int dr = s->main_rgba_map[R];
-        const int dg = s->main_rgba_map[G];
-        const int db = s->main_rgba_map[B];
-        const int da = s->main_rgba_map[A];
-        const int dstep = s->main_pix_step[0];
-        const int sr = s->overlay_rgba_map[R];
-        const int sg = s->overlay_rgba_map[G];
-        const int sb = s->overlay_rgba_map[B];
-        const int sa = s->overlay_rgba_map[A];
-        const int sstep = s->overlay_pix_step[0];
-        const int main_has_alpha = s->main_has_alpha;
-        uint8_t *s, *sp, *d, *dp;
-
-        i = FFMAX(-y, 0);
-        sp = src->data[0] + i     * src->linesize[0];
-        dp = dst->data[0] + (y+i) * dst->linesize[0];
-
-        for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
-            j = FFMAX(-x, 0);
-            s = sp + j     * sstep;
-            d = dp + (x+j) * dstep;
-
-            for (jmax = FFMIN(-x + dst_w, src_w); j < jmax; j++) {
-                alpha = s[sa];
-
-                // if the main channel has an alpha channel, alpha has to be calculated
-                // to create an un-premultiplied (straight) alpha value
-                if (main_has_alpha && alpha != 0 && alpha != 255) {
-                    uint8_t alpha_d = d[da];
-                    alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
-                }
+            // if the main channel has an alpha channel, alpha has to be calculated
+            // to create an un-premultiplied (straight) alpha value
+            if (main_has_alpha && alpha != 0 && alpha != 255) {
+                uint8_t alpha_d = d[da];
+                alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
+            }
 
+            switch (alpha) {
+            case 0:
+                break;
+            case 255:
+                d[dr] = s[sr];
+                d[dg] = s[sg];
+                d[db] = s[sb];
+                break;
+            default:
+                // main_value = main_value * (1 - alpha) + overlay_value * alpha
+                // since alpha is in the range 0-255, the result must divided by 255
+                d[dr] = FAST_DIV255(d[dr] * (255 - alpha) + s[sr] * alpha);
+                d[dg] = FAST_DIV255(d[dg] * (255 - alpha) + s[sg] * alpha);
+                d[db] = FAST_DIV255(d[db] * (255 - alpha) + s[sb] * alpha);
+            }
+            if (main_has_alpha) {
                 switch (alpha) {
                 case 0:
                     break;
                 case 255:
-                    d[dr] = s[sr];
-                    d[dg] = s[sg];
-                    d[db] = s[sb];
+                    d[da] = s[sa];
                     break;
                 default:
-                    // main_value = main_value * (1 - alpha) + overlay_value * alpha
-                    // since alpha is in the range 0-255, the result must divided by 255
-                    d[dr] = FAST_DIV255(d[dr] * (255 - alpha) + s[sr] * alpha);
-                    d[dg] = FAST_DIV255(d[dg] * (255 - alpha) + s[sg] * alpha);
-                    d[db] = FAST_DIV255(d[db] * (255 - alpha) + s[sb] * alpha);
+                    // apply alpha compositing: main_alpha += (1-main_alpha) * overlay_alpha
+                    d[da] += FAST_DIV255((255 - d[da]) * s[sa]);
                 }
-                if (main_has_alpha) {
-                    switch (alpha) {
-                    case 0:
-                        break;
-                    case 255:
-                        d[da] = s[sa];
-                        break;
-                    default:
-                        // apply alpha compositing: main_alpha += (1-main_alpha) * overlay_alpha
-                        d[da] += FAST_DIV255((255 - d[da]) * s[sa]);
-                    }
-                }
-                d += dstep;
-                s += sstep;
             }
-            dp += dst->linesize[0];
-            sp += src->linesize[0];
+            d += dstep;
+            s += sstep;
         }
-    } else {
-        const int main_has_alpha = s->main_has_alpha;
-        if (main_has_alpha) {
-            uint8_t alpha;          ///< the amount of overlay to blend on to main
-            uint8_t *s, *sa, *d, *da;
-
-            i = FFMAX(-y, 0);
-            sa = src->data[3] + i     * src->linesize[3];
-            da = dst->data[3] + (y+i) * dst->linesize[3];
-
-            for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
-                j = FFMAX(-x, 0);
-                s = sa + j;
-                d = da + x+j;
-
-                for (jmax = FFMIN(-x + dst_w, src_w); j < jmax; j++) {
-                    alpha = *s;
-                    if (alpha != 0 && alpha != 255) {
-                        uint8_t alpha_d = *d;
-                        alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
-                    }
-                    switch (alpha) {
-                    case 0:
-                        break;
-                    case 255:
-                        *d = *s;
-                        break;
-                    default:
-                        // apply alpha compositing: main_alpha += (1-main_alpha) * overlay_alpha
-                        *d += FAST_DIV255((255 - *d) * *s);
-                    }
-                    d += 1;
-                    s += 1;
-                }
-                da += dst->linesize[3];
-                sa += src->linesize[3];
+        dp += dst->linesize[0];
+        sp += src->linesize[0];
+    }
+}
+
+static void blend_plane(const OverlayDSPContext *dsp,
+                        AVFrame *dst, const AVFrame *src,
+                        int i, int hsub, int vsub, int main_has_alpha,
+                        int x, int y, int slice_start, int slice_end)
+{
+    const int src_wp = FF_CEIL_RSHIFT(src->width,  hsub);
+    const int src_hp = FF_CEIL_RSHIFT(src->height, vsub);
+    const int dst_wp = FF_CEIL_RSHIFT(dst->width,  hsub);
+    const int dst_hp = FF_CEIL_RSHIFT(dst->height, vsub);
+    const int yp = y>>vsub;
+    const int xp = x>>hsub;
+    const ptrdiff_t alinesize = src->linesize[3];
+    int j, jmax, k, kmax;
+    uint8_t *s, *sp, *d, *dp, *a, *ap;
+
+    j = slice_start >> vsub;
+    sp = src->data[i] + j         * src->linesize[i];
+    dp = dst->data[i] + (yp+j)    * dst->linesize[i];
+    ap = src->data[3] + (j<<vsub) * alinesize;
+
+    jmax = FFMIN(FFMIN(-yp + dst_hp, src_hp), FF_CEIL_RSHIFT(slice_end, vsub));
+    for (; j < jmax; j++) {
+        k = FFMAX(-xp, 0);
+        kmax = FFMIN(-xp + dst_wp, src_wp);
+        d = dp + xp+k;
+        s = sp + k;
+        a = ap + (k<<hsub);
+
+        if (!main_has_alpha) {
+            int w = 0;
+
+            if (!hsub && !vsub && dsp->blend_row)
+                w = kmax - k;
+            else if (hsub && vsub && j+1 < src_hp && dsp->blend_row_420)
+                w = FFMIN(kmax, src_wp - 1) - k;
+            w &= ~(OVERLAY_DSP_BLOCK - 1);
+            if (w > 0) {
+                if (hsub)
+                    dsp->blend_row_420(d, s, a, alinesize, w);
+                else
+                    dsp->blend_row(d, s, a, w);
+                d += w;
+                s += w;
+                a += w << hsub;
+                k += w;
             }
         }
-        for (i = 0; i < 3; i++) {
-            int hsub = i ? s->hsub : 0;
-            int vsub = i ? s->vsub : 0;
-            int src_wp = FF_CEIL_RSHIFT(src_w, hsub);
-            int src_hp = FF_CEIL_RSHIFT(src_h, vsub);
-            int dst_wp = FF_CEIL_RSHIFT(dst_w, hsub);
-            int dst_hp = FF_CEIL_RSHIFT(dst_h, vsub);
-            int yp = y>>vsub;
-            int xp = x>>hsub;
-            uint8_t *s, *sp, *d, *dp, *a, *ap;
-
-            j = FFMAX(-yp, 0);
-            sp = src->data[i] + j         * src->linesize[i];
-            dp = dst->data[i] + (yp+j)    * dst->linesize[i];
-            ap = src->data[3] + (j<<vsub) * src->linesize[3];
-
-            for (jmax = FFMIN(-yp + dst_hp, src_hp); j < jmax; j++) {
-                k = FFMAX(-xp, 0);
-                d = dp + xp+k;
-                s = sp + k;
-                a = ap + (k<<hsub);
-
-                for (kmax = FFMIN(-xp + dst_wp, src_wp); k < kmax; k++) {
-                    int alpha_v, alpha_h, alpha;
-
-                    // average alpha for color components, improve quality
-                    if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {
-                        alpha = (a[0] + a[src->linesize[3]] +
-                                 a[1] + a[src->linesize[3]+1]) >> 2;
-                    } else if (hsub || vsub) {
-                        alpha_h = hsub && k+1 < src_wp ?
-                            (a[0] + a[1]) >> 1 : a[0];
-                        alpha_v = vsub && j+1 < src_hp ?
-                            (a[0] + a[src->linesize[3]]) >> 1 : a[0];
-                        alpha = (alpha_v + alpha_h) >> 1;
-                    } else
-                        alpha = a[0];
-                    // if the main channel has an alpha channel, alpha has to be calculated
-                    // to create an un-premultiplied (straight) alpha value
-                    if (main_has_alpha && alpha != 0 && alpha != 255) {
-                        // average alpha for color components, improve quality
-                        uint8_t alpha_d;
-                        if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {
-                            alpha_d = (d[0] + d[src->linesize[3]] +
-                                       d[1] + d[src->linesize[3]+1]) >> 2;
-                        } else if (hsub || vsub) {
-                            alpha_h = hsub && k+1 < src_wp ?
-                                (d[0] + d[1]) >> 1 : d[0];
-                            alpha_v = vsub && j+1 < src_hp ?
-                                (d[0] + d[src->linesize[3]]) >> 1 : d[0];
-                            alpha_d = (alpha_v + alpha_h) >> 1;
-                        } else
-                            alpha_d = d[0];
-                        alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
-                    }
-                    *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
-                    s++;
-                    d++;
-                    a += 1 << hsub;
-                }
-                dp += dst->linesize[i];
-                sp += src->linesize[i];
-                ap += (1 << vsub) * src->linesize[3];
+
+        for (; k < kmax; k++) {
+            int alpha_v, alpha_h, alpha;
+
+            // average alpha for color components, improve quality
+            if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {
+                alpha = (a[0] + a[alinesize] +
+                         a[1] + a[alinesize+1]) >> 2;
+            } else if (hsub || vsub) {
+                alpha_h = hsub && k+1 < src_wp ?
+                    (a[0] + a[1]) >> 1 : a[0];
+                alpha_v = vsub && j+1 < src_hp ?
+                    (a[0] + a[alinesize]) >> 1 : a[0];
+                alpha = (alpha_v + alpha_h) >> 1;
+            } else
+                alpha = a[0];
+            // if the main channel has an alpha channel, alpha has to be calculated
+            // to create an un-premultiplied (straight) alpha value
+            if (main_has_alpha && alpha != 0 && alpha != 255) {
+                // average alpha for color components, improve quality
+                uint8_t alpha_d;
+                if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {
+                    alpha_d = (d[0] + d[alinesize] +
+                               d[1] + d[alinesize+1]) >> 2;
+                } else if (hsub || vsub) {
+                    alpha_h = hsub && k+1 < src_wp ?
+                        (d[0] + d[1]) >> 1 : d[0];
+                    alpha_v = vsub && j+1 < src_hp ?
+                        (d[0] + d[alinesize]) >> 1 : d[0];
+                    alpha_d = (alpha_v + alpha_h) >> 1;
+                } else
+                    alpha_d = d[0];
+                alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
+            }
+            *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
+            s++;
+            d++;
+            a += 1 << hsub;
+        }
+        dp += dst->linesize[i];
+        sp += src->linesize[i];
+        ap += (1 << vsub) * alinesize;
+    }
+}
+
+static void alpha_composite(AVFrame *dst, const AVFrame *src,
+                            int x, int y,
+                            int slice_start, int slice_end)
+{
+    uint8_t alpha;          ///< the amount of overlay to blend on to main
+    uint8_t *s, *sa, *d, *da;
+    int i, imax, j, jmax;
+
+    i = slice_start;
+    sa = src->data[3] + i     * src->linesize[3];
+    da = dst->data[3] + (y+i) * dst->linesize[3];
+
+    for (imax = slice_end; i < imax; i++) {
+        j = FFMAX(-x, 0);
+        s = sa + j;
+        d = da + x+j;
+
+        for (jmax = FFMIN(-x + dst->width, src->width); j < jmax; j++) {
+            alpha = *s;
+            if (alpha != 0 && alpha != 255) {
+                uint8_t alpha_d = *d;
+                alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
+            }
+            switch (alpha) {
+            case 0:
+                break;
+            case 255:
+                *d = *s;
+                break;
+            default:
+                // apply alpha compositing: main_alpha += (1-main_alpha) * overlay_alpha
+                *d += FAST_DIV255((255 - *d) * *s);
             }
+            d += 1;
+            s += 1;
         }
+        da += dst->linesize[3];
+        sa += src->linesize[3];
+    }
+}
+
+/**
+ * Blend the rows of the overlay picture assigned to slice jobnr on to the
+ * main picture.
+ */
+static int blend_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *dst = td->dst;
+    const AVFrame *src = td->src;
+    int slice_start, slice_end;
+
+    if (s->main_is_packed_rgb) {
+        blend_slice_packed_rgb(ctx, dst, src, s->x, s->y, jobnr, nb_jobs);
+        return 0;
     }
+
+    get_slice_rows(FFMAX(-s->y, 0), FFMIN(-s->y + dst->height, src->height),
+                   s->vsub, jobnr, nb_jobs, &slice_start, &slice_end);
+
+    blend_plane(&s->dsp, dst, src, 0, 0,       0,       s->main_has_alpha,
+                s->x, s->y, slice_start, slice_end);
+    blend_plane(&s->dsp, dst, src, 1, s->hsub, s->vsub, s->main_has_alpha,
+                s->x, s->y, slice_start, slice_end);
+    blend_plane(&s->dsp, dst, src, 2, s->hsub, s->vsub, s->main_has_alpha,
+                s->x, s->y, slice_start, slice_end);
+    if (s->main_has_alpha)
+        alpha_composite(dst, src, s->x, s->y, slice_start, slice_end);
+    return 0;
 }
 
 static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
@@ -584,7 +744,18 @@ static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
                s->var_values[VAR_Y], s->y);
     }
 
-    blend_image(ctx, mainpic, second, s->x, s->y);
+    if (s->x < mainpic->width  && s->x + second->width  >= 0 &&
+        s->y < mainpic->height && s->y + second->height >= 0) {
+        ThreadData td = { .dst = mainpic, .src = second };
+        int nb_jobs = FFMIN(FFMAX(1, second->height >> 4),
+                            ctx->graph->nb_threads);
+
+        /* un-premultiplying the color planes of an alpha main picture reads
+         * main rows outside the slice being blended */
+        if (s->main_has_alpha && !s->main_is_packed_rgb)
+            nb_jobs = 1;
+        ctx->internal->execute(ctx, blend_slice, &td, NULL, nb_jobs);
+    }
     return mainpic;
 }
 
@@ -689,5 +860,6 @@ AVFilter ff_vf_overlay = {
     .process_command = process_command,
     .inputs        = avfilter_vf_overlay_inputs,
     .outputs       = avfilter_vf_overlay_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
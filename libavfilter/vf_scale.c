@@ -75,6 +75,8 @@ typedef struct ScaleContext {
     const AVClass *class;
     struct SwsContext *sws;     ///< software scaler context
     struct SwsContext *isws[2]; ///< software scaler context for interlaced material
+    struct SwsContext **band_sws; ///< software scaler contexts for the bands of progressive material
+    int nb_bands;
     AVDictionary *opts;
 
     /**
@@ -161,9 +163,20 @@ static av_cold int init_dict(AVFilterContext *ctx, AVDictionary **opts)
     return 0;
 }
 
+static void free_band_contexts(ScaleContext *scale)
+{
+    int i;
+
+    for (i = 0; i < scale->nb_bands; i++)
+        sws_freeContext(scale->band_sws[i]);
+    av_freep(&scale->band_sws);
+    scale->nb_bands = 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     ScaleContext *scale = ctx->priv;
+    free_band_contexts(scale);
     sws_freeContext(scale->sws);
     sws_freeContext(scale->isws[0]);
     sws_freeContext(scale->isws[1]);
@@ -231,6 +244,115 @@ static const int *parse_yuv_type(const char *s, enum AVColorSpace colorspace)
     return sws_getCoefficients(colorspace);
 }
 
+/**
+ * Allocate and initialize a scaler context.
+ *
+ * @param field 0 for the whole picture, 1 and 2 for the top and bottom field
+ * @param band_start first output line produced by the context
+ * @param band_end output line following the last one produced by the
+ *                 context, 0 for the last line of the picture
+ */
+static int init_sws_context(AVFilterContext *ctx, struct SwsContext **s,
+                            enum AVPixelFormat outfmt, int field,
+                            int band_start, int band_end)
+{
+    ScaleContext *scale = ctx->priv;
+    AVFilterLink *inlink  = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    int ret;
+
+    *s = sws_alloc_context();
+    if (!*s)
+        return AVERROR(ENOMEM);
+
+    if (scale->opts) {
+        AVDictionaryEntry *e = NULL;
+
+        while ((e = av_dict_get(scale->opts, "", e, AV_DICT_IGNORE_SUFFIX))) {
+            if ((ret = av_opt_set(*s, e->key, e->value, 0)) < 0)
+                return ret;
+        }
+    }
+
+    av_opt_set_int(*s, "srcw", inlink ->w, 0);
+    av_opt_set_int(*s, "srch", inlink ->h >> !!field, 0);
+    av_opt_set_int(*s, "src_format", inlink->format, 0);
+    av_opt_set_int(*s, "dstw", outlink->w, 0);
+    av_opt_set_int(*s, "dsth", outlink->h >> !!field, 0);
+    av_opt_set_int(*s, "dst_format", outfmt, 0);
+    av_opt_set_int(*s, "sws_flags", scale->flags, 0);
+
+    /* the bands are already run by the filter graph threads */
+    if (band_start || band_end) {
+        av_opt_set_int(*s, "threads",    1,          0);
+        av_opt_set_int(*s, "band_start", band_start, 0);
+        av_opt_set_int(*s, "band_end",   band_end,   0);
+    }
+
+    /* Override YUV420P settings to have the correct (MPEG-2) chroma positions
+     * MPEG-2 chroma positions are used by convention
+     * XXX: support other 4:2:0 pixel formats */
+    if (inlink->format == AV_PIX_FMT_YUV420P) {
+        scale->in_v_chr_pos = (field == 0) ? 128 : (field == 1) ? 64 : 192;
+    }
+
+    if (outlink->format == AV_PIX_FMT_YUV420P) {
+        scale->out_v_chr_pos = (field == 0) ? 128 : (field == 1) ? 64 : 192;
+    }
+
+    av_opt_set_int(*s, "src_h_chr_pos", scale->in_h_chr_pos, 0);
+    av_opt_set_int(*s, "src_v_chr_pos", scale->in_v_chr_pos, 0);
+    av_opt_set_int(*s, "dst_h_chr_pos", scale->out_h_chr_pos, 0);
+    av_opt_set_int(*s, "dst_v_chr_pos", scale->out_v_chr_pos, 0);
+
+    return sws_init_context(*s, NULL, NULL);
+}
+
+/**
+ * Set up one scaler context per slice thread, each producing a band of the
+ * output from the whole input picture. The vertical filter of every context
+ * reads the input lines it needs around its band, so the output is
+ * identical to the one of a single context.
+ */
+static int init_band_contexts(AVFilterContext *ctx, enum AVPixelFormat outfmt)
+{
+    ScaleContext *scale = ctx->priv;
+    int h        = ctx->outputs[0]->h;
+    int align    = 1 << av_pix_fmt_desc_get(outfmt)->log2_chroma_h;
+    int nb_bands = FFMIN(ctx->graph->nb_threads, h / 16);
+    int64_t band_end;
+    int i, ret;
+
+    if (scale->interlaced || nb_bands <= 1)
+        return 0;
+
+    scale->band_sws = av_mallocz_array(nb_bands, sizeof(*scale->band_sws));
+    if (!scale->band_sws)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_bands; i++) {
+        int start = (h * (int64_t) i      / nb_bands) & ~(align - 1);
+        int end   = (h * (int64_t)(i + 1) / nb_bands) & ~(align - 1);
+
+        scale->nb_bands++;
+        ret = init_sws_context(ctx, &scale->band_sws[i], outfmt, 0,
+                               start, i == nb_bands - 1 ? 0 : end);
+        if (ret < 0)
+            return ret;
+
+        /* some conversions always output the whole picture */
+        if (!i) {
+            av_opt_get_int(scale->band_sws[0], "band_end", 0, &band_end);
+            if (!band_end) {
+                free_band_contexts(scale);
+                return 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
 static int config_props(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -336,6 +458,7 @@ static int config_props(AVFilterLink *outlink)
     scale->output_is_pal = av_pix_fmt_desc_get(outfmt)->flags & AV_PIX_FMT_FLAG_PAL ||
                            av_pix_fmt_desc_get(outfmt)->flags & AV_PIX_FMT_FLAG_PSEUDOPAL;
 
+    free_band_contexts(scale);
     if (scale->sws)
         sws_freeContext(scale->sws);
     if (scale->isws[0])
@@ -351,49 +474,14 @@ static int config_props(AVFilterLink *outlink)
         int i;
 
         for (i = 0; i < 3; i++) {
-            struct SwsContext **s = swscs[i];
-            *s = sws_alloc_context();
-            if (!*s)
-                return AVERROR(ENOMEM);
-
-            if (scale->opts) {
-                AVDictionaryEntry *e = NULL;
-
-                while ((e = av_dict_get(scale->opts, "", e, AV_DICT_IGNORE_SUFFIX))) {
-                    if ((ret = av_opt_set(*s, e->key, e->value, 0)) < 0)
-                        return ret;
-                }
-            }
-
-            av_opt_set_int(*s, "srcw", inlink ->w, 0);
-            av_opt_set_int(*s, "srch", inlink ->h >> !!i, 0);
-            av_opt_set_int(*s, "src_format", inlink->format, 0);
-            av_opt_set_int(*s, "dstw", outlink->w, 0);
-            av_opt_set_int(*s, "dsth", outlink->h >> !!i, 0);
-            av_opt_set_int(*s, "dst_format", outfmt, 0);
-            av_opt_set_int(*s, "sws_flags", scale->flags, 0);
-
-            /* Override YUV420P settings to have the correct (MPEG-2) chroma positions
-             * MPEG-2 chroma positions are used by convention
-             * XXX: support other 4:2:0 pixel formats */
-            if (inlink->format == AV_PIX_FMT_YUV420P) {
-                scale->in_v_chr_pos = (i == 0) ? 128 : (i == 1) ? 64 : 192;
-            }
-
-            if (outlink->format == AV_PIX_FMT_YUV420P) {
-                scale->out_v_chr_pos = (i == 0) ? 128 : (i == 1) ? 64 : 192;
-            }
-
-            av_opt_set_int(*s, "src_h_chr_pos", scale->in_h_chr_pos, 0);
-            av_opt_set_int(*s, "src_v_chr_pos", scale->in_v_chr_pos, 0);
-            av_opt_set_int(*s, "dst_h_chr_pos", scale->out_h_chr_pos, 0);
-            av_opt_set_int(*s, "dst_v_chr_pos", scale->out_v_chr_pos, 0);
-
-            if ((ret = sws_init_context(*s, NULL, NULL)) < 0)
+            if ((ret = init_sws_context(ctx, swscs[i], outfmt, i, 0, 0)) < 0)
                 return ret;
             if (!scale->interlaced)
                 break;
         }
+
+        if ((ret = init_band_contexts(ctx, outfmt)) < 0)
+            return ret;
     }
 
     if (inlink->sample_aspect_ratio.num){
@@ -441,6 +529,20 @@ static int scale_slice(AVFilterLink *link, AVFrame *out_buf, AVFrame *cur_pic, s
                          out,out_stride);
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int scale_band(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ScaleContext *scale = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ThreadData *td = arg;
+
+    scale_slice(inlink, td->out, td->in, scale->band_sws[jobnr], 0, inlink->h, 1, 0);
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     ScaleContext *scale = link->dst->priv;
@@ -448,7 +550,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     AVFrame *out;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     char buf[32];
-    int in_range;
+    int i, in_range;
 
     if (av_frame_get_colorspace(in) == AVCOL_SPC_YCGCO)
         av_log(link->dst, AV_LOG_WARNING, "Detected unsupported YCgCo colorspace.\n");
@@ -526,6 +628,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
             sws_setColorspaceDetails(scale->isws[1], inv_table, in_full,
                                      table, out_full,
                                      brightness, contrast, saturation);
+        for (i = 0; i < scale->nb_bands; i++)
+            sws_setColorspaceDetails(scale->band_sws[i], inv_table, in_full,
+                                     table, out_full,
+                                     brightness, contrast, saturation);
     }
 
     av_reduce(&out->sample_aspect_ratio.num, &out->sample_aspect_ratio.den,
@@ -536,6 +642,9 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     if(scale->interlaced>0 || (scale->interlaced<0 && in->interlaced_frame)){
         scale_slice(link, out, in, scale->isws[0], 0, (link->h+1)/2, 2, 0);
         scale_slice(link, out, in, scale->isws[1], 0,  link->h   /2, 2, 1);
+    }else if (scale->nb_bands) {
+        ThreadData td = { .in = in, .out = out };
+        link->dst->internal->execute(link->dst, scale_band, &td, NULL, scale->nb_bands);
     }else{
         scale_slice(link, out, in, scale->sws, 0, link->h, 1, 0);
     }
@@ -644,4 +753,5 @@ AVFilter ff_vf_scale = {
     .inputs          = avfilter_vf_scale_inputs,
     .outputs         = avfilter_vf_scale_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
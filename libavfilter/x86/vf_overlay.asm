@@ -0,0 +1,242 @@
+;*****************************************************************************
+;* x86-optimized functions for overlay filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pw_128:      times 16 dw 128
+pw_255:      times 16 dw 255
+pw_257:      times 16 dw 257
+pd_255:      times 8 dd 255
+pd_ff000000: times 8 dd 0xff000000
+ps_1:        times 8 dd 1.0
+ps_255:      times 8 dd 255.0
+ps_65025:    times 8 dd 65025.0
+
+SECTION .text
+
+; %1 = dst, %2 = mem, %3 = zero
+%macro LOAD_BW 3
+%if cpuflag(avx2)
+    pmovzxbw    %1, [%2]
+%else
+    movq        %1, [%2]
+    punpcklbw   %1, %3
+%endif
+%endmacro
+
+; pack the words of m0 and store them to %1
+%macro STORE_WB 1
+    packuswb    m0, m0
+%if cpuflag(avx2)
+    vpermq      m0, m0, q3120
+    movu      [%1], xm0
+%else
+    movq      [%1], m0
+%endif
+%endmacro
+
+; m0 = FAST_DIV255(m0 * (255 - m2) + m1 * m2)
+%macro BLEND 0
+    mova        m3, [pw_255]
+    psubw       m3, m2
+    pmullw      m0, m3
+    pmullw      m1, m2
+    paddw       m0, m1
+    paddw       m0, [pw_128]
+    pmulhuw     m0, [pw_257]
+%endmacro
+
+;------------------------------------------------------------------------------
+; void ff_overlay_blend_row(uint8_t *d, const uint8_t *s, const uint8_t *a,
+;                           int w)
+;------------------------------------------------------------------------------
+
+%macro BLEND_ROW 0
+cglobal overlay_blend_row, 4, 4, 8, d, s, a, w
+    movsxdifnidn wq, wd
+    add         dq, wq
+    add         sq, wq
+    add         aq, wq
+    neg         wq
+    pxor        m7, m7
+.loop:
+    LOAD_BW     m0, dq+wq, m7
+    LOAD_BW     m1, sq+wq, m7
+    LOAD_BW     m2, aq+wq, m7
+    BLEND
+    STORE_WB    dq+wq
+    add         wq, mmsize/2
+    jl .loop
+    RET
+%endmacro
+
+;------------------------------------------------------------------------------
+; void ff_overlay_blend_row_420(uint8_t *d, const uint8_t *s, const uint8_t *a,
+;                               ptrdiff_t alinesize, int w)
+;------------------------------------------------------------------------------
+
+%macro BLEND_ROW_420 0
+cglobal overlay_blend_row_420, 5, 6, 8, d, s, a, alinesize, w, a2
+    movsxdifnidn wq, wd
+    lea        a2q, [aq+alinesizeq]
+    add         dq, wq
+    add         sq, wq
+    lea         aq, [aq+wq*2]
+    lea        a2q, [a2q+wq*2]
+    neg         wq
+    mova        m6, [pw_255]
+    pxor        m7, m7
+.loop:
+    ; alpha = (a[2k] + a[2k + 1] + a2[2k] + a2[2k + 1]) >> 2
+    movu        m2, [aq+wq*2]
+    movu        m3, [a2q+wq*2]
+    pand        m4, m2, m6
+    psrlw       m2, 8
+    paddw       m2, m4
+    pand        m4, m3, m6
+    psrlw       m3, 8
+    paddw       m2, m3
+    paddw       m2, m4
+    psrlw       m2, 2
+    LOAD_BW     m0, dq+wq, m7
+    LOAD_BW     m1, sq+wq, m7
+    BLEND
+    STORE_WB    dq+wq
+    add         wq, mmsize/2
+    jl .loop
+    RET
+%endmacro
+
+;------------------------------------------------------------------------------
+; void ff_overlay_blend_row_rgba_a%1(uint8_t *d, const uint8_t *s, int w)
+;
+; %1 is the byte offset of the alpha component, either 0 or 3.
+;------------------------------------------------------------------------------
+
+%macro BLEND_ROW_RGBA 1
+%if %1 == 3
+    %define pd_alpha pd_ff000000
+    %define shuf     q1000
+%else
+    %define pd_alpha pd_255
+    %define shuf     q0001
+%endif
+cglobal overlay_blend_row_rgba_a%1, 3, 3, 8, d, s, w
+    shl         wd, 2
+    movsxdifnidn wq, wd
+    add         dq, wq
+    add         sq, wq
+    neg         wq
+    pxor        m6, m6
+.loop:
+    movu        m0, [dq+wq]
+    movu        m1, [sq+wq]
+
+    ; un-premultiply the overlay alpha x against the main alpha y:
+    ; alpha = x * 255 * 255 / (255 * (x + y) - x * y)
+    ; Every term is an integer below 2^24, so it is exact in single
+    ; precision. The rounded quotient is at most one above the truncated
+    ; one, which is corrected by checking alpha * den <= num.
+%if %1 == 3
+    psrld       m2, m1, 24
+    psrld       m3, m0, 24
+%else
+    pand        m2, m1, [pd_255]
+    pand        m3, m0, [pd_255]
+%endif
+    cvtdq2ps    m2, m2
+    cvtdq2ps    m3, m3
+    addps       m4, m2, m3
+    mulps       m3, m2
+    mulps       m4, [ps_255]
+    subps       m4, m3
+    maxps       m4, [ps_1]
+    mulps       m2, [ps_65025]
+    divps       m3, m2, m4
+    cvttps2dq   m3, m3
+    cvtdq2ps    m5, m3
+    mulps       m5, m4
+    cmpps       m5, m5, m2, 6
+    paddd       m3, m5
+
+    ; put x in the upper word of each dword, so that the shuffles below
+    ; give it to the alpha component and the straight alpha to the others
+%if %1 == 3
+    psrld       m2, m1, 24
+    pslld       m2, 16
+%else
+    pslld       m2, m1, 24
+    psrld       m2, 8
+%endif
+    por         m2, m3
+    ; blend the alpha component against 255, which gives the compositing
+    ; main_alpha + (255 - main_alpha) * x / 255
+    por         m1, [pd_alpha]
+
+    punpckldq   m3, m2, m2
+    punpckhdq   m2, m2
+    pshuflw     m3, m3, shuf
+    pshufhw     m3, m3, shuf
+    pshuflw     m2, m2, shuf
+    pshufhw     m2, m2, shuf
+
+    punpcklbw   m4, m0, m6
+    punpcklbw   m5, m1, m6
+    punpckhbw   m0, m6
+    punpckhbw   m1, m6
+
+    mova        m7, [pw_255]
+    psubw       m7, m3
+    pmullw      m4, m7
+    pmullw      m5, m3
+    paddw       m4, m5
+    paddw       m4, [pw_128]
+    pmulhuw     m4, [pw_257]
+
+    mova        m7, [pw_255]
+    psubw       m7, m2
+    pmullw      m0, m7
+    pmullw      m1, m2
+    paddw       m0, m1
+    paddw       m0, [pw_128]
+    pmulhuw     m0, [pw_257]
+
+    packuswb    m4, m0
+    movu   [dq+wq], m4
+    add         wq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM sse2
+BLEND_ROW
+BLEND_ROW_420
+BLEND_ROW_RGBA 0
+BLEND_ROW_RGBA 3
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+BLEND_ROW
+BLEND_ROW_420
+BLEND_ROW_RGBA 0
+BLEND_ROW_RGBA 3
+%endif
@@ -0,0 +1,55 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/overlay.h"
+
+void ff_overlay_blend_row_sse2(uint8_t *d, const uint8_t *s, const uint8_t *a, int w);
+void ff_overlay_blend_row_avx2(uint8_t *d, const uint8_t *s, const uint8_t *a, int w);
+void ff_overlay_blend_row_420_sse2(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                                   ptrdiff_t alinesize, int w);
+void ff_overlay_blend_row_420_avx2(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                                   ptrdiff_t alinesize, int w);
+void ff_overlay_blend_row_rgba_a0_sse2(uint8_t *d, const uint8_t *s, int w);
+void ff_overlay_blend_row_rgba_a0_avx2(uint8_t *d, const uint8_t *s, int w);
+void ff_overlay_blend_row_rgba_a3_sse2(uint8_t *d, const uint8_t *s, int w);
+void ff_overlay_blend_row_rgba_a3_avx2(uint8_t *d, const uint8_t *s, int w);
+
+av_cold void ff_overlay_init_x86(OverlayDSPContext *dsp, int alpha_pos)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE2(cpu_flags)) {
+        dsp->blend_row     = ff_overlay_blend_row_sse2;
+        dsp->blend_row_420 = ff_overlay_blend_row_420_sse2;
+        if (alpha_pos == 0)
+            dsp->blend_row_rgba = ff_overlay_blend_row_rgba_a0_sse2;
+        else if (alpha_pos == 3)
+            dsp->blend_row_rgba = ff_overlay_blend_row_rgba_a3_sse2;
+    }
+    if (EXTERNAL_AVX2(cpu_flags)) {
+        dsp->blend_row     = ff_overlay_blend_row_avx2;
+        dsp->blend_row_420 = ff_overlay_blend_row_420_avx2;
+        if (alpha_pos == 0)
+            dsp->blend_row_rgba = ff_overlay_blend_row_rgba_a0_avx2;
+        else if (alpha_pos == 3)
+            dsp->blend_row_rgba = ff_overlay_blend_row_rgba_a3_avx2;
+    }
+}
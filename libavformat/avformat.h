@@ -407,6 +407,23 @@ struct AVDeviceCapabilitiesQuery;
  */
 int av_get_packet(AVIOContext *s, AVPacket *pkt, int size);
 
+/**
+ * Like av_get_packet(), but the packet references the IO buffer instead of
+ * a copy of it if the requested bytes are already buffered. This requires
+ * an IO context opened by libavformat, and the packet must not be much
+ * smaller than the buffer, all of which it keeps allocated. Otherwise the
+ * data is copied as with av_get_packet().
+ *
+ * The packet data must not be modified in place, and its padding is not
+ * zeroed but holds the data following it in the buffer.
+ *
+ * @param s    associated IO context
+ * @param pkt packet
+ * @param size desired payload size
+ * @return >0 (read size) if OK, AVERROR_xxx otherwise
+ */
+int av_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size);
+
 
 /**
  * Read data and append it to the current content of the AVPacket.
@@ -995,6 +1012,12 @@ typedef struct AVStream {
         int64_t fps_last_dts;
         int     fps_last_dts_idx;
 
+        /**
+         * Per stream statistics of avformat_find_stream_info().
+         */
+        int64_t probe_bytes;
+        int64_t probe_decode_time;
+
     } *info;
 
     int pts_wrap_bits; /**< number of bits in pts (used for wrapping control) */
@@ -1171,6 +1194,15 @@ typedef struct AVStream {
      * - decoding: Set by libavformat to calculate sample_aspect_ratio internally
      */
     AVRational display_aspect_ratio;
+
+    /**
+     * Index entries which would have to be inserted in the middle of
+     * index_entries, kept sorted until they are merged in one pass.
+     * Only used for the generic index, see ff_add_index_entry_deferred().
+     */
+    AVIndexEntry *pending_index_entries;
+    int nb_pending_index_entries;
+    unsigned int pending_index_entries_allocated_size;
 } AVStream;
 
 AVRational av_stream_get_r_frame_rate(const AVStream *s);
@@ -1394,6 +1426,14 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_PRIV_OPT    0x20000 ///< Enable use of private options by delaying codec open (this could be made default once all code is converted)
 #define AVFMT_FLAG_KEEP_SIDE_DATA 0x40000 ///< Don't merge side data but keep it separate.
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
+/**
+ * Allow demuxers to return packets referencing the IO buffer instead of a
+ * copy of it. The padding of such packets is not zeroed but holds the data
+ * following them, which breaks the AV_INPUT_BUFFER_PADDING_SIZE guarantee
+ * parsers, bitstream filters and decoders rely on. Only set it when the
+ * packets are remuxed as they are.
+ */
+#define AVFMT_FLAG_ZERO_COPY  0x100000
 
     /**
      * @deprecated deprecated in favor of probesize2
@@ -1799,6 +1839,16 @@ typedef struct AVFormatContext {
      * Demuxing: Set by user.
      */
     int (*open_cb)(struct AVFormatContext *s, AVIOContext **p, const char *url, int flags, const AVIOInterruptCB *int_cb, AVDictionary **options);
+
+    /**
+     * Number of threads used to decode the streams in
+     * avformat_find_stream_info(), 1 to decode them on the calling thread.
+     * With more than one thread, packets are decoded in small batches, so
+     * a few more packets than needed may be read.
+     * Demuxing only, set by the caller before avformat_find_stream_info()
+     * via AVOptions (NO direct access).
+     */
+    int probe_threads;
 } AVFormatContext;
 
 int av_format_get_probe_score(const AVFormatContext *s);
@@ -1402,7 +1402,11 @@ resync:
         if (size > ast->remaining)
             size = ast->remaining;
         avi->last_pkt_pos = avio_tell(pb);
-        err               = av_get_packet(pb, pkt, size);
+        /* read_gab2_sub() takes over the packet data */
+        if (st->codec->codec_type == AVMEDIA_TYPE_SUBTITLE)
+            err = av_get_packet(pb, pkt, size);
+        else
+            err = ff_get_packet_ref(s, pb, pkt, size);
         if (err < 0)
             return err;
         size = err;
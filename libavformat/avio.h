@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 
+#include "libavutil/buffer.h"
 #include "libavutil/common.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
@@ -202,6 +203,13 @@ typedef struct AVIOContext {
      * This is current internal only, do not use from outside.
      */
     int short_seek_threshold;
+
+    /**
+     * Reference to buffer if it is owned by libavformat, used to hand out
+     * parts of it without copying them. NULL for user supplied buffers.
+     * This field is internal to libavformat and access from outside is not allowed.
+     */
+    AVBufferRef *buffer_ref;
 } AVIOContext;
 
 /* unbuffered I/O */
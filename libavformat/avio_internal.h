@@ -54,6 +54,22 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes by returning a new reference to the underlying buffer
+ * instead of copying them.
+ *
+ * This only works for buffers owned by libavformat, i.e. contexts opened
+ * with avio_open(), and if the requested bytes are already in the buffer,
+ * followed by at least AV_INPUT_BUFFER_PADDING_SIZE allocated bytes. The
+ * padding is not zeroed, it holds whatever follows in the buffer.
+ * As the reference keeps the whole buffer allocated, reads of less than
+ * an eighth of it, e.g. after ffio_ensure_seekback() grew it, return NULL.
+ *
+ * @return a reference whose data and size describe the requested bytes,
+ *         or NULL if they have to be read with avio_read()
+ */
+AVBufferRef *ffio_read_ref(AVIOContext *s, int size);
+
 /**
  * Read size bytes from AVIOContext into buf.
  * This reads at most 1 packet. If that is not enough fewer bytes will be
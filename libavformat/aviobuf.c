@@ -42,6 +42,13 @@
  */
 #define SHORT_SEEK_THRESHOLD 4096
 
+/**
+ * A reference handed out by ffio_read_ref() keeps the whole buffer
+ * allocated. Smaller reads are copied rather than pinning more than this
+ * many times their size.
+ */
+#define MAX_REF_RATIO 8
+
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
@@ -447,6 +454,7 @@ static void fill_buffer(AVIOContext *s)
     uint8_t *dst        = s->buf_end - s->buffer + max_buffer_size < s->buffer_size ?
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
+    AVBufferRef *new_buffer = NULL;
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
@@ -476,6 +484,17 @@ static void fill_buffer(AVIOContext *s)
         len = s->orig_buffer_size;
     }
 
+    /* packets still reference the buffer, read into a new one */
+    if (dst == s->buffer && s->buffer_ref && !av_buffer_is_writable(s->buffer_ref)) {
+        new_buffer = av_buffer_alloc(s->buffer_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!new_buffer) {
+            s->eof_reached = 1;
+            s->error = AVERROR(ENOMEM);
+            return;
+        }
+        dst = new_buffer->data;
+    }
+
     if (s->read_packet)
         len = s->read_packet(s->opaque, dst, len);
     else
@@ -486,7 +505,15 @@ static void fill_buffer(AVIOContext *s)
         s->eof_reached = 1;
         if (len < 0)
             s->error = len;
+        av_buffer_unref(&new_buffer);
     } else {
+        if (new_buffer) {
+            av_buffer_unref(&s->buffer_ref);
+            s->buffer_ref = new_buffer;
+            s->buffer     = dst;
+            if (s->update_checksum)
+                s->checksum_ptr = dst;
+        }
         s->pos += len;
         s->buf_ptr = dst;
         s->buf_end = dst + len;
@@ -603,6 +630,25 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
     }
 }
 
+AVBufferRef *ffio_read_ref(AVIOContext *s, int size)
+{
+    AVBufferRef *ref;
+
+    if (!s->buffer_ref || s->write_flag || s->buf_end - s->buf_ptr < size ||
+        size < s->buffer_ref->size / MAX_REF_RATIO ||
+        s->buffer_ref->data + s->buffer_ref->size - s->buf_ptr <
+        (int64_t)size + AV_INPUT_BUFFER_PADDING_SIZE)
+        return NULL;
+
+    ref = av_buffer_ref(s->buffer_ref);
+    if (!ref)
+        return NULL;
+    ref->data   = s->buf_ptr;
+    ref->size   = size;
+    s->buf_ptr += size;
+    return ref;
+}
+
 int ffio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -784,7 +830,7 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     } else {
         buffer_size = IO_BUFFER_SIZE;
     }
-    buffer = av_malloc(buffer_size);
+    buffer = av_malloc(buffer_size + AV_INPUT_BUFFER_PADDING_SIZE);
     if (!buffer)
         return AVERROR(ENOMEM);
 
@@ -796,6 +842,15 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
         av_free(buffer);
         return AVERROR(ENOMEM);
     }
+    if (!(h->flags & AVIO_FLAG_WRITE)) {
+        (*s)->buffer_ref = av_buffer_create(buffer, buffer_size + AV_INPUT_BUFFER_PADDING_SIZE,
+                                            av_buffer_default_free, NULL, 0);
+        if (!(*s)->buffer_ref) {
+            av_free(buffer);
+            av_freep(s);
+            return AVERROR(ENOMEM);
+        }
+    }
     (*s)->direct = h->flags & AVIO_FLAG_DIRECT;
     (*s)->seekable = h->is_streamed ? 0 : AVIO_SEEKABLE_NORMAL;
     (*s)->max_packet_size = max_packet_size;
@@ -807,12 +862,33 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     return 0;
 }
 
+/**
+ * Replace the buffer of s, keeping the old one alive as long as packets
+ * reference it. On failure, the new buffer is left to the caller.
+ */
+static int replace_buffer(AVIOContext *s, uint8_t *buffer, int alloc_size)
+{
+    if (s->buffer_ref) {
+        AVBufferRef *ref = av_buffer_create(buffer, alloc_size,
+                                            av_buffer_default_free, NULL, 0);
+        if (!ref)
+            return AVERROR(ENOMEM);
+        av_buffer_unref(&s->buffer_ref);
+        s->buffer_ref = ref;
+    } else {
+        av_free(s->buffer);
+    }
+    s->buffer = buffer;
+    return 0;
+}
+
 int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 {
     uint8_t *buffer;
     int max_buffer_size = s->max_packet_size ?
                           s->max_packet_size : IO_BUFFER_SIZE;
     int filled = s->buf_end - s->buffer;
+    ptrdiff_t buf_ptr_offset = s->buf_ptr - s->buffer;
     ptrdiff_t checksum_ptr_offset = s->checksum_ptr ? s->checksum_ptr - s->buffer : -1;
 
     buf_size += s->buf_ptr - s->buffer + max_buffer_size;
@@ -821,15 +897,17 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
         return 0;
     av_assert0(!s->write_flag);
 
-    buffer = av_malloc(buf_size);
+    buffer = av_malloc(buf_size + AV_INPUT_BUFFER_PADDING_SIZE);
     if (!buffer)
         return AVERROR(ENOMEM);
 
     memcpy(buffer, s->buffer, filled);
-    av_free(s->buffer);
-    s->buf_ptr = buffer + (s->buf_ptr - s->buffer);
-    s->buf_end = buffer + (s->buf_end - s->buffer);
-    s->buffer = buffer;
+    if (replace_buffer(s, buffer, buf_size + AV_INPUT_BUFFER_PADDING_SIZE) < 0) {
+        av_free(buffer);
+        return AVERROR(ENOMEM);
+    }
+    s->buf_ptr = buffer + buf_ptr_offset;
+    s->buf_end = buffer + filled;
     s->buffer_size = buf_size;
     if (checksum_ptr_offset >= 0)
         s->checksum_ptr = s->buffer + checksum_ptr_offset;
@@ -839,12 +917,14 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 int ffio_set_buf_size(AVIOContext *s, int buf_size)
 {
     uint8_t *buffer;
-    buffer = av_malloc(buf_size);
+    buffer = av_malloc(buf_size + AV_INPUT_BUFFER_PADDING_SIZE);
     if (!buffer)
         return AVERROR(ENOMEM);
 
-    av_free(s->buffer);
-    s->buffer = buffer;
+    if (replace_buffer(s, buffer, buf_size + AV_INPUT_BUFFER_PADDING_SIZE) < 0) {
+        av_free(buffer);
+        return AVERROR(ENOMEM);
+    }
     s->orig_buffer_size =
     s->buffer_size = buf_size;
     s->buf_ptr = buffer;
@@ -899,8 +979,11 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_si
         buf_size = new_size;
     }
 
-    av_free(s->buffer);
-    s->buf_ptr = s->buffer = buf;
+    if (replace_buffer(s, buf, alloc_size) < 0) {
+        av_freep(bufp);
+        return AVERROR(ENOMEM);
+    }
+    s->buf_ptr = buf;
     s->buffer_size = alloc_size;
     s->pos = buf_size;
     s->buf_end = s->buf_ptr + buf_size;
@@ -947,7 +1030,10 @@ int avio_close(AVIOContext *s)
 
     avio_flush(s);
     h = s->opaque;
-    av_freep(&s->buffer);
+    if (s->buffer_ref)
+        av_buffer_unref(&s->buffer_ref);
+    else
+        av_freep(&s->buffer);
     if (s->write_flag)
         av_log(s, AV_LOG_DEBUG, "Statistics: %d seeks, %d writeouts\n", s->seek_count, s->writeout_count);
     else
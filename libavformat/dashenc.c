@@ -70,6 +70,10 @@ typedef struct OutputStream {
     Segment **segments;
     int64_t first_pts, start_pts, max_pts;
     int64_t last_dts;
+    int64_t frag_start_pts;
+    int segment_started;
+    int64_t seg_start_pos;
+    char seg_file[1024], seg_path[1024];
     int bit_rate;
     char bandwidth_str[64];
 
@@ -94,6 +98,7 @@ typedef struct DASHContext {
     const char *single_file_name;
     const char *init_seg_name;
     const char *media_seg_name;
+    int64_t frag_duration;
 } DASHContext;
 
 static int dash_write(void *opaque, uint8_t *buf, int buf_size)
@@ -196,17 +201,26 @@ static void dash_free(AVFormatContext *s)
 static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c)
 {
     int i, start_index = 0, start_number = 1;
+    char availability[100] = "";
     if (c->window_size) {
         start_index  = FFMAX(os->nb_segments   - c->window_size, 0);
         start_number = FFMAX(os->segment_index - c->window_size, 1);
     }
+    if (c->frag_duration) {
+        // The first fragment of a segment can be fetched once it is written,
+        // the whole segment duration minus one fragment before it completes.
+        int64_t seg_duration = c->last_duration ? c->last_duration : c->min_seg_duration;
+        snprintf(availability, sizeof(availability),
+                 " availabilityTimeOffset=\"%.3f\" availabilityTimeComplete=\"false\"",
+                 FFMAX(seg_duration - c->frag_duration, 0) / (double)AV_TIME_BASE);
+    }
 
     if (c->use_template) {
         int timescale = c->use_timeline ? os->ctx->streams[0]->time_base.den : AV_TIME_BASE;
         avio_printf(out, "\t\t\t\t<SegmentTemplate timescale=\"%d\" ", timescale);
         if (!c->use_timeline)
             avio_printf(out, "duration=\"%"PRId64"\" ", c->last_duration);
-        avio_printf(out, "initialization=\"%s\" media=\"%s\" startNumber=\"%d\">\n", c->init_seg_name, c->media_seg_name, c->use_timeline ? start_number : 1);
+        avio_printf(out, "initialization=\"%s\" media=\"%s\" startNumber=\"%d\"%s>\n", c->init_seg_name, c->media_seg_name, c->use_timeline ? start_number : 1, availability);
         if (c->use_timeline) {
             int64_t cur_time = 0;
             avio_printf(out, "\t\t\t\t\t<SegmentTimeline>\n");
@@ -553,6 +567,15 @@ static int dash_write_header(AVFormatContext *s)
     if (c->single_file)
         c->use_template = 0;
 
+    /* With a timeline or a segment list, a segment is only listed in the
+     * manifest once it is complete, so its fragments cannot be fetched
+     * any earlier. */
+    if (c->frag_duration && (!c->use_template || c->use_timeline)) {
+        av_log(s, AV_LOG_ERROR, "frag_duration requires use_template=1, "
+               "use_timeline=0 and no single_file\n");
+        return AVERROR(EINVAL);
+    }
+
     av_strlcpy(c->dirname, s->filename, sizeof(c->dirname));
     ptr = strrchr(c->dirname, '/');
     if (ptr) {
@@ -664,6 +687,7 @@ static int dash_write_header(AVFormatContext *s)
         os->first_pts = AV_NOPTS_VALUE;
         os->max_pts = AV_NOPTS_VALUE;
         os->last_dts = AV_NOPTS_VALUE;
+        os->frag_start_pts = AV_NOPTS_VALUE;
         os->segment_index = 1;
     }
 
@@ -771,6 +795,56 @@ static int update_stream_extradata(AVFormatContext *s, OutputStream *os,
     return 0;
 }
 
+static int dash_start_segment(AVFormatContext *s, int stream)
+{
+    DASHContext *c = s->priv_data;
+    OutputStream *os = &c->streams[stream];
+    char temp_path[1024];
+    int ret;
+
+    if (!os->init_range_length) {
+        av_write_frame(os->ctx, NULL);
+        os->init_range_length = avio_tell(os->ctx->pb);
+        if (!c->single_file) {
+            ffurl_close(os->out);
+            os->out = NULL;
+        }
+    }
+
+    os->seg_start_pos = avio_tell(os->ctx->pb);
+
+    if (!c->single_file) {
+        dash_fill_tmpl_params(os->seg_file, sizeof(os->seg_file), c->media_seg_name, stream, os->segment_index, os->bit_rate, os->start_pts);
+        snprintf(os->seg_path, sizeof(os->seg_path), "%s%s", c->dirname, os->seg_file);
+        // Fragmented segments are written under their final name right away,
+        // so that clients can fetch them while they are being written.
+        snprintf(temp_path, sizeof(temp_path), c->frag_duration ? "%s" : "%s.tmp", os->seg_path);
+        ret = ffurl_open(&os->out, temp_path, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+        if (ret < 0)
+            return ret;
+        write_styp(os->ctx->pb);
+    } else {
+        os->seg_file[0] = '\0';
+        snprintf(os->seg_path, sizeof(os->seg_path), "%s%s", c->dirname, os->initfile);
+    }
+    os->segment_started = 1;
+    return 0;
+}
+
+static int dash_flush_fragment(AVFormatContext *s, int stream)
+{
+    DASHContext *c = s->priv_data;
+    OutputStream *os = &c->streams[stream];
+    int ret;
+
+    if (!os->segment_started && (ret = dash_start_segment(s, stream)) < 0)
+        return ret;
+    av_write_frame(os->ctx, NULL);
+    avio_flush(os->ctx->pb);
+    os->frag_start_pts = AV_NOPTS_VALUE;
+    return 0;
+}
+
 static int dash_flush(AVFormatContext *s, int final, int stream)
 {
     DASHContext *c = s->priv_data;
@@ -781,8 +855,7 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
 
     for (i = 0; i < s->nb_streams; i++) {
         OutputStream *os = &c->streams[i];
-        char filename[1024] = "", full_path[1024], temp_path[1024];
-        int64_t start_pos;
+        char temp_path[1024];
         int range_length, index_length = 0;
 
         if (!os->packets_written)
@@ -800,45 +873,26 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
                 continue;
         }
 
-        if (!os->init_range_length) {
-            av_write_frame(os->ctx, NULL);
-            os->init_range_length = avio_tell(os->ctx->pb);
-            if (!c->single_file) {
-                ffurl_close(os->out);
-                os->out = NULL;
-            }
-        }
-
-        start_pos = avio_tell(os->ctx->pb);
-
-        if (!c->single_file) {
-            dash_fill_tmpl_params(filename, sizeof(filename), c->media_seg_name, i, os->segment_index, os->bit_rate, os->start_pts);
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, filename);
-            snprintf(temp_path, sizeof(temp_path), "%s.tmp", full_path);
-            ret = ffurl_open(&os->out, temp_path, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
-            if (ret < 0)
-                break;
-            write_styp(os->ctx->pb);
-        } else {
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, os->initfile);
-        }
-
-        av_write_frame(os->ctx, NULL);
-        avio_flush(os->ctx->pb);
+        if ((ret = dash_flush_fragment(s, i)) < 0)
+            break;
         os->packets_written = 0;
+        os->segment_started = 0;
 
-        range_length = avio_tell(os->ctx->pb) - start_pos;
+        range_length = avio_tell(os->ctx->pb) - os->seg_start_pos;
         if (c->single_file) {
-            find_index_range(s, full_path, start_pos, &index_length);
+            find_index_range(s, os->seg_path, os->seg_start_pos, &index_length);
         } else {
             ffurl_close(os->out);
             os->out = NULL;
-            ret = ff_rename(temp_path, full_path, s);
-            if (ret < 0)
-                break;
+            if (!c->frag_duration) {
+                snprintf(temp_path, sizeof(temp_path), "%s.tmp", os->seg_path);
+                ret = ff_rename(temp_path, os->seg_path, s);
+                if (ret < 0)
+                    break;
+            }
         }
-        add_segment(os, filename, os->start_pts, os->max_pts - os->start_pts, start_pos, range_length, index_length);
-        av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, full_path);
+        add_segment(os, os->seg_file, os->start_pts, os->max_pts - os->start_pts, os->seg_start_pos, range_length, index_length);
+        av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, os->seg_path);
     }
 
     if (c->window_size || (final && c->remove_at_exit)) {
@@ -925,6 +979,15 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
             return ret;
     }
 
+    // In fragmented mode, cut a fragment and output it right away once it
+    // is long enough, keyframe or not.
+    if (c->frag_duration && os->frag_start_pts != AV_NOPTS_VALUE &&
+        av_compare_ts(pkt->pts - os->frag_start_pts, st->time_base,
+                      c->frag_duration, AV_TIME_BASE_Q) >= 0) {
+        if ((ret = dash_flush_fragment(s, pkt->stream_index)) < 0)
+            return ret;
+    }
+
     if (!os->packets_written) {
         // If we wrote a previous segment, adjust the start time of the segment
         // to the end of the previous one (which is the same as the mp4 muxer
@@ -938,6 +1001,8 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         os->max_pts = pkt->pts + pkt->duration;
     else
         os->max_pts = FFMAX(os->max_pts, pkt->pts + pkt->duration);
+    if (os->frag_start_pts == AV_NOPTS_VALUE)
+        os->frag_start_pts = pkt->pts;
     os->packets_written++;
     return ff_write_chained(os->ctx, 0, pkt, s, 0);
 }
@@ -981,6 +1046,7 @@ static const AVOption options[] = {
     { "window_size", "number of segments kept in the manifest", OFFSET(window_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
     { "extra_window_size", "number of segments kept outside of the manifest before removing from disk", OFFSET(extra_window_size), AV_OPT_TYPE_INT, { .i64 = 5 }, 0, INT_MAX, E },
     { "min_seg_duration", "minimum segment duration (in microseconds)", OFFSET(min_seg_duration), AV_OPT_TYPE_INT64, { .i64 = 5000000 }, 0, INT_MAX, E },
+    { "frag_duration", "write segments as fragments of this duration (in microseconds), each output as soon as it is complete", OFFSET(frag_duration), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT_MAX, E },
     { "remove_at_exit", "remove all segments when finished", OFFSET(remove_at_exit), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, E },
     { "use_template", "Use SegmentTemplate instead of SegmentList", OFFSET(use_template), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, E },
     { "use_timeline", "Use SegmentTimeline in SegmentTemplate", OFFSET(use_timeline), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, E },
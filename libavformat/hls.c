@@ -32,13 +32,19 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/bprint.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
 #include "avio_internal.h"
+#include "http.h"
 #include "url.h"
 #include "id3v2.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #define INITIAL_BUFFER_SIZE 32768
 
 #define MAX_FIELD_LEN 64
@@ -75,6 +81,21 @@ struct segment {
     uint8_t iv[16];
 };
 
+/*
+ * A segment downloaded ahead of the demuxer by the prefetch thread. The
+ * data grows while the download is running, so that the demuxer can start
+ * reading a segment before it is complete.
+ */
+struct prefetch_segment {
+    int seq_no;
+    int64_t duration;
+    uint8_t *data;
+    unsigned int allocated_size;
+    int size;
+    int done;   /* the download has ended, with error if it failed */
+    int error;
+};
+
 struct rendition;
 
 enum PlaylistType {
@@ -135,6 +156,27 @@ struct playlist {
      * multiple (playlist-less) renditions associated with them. */
     int n_renditions;
     struct rendition **renditions;
+
+    /* Segment prefetching, see prefetch_thread(). While the thread runs,
+     * the segment list and playlist header fields above and the fields
+     * under HAVE_PTHREADS below are protected by prefetch_mutex. */
+    int prefetch_running;
+    int prefetch_disabled;      /* encrypted segments, read serially */
+    int prefetch_cur;           /* reading from the first prefetched segment */
+#if HAVE_PTHREADS
+    pthread_t prefetch_thread;
+    pthread_mutex_t prefetch_mutex;
+    pthread_cond_t prefetch_cond;
+    int prefetch_abort;
+    int prefetch_end;           /* why the thread stopped, 0 while running */
+    int prefetch_seq_no;        /* next segment to download */
+    struct prefetch_segment *prefetched; /* ring of prefetch_segments entries */
+    int prefetch_first;
+    int nb_prefetched;
+    int64_t prefetch_bytes;
+    AVDictionary *prefetch_opts;
+    AVIOInterruptCB prefetch_interrupt;
+#endif
 };
 
 /*
@@ -183,6 +225,9 @@ typedef struct HLSContext {
     char *cookies;                       ///< holds HTTP cookie values set in either the initial response or as an AVOption to the HTTP protocol context
     char *headers;                       ///< holds HTTP headers set as an AVOption to the HTTP protocol context
     AVDictionary *avio_opts;
+    int prefetch_segments;
+    int64_t prefetch_max_size;
+    int http_persistent;
 } HLSContext;
 
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
@@ -205,11 +250,57 @@ static void free_segment_list(struct playlist *pls)
     pls->n_segments = 0;
 }
 
+/* Stop the prefetch thread of a playlist and drop what it downloaded. */
+static void prefetch_stop(struct playlist *pls)
+{
+#if HAVE_PTHREADS
+    HLSContext *c;
+    int i;
+
+    if (!pls->prefetch_running)
+        return;
+    c = pls->parent->priv_data;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    pls->prefetch_abort = 1;
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+    pthread_join(pls->prefetch_thread, NULL);
+
+    pthread_cond_destroy(&pls->prefetch_cond);
+    pthread_mutex_destroy(&pls->prefetch_mutex);
+    for (i = 0; i < c->prefetch_segments; i++)
+        av_freep(&pls->prefetched[i].data);
+    av_freep(&pls->prefetched);
+    av_dict_free(&pls->prefetch_opts);
+    pls->prefetch_running = 0;
+    pls->prefetch_cur     = 0;
+#endif
+}
+
+/* Protect the segment list against reloads by the prefetch thread. */
+static void playlist_lock(struct playlist *pls)
+{
+#if HAVE_PTHREADS
+    if (pls->prefetch_running)
+        pthread_mutex_lock(&pls->prefetch_mutex);
+#endif
+}
+
+static void playlist_unlock(struct playlist *pls)
+{
+#if HAVE_PTHREADS
+    if (pls->prefetch_running)
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+#endif
+}
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        prefetch_stop(pls);
         free_segment_list(pls);
         av_freep(&pls->renditions);
         av_freep(&pls->id3_buf);
@@ -740,12 +831,24 @@ enum ReadFromURLMode {
     READ_COMPLETE,
 };
 
+static int read_prefetched(struct playlist *pls, uint8_t *buf, int buf_size,
+                           enum ReadFromURLMode mode);
+
 /* read from URLContext, limiting read to current segment */
 static int read_from_url(struct playlist *pls, uint8_t *buf, int buf_size,
                          enum ReadFromURLMode mode)
 {
     int ret;
-    struct segment *seg = pls->segments[pls->cur_seq_no - pls->start_seq_no];
+    struct segment *seg;
+
+    if (pls->prefetch_cur) {
+        ret = read_prefetched(pls, buf, buf_size, mode);
+        if (ret > 0)
+            pls->cur_seg_offset += ret;
+        return ret;
+    }
+
+    seg = pls->segments[pls->cur_seq_no - pls->start_seq_no];
 
      /* limit read if the segment was only a part of a file */
     if (seg->size >= 0)
@@ -1069,6 +1172,412 @@ static int64_t default_reload_interval(struct playlist *pls)
                           pls->target_duration;
 }
 
+#if HAVE_PTHREADS
+static int same_http_server(const char *url1, const char *url2)
+{
+    char proto1[16], host1[256], proto2[16], host2[256];
+    int port1, port2;
+
+    av_url_split(proto1, sizeof(proto1), NULL, 0, host1, sizeof(host1),
+                 &port1, NULL, 0, url1);
+    av_url_split(proto2, sizeof(proto2), NULL, 0, host2, sizeof(host2),
+                 &port2, NULL, 0, url2);
+
+    return (!strcmp(proto1, "http") || !strcmp(proto1, "https")) &&
+           !strcmp(proto1, proto2) && !av_strcasecmp(host1, host2) &&
+           port1 == port2;
+}
+
+/*
+ * Interrupt callback of the prefetch thread requests: the user callback,
+ * plus prefetch_stop(), which must not wait for a stalled server.
+ */
+static int prefetch_interrupt_cb(void *opaque)
+{
+    struct playlist *pls = opaque;
+    HLSContext *c = pls->parent->priv_data;
+    int abort;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    abort = pls->prefetch_abort;
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return abort || ff_check_interrupt(c->interrupt_callback);
+}
+
+/*
+ * Start a request from the prefetch thread. If the previous request went
+ * to the same HTTP server and was read to the end, its connection is
+ * reused instead of opening a new one.
+ */
+static int prefetch_open(struct playlist *pls, URLContext **uc, char *uc_url,
+                         const char *url, int64_t offset, int64_t size)
+{
+    HLSContext *c = pls->parent->priv_data;
+    AVDictionary *opts = NULL;
+    int ret;
+
+#if CONFIG_HTTP_PROTOCOL
+    if (*uc && size < 0 && same_http_server(uc_url, url)) {
+        av_opt_set_int((*uc)->priv_data, "end_offset", 0, 0);
+        if (ff_http_do_new_request(*uc, url) >= 0) {
+            av_strlcpy(uc_url, url, MAX_URL_SIZE);
+            return 0;
+        }
+        /* the server may have closed the connection, retry with a new one */
+    }
+#endif
+    if (*uc)
+        ffurl_closep(uc);
+
+    av_dict_copy(&opts, pls->prefetch_opts, 0);
+    if (c->http_persistent)
+        av_dict_set(&opts, "multiple_requests", "1", 0);
+    if (size >= 0) {
+        av_dict_set_int(&opts, "offset", offset, 0);
+        av_dict_set_int(&opts, "end_offset", offset + size, 0);
+    }
+    ret = ffurl_open(uc, url, AVIO_FLAG_READ, &pls->prefetch_interrupt, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    /* see open_input() */
+    if ((ret = ffurl_seek(*uc, offset, SEEK_SET)) < 0) {
+        av_log(pls->parent, AV_LOG_ERROR, "Unable to seek to offset %"PRId64" of HLS segment '%s'\n", offset, url);
+        ffurl_closep(uc);
+        return ret;
+    }
+    av_strlcpy(uc_url, url, MAX_URL_SIZE);
+    return 0;
+}
+
+/*
+ * Reload a live playlist from the prefetch thread. The playlist is
+ * downloaded without holding the lock, and only parsed with it.
+ */
+static int prefetch_reload_playlist(struct playlist *pls, URLContext **uc,
+                                    char *uc_url)
+{
+    HLSContext *c = pls->parent->priv_data;
+    AVIOContext pb = { 0 };
+    AVBPrint bp;
+    uint8_t *new_url = NULL;
+    char buf[1024];
+    int ret;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+    ret = prefetch_open(pls, uc, uc_url, pls->url, 0, -1);
+    while (ret >= 0) {
+        ret = ffurl_read(*uc, buf, sizeof(buf));
+        if (ret <= 0)
+            break;
+        av_bprint_append_data(&bp, buf, ret);
+    }
+    if (*uc && ret < 0 && ret != AVERROR_EOF)
+        ffurl_closep(uc);
+    if (*uc)
+        av_opt_get(*uc, "location", AV_OPT_SEARCH_CHILDREN, &new_url);
+    pthread_mutex_lock(&pls->prefetch_mutex);
+
+    if (ret == AVERROR_EOF)
+        ret = 0;
+    if (ret >= 0 && !av_bprint_is_complete(&bp))
+        ret = AVERROR(ENOMEM);
+    /* variants and renditions belong to the demuxer thread, a media
+     * playlist must not add any */
+    if (ret >= 0 && (strstr(bp.str, "#EXT-X-STREAM-INF:") ||
+                     strstr(bp.str, "#EXT-X-MEDIA:")))
+        ret = AVERROR_INVALIDDATA;
+    if (ret >= 0 && !pls->prefetch_abort) {
+        ffio_init_context(&pb, bp.str, bp.len, 0, NULL, NULL, NULL, NULL);
+        ret = parse_playlist(c, new_url && *new_url ? (char *)new_url : pls->url,
+                             pls, &pb);
+    }
+
+    av_free(new_url);
+    av_bprint_finalize(&bp, NULL);
+    return ret;
+}
+
+/*
+ * Download the segments following the one the demuxer is reading, up to
+ * prefetch_segments of them and prefetch_max_size bytes (the size limit
+ * is checked before starting a segment), and reload live playlists. This
+ * takes the latency of each request off the demuxing thread.
+ */
+static void *prefetch_thread(void *arg)
+{
+    struct playlist *pls = arg;
+    HLSContext *c = pls->parent->priv_data;
+    URLContext *uc = NULL;
+    char uc_url[MAX_URL_SIZE] = "";
+    uint8_t buf[INITIAL_BUFFER_SIZE];
+    int64_t reload_interval = 0;
+    int ret = 0;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    reload_interval = default_reload_interval(pls);
+    while (!pls->prefetch_abort) {
+        struct prefetch_segment *ps;
+        struct segment *seg;
+        char url[MAX_URL_SIZE];
+        int64_t offset, size, duration = 0;
+        int i, eof = 0;
+
+        if (pls->nb_prefetched == c->prefetch_segments ||
+            (pls->nb_prefetched && pls->prefetch_bytes >= c->prefetch_max_size)) {
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+            continue;
+        }
+
+        if (!pls->finished &&
+            av_gettime_relative() - pls->last_load_time >= reload_interval) {
+            if ((ret = prefetch_reload_playlist(pls, &uc, uc_url)) < 0) {
+                av_log(pls->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
+                       pls->index);
+                break;
+            }
+            /* If we need to reload the playlist again below (if
+             * there's still no more segments), switch to a reload
+             * interval of half the target duration. */
+            reload_interval = pls->target_duration / 2;
+            continue;
+        }
+        if (pls->prefetch_seq_no < pls->start_seq_no) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "skipping %d segments ahead, expired from playlists\n",
+                   pls->start_seq_no - pls->prefetch_seq_no);
+            pls->prefetch_seq_no = pls->start_seq_no;
+        }
+        if (pls->prefetch_seq_no >= pls->start_seq_no + pls->n_segments) {
+            if (pls->finished) {
+                ret = AVERROR_EOF;
+                break;
+            }
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+            ret = ff_check_interrupt(&pls->prefetch_interrupt) ? AVERROR_EXIT : 0;
+            if (!ret)
+                av_usleep(100*1000);
+            pthread_mutex_lock(&pls->prefetch_mutex);
+            if (ret < 0)
+                break;
+            continue;
+        }
+        reload_interval = default_reload_interval(pls);
+
+        seg = pls->segments[pls->prefetch_seq_no - pls->start_seq_no];
+        if (seg->key_type != KEY_NONE) {
+            /* left to open_input(), which keeps the key state */
+            ret = AVERROR(ENOSYS);
+            break;
+        }
+        av_strlcpy(url, seg->url, sizeof(url));
+        offset = seg->url_offset;
+        size   = seg->size;
+
+        ps = &pls->prefetched[(pls->prefetch_first + pls->nb_prefetched) %
+                              c->prefetch_segments];
+        ps->seq_no   = pls->prefetch_seq_no++;
+        ps->duration = seg->duration;
+        ps->size     = 0;
+        ps->done     = 0;
+        ps->error    = 0;
+        pls->nb_prefetched++;
+        pthread_cond_broadcast(&pls->prefetch_cond);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+
+        av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch for url '%s', offset %"PRId64", playlist %d\n",
+               url, offset, pls->index);
+
+        ret = prefetch_open(pls, &uc, uc_url, url, offset, size);
+        while (ret >= 0) {
+            int len = sizeof(buf);
+            uint8_t *data;
+
+            if (size >= 0) {
+                len = FFMIN(len, size - ps->size);
+                if (!len)
+                    break;
+            }
+            ret = ffurl_read(uc, buf, len);
+            if (ret <= 0) {
+                eof = !ret || ret == AVERROR_EOF;
+                break;
+            }
+
+            pthread_mutex_lock(&pls->prefetch_mutex);
+            data = av_fast_realloc(ps->data, &ps->allocated_size, ps->size + ret);
+            if (data) {
+                ps->data = data;
+                memcpy(ps->data + ps->size, buf, ret);
+                ps->size            += ret;
+                pls->prefetch_bytes += ret;
+                pthread_cond_broadcast(&pls->prefetch_cond);
+            } else {
+                ret = AVERROR(ENOMEM);
+            }
+            if (pls->prefetch_abort)
+                ret = AVERROR_EXIT;
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+        }
+        /* only a response that was read to the end leaves the connection
+         * ready for the next request */
+        if (!eof && uc)
+            ffurl_closep(&uc);
+
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        if (ret < 0 && !eof) {
+            ps->error = ret;
+            if (!ps->size && ret != AVERROR_EXIT)
+                av_log(pls->parent, AV_LOG_WARNING, "Failed to open segment of playlist %d\n",
+                       pls->index);
+        }
+        ps->done = 1;
+        pthread_cond_broadcast(&pls->prefetch_cond);
+
+        for (i = 0; i < pls->nb_prefetched; i++)
+            duration += pls->prefetched[(pls->prefetch_first + i) %
+                                        c->prefetch_segments].duration;
+        av_log(pls->parent, AV_LOG_VERBOSE,
+               "playlist %d: %d segments, %.3f s, %"PRId64" bytes prefetched\n",
+               pls->index, pls->nb_prefetched, duration / (double)AV_TIME_BASE,
+               pls->prefetch_bytes);
+    }
+    pls->prefetch_end = ret < 0 ? ret : AVERROR_EXIT;
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    if (uc)
+        ffurl_close(uc);
+    return NULL;
+}
+
+static int prefetch_start(HLSContext *c, struct playlist *pls)
+{
+    int ret;
+
+    pls->prefetched = av_mallocz_array(c->prefetch_segments,
+                                       sizeof(*pls->prefetched));
+    if (!pls->prefetched)
+        return AVERROR(ENOMEM);
+
+    /* the options of open_input(), copied as the demuxer thread may
+     * update the cookies while the prefetch thread runs */
+    av_dict_copy(&pls->prefetch_opts, c->avio_opts, 0);
+    av_dict_set(&pls->prefetch_opts, "user-agent", c->user_agent, 0);
+    av_dict_set(&pls->prefetch_opts, "cookies", c->cookies, 0);
+    av_dict_set(&pls->prefetch_opts, "headers", c->headers, 0);
+    av_dict_set(&pls->prefetch_opts, "seekable", "0", 0);
+
+    pls->prefetch_abort  = 0;
+    pls->prefetch_end    = 0;
+    pls->prefetch_seq_no = pls->cur_seq_no;
+    pls->prefetch_first  = 0;
+    pls->nb_prefetched   = 0;
+    pls->prefetch_bytes  = 0;
+    pls->prefetch_interrupt.callback = prefetch_interrupt_cb;
+    pls->prefetch_interrupt.opaque   = pls;
+
+    if ((ret = pthread_mutex_init(&pls->prefetch_mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&pls->prefetch_cond, NULL))) {
+        pthread_mutex_destroy(&pls->prefetch_mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_create(&pls->prefetch_thread, NULL, prefetch_thread, pls))) {
+        pthread_cond_destroy(&pls->prefetch_cond);
+        pthread_mutex_destroy(&pls->prefetch_mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    pls->prefetch_running = 1;
+    return 0;
+
+fail:
+    av_freep(&pls->prefetched);
+    av_dict_free(&pls->prefetch_opts);
+    return ret;
+}
+
+/*
+ * Wait for the prefetch thread to provide the next segment and start
+ * reading it. Returns AVERROR(ENOSYS) if the segment has to be opened by
+ * open_input() instead.
+ */
+static int prefetch_next_segment(struct playlist *pls)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    while (!pls->nb_prefetched && !pls->prefetch_end)
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+    if (pls->nb_prefetched) {
+        pls->cur_seq_no     = pls->prefetched[pls->prefetch_first].seq_no;
+        pls->cur_seg_offset = 0;
+        pls->prefetch_cur   = 1;
+    } else {
+        ret = pls->prefetch_end;
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return ret;
+}
+
+static int read_prefetched(struct playlist *pls, uint8_t *buf, int buf_size,
+                           enum ReadFromURLMode mode)
+{
+    struct prefetch_segment *ps;
+    int ret;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    ps = &pls->prefetched[pls->prefetch_first];
+    while (!ps->done &&
+           ps->size - pls->cur_seg_offset < (mode == READ_COMPLETE ? buf_size : 1))
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+
+    ret = FFMIN(buf_size, ps->size - pls->cur_seg_offset);
+    if (ret > 0)
+        memcpy(buf, ps->data + pls->cur_seg_offset, ret);
+    else
+        ret = ps->error ? ps->error : AVERROR_EOF;
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return ret;
+}
+
+/* Drop the prefetched segment that has been read, making room for the next. */
+static void prefetch_release_segment(struct playlist *pls)
+{
+    HLSContext *c = pls->parent->priv_data;
+    struct prefetch_segment *ps;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    ps = &pls->prefetched[pls->prefetch_first];
+    pls->prefetch_bytes -= ps->size;
+    ps->size = 0;
+    av_freep(&ps->data);
+    ps->allocated_size  = 0;
+    pls->prefetch_first = (pls->prefetch_first + 1) % c->prefetch_segments;
+    pls->nb_prefetched--;
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    pls->prefetch_cur = 0;
+}
+#else
+static int read_prefetched(struct playlist *pls, uint8_t *buf, int buf_size,
+                           enum ReadFromURLMode mode)
+{
+    return AVERROR_BUG;
+}
+#endif
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
@@ -1080,7 +1589,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input) {
+    if (!v->input && !v->prefetch_cur) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1097,9 +1606,28 @@ restart:
         if (!v->needed) {
             av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d\n",
                 v->index);
+            prefetch_stop(v);
             return AVERROR_EOF;
         }
 
+#if HAVE_PTHREADS
+        if (c->prefetch_segments && !v->prefetch_disabled) {
+            if (!v->prefetch_running && (ret = prefetch_start(c, v)) < 0)
+                return ret;
+            ret = prefetch_next_segment(v);
+            if (ret >= 0) {
+                just_opened = 1;
+                goto read;
+            }
+            if (ret != AVERROR(ENOSYS))
+                return ret;
+            /* continue with the encrypted segment the thread stopped at */
+            prefetch_stop(v);
+            v->cur_seq_no        = v->prefetch_seq_no;
+            v->prefetch_disabled = 1;
+        }
+#endif
+
         /* If this is a live stream and the reload interval has elapsed since
          * the last playlist reload, reload the playlists now. */
         reload_interval = default_reload_interval(v);
@@ -1147,6 +1675,9 @@ reload:
         just_opened = 1;
     }
 
+#if HAVE_PTHREADS
+read:
+#endif
     ret = read_from_url(v, buf, buf_size, READ_NORMAL);
     if (ret > 0) {
         if (just_opened && v->is_id3_timestamped != 0) {
@@ -1157,6 +1688,11 @@ reload:
 
         return ret;
     }
+#if HAVE_PTHREADS
+    if (v->prefetch_cur)
+        prefetch_release_segment(v);
+    else
+#endif
     ffurl_close(v->input);
     v->input = NULL;
     v->cur_seq_no++;
@@ -1405,6 +1941,7 @@ static int hls_read_header(AVFormatContext *s)
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
         AVInputFormat *in_fmt = NULL;
+        char url[MAX_URL_SIZE];
 
         if (!(pls->ctx = avformat_alloc_context())) {
             ret = AVERROR(ENOMEM);
@@ -1429,14 +1966,15 @@ static int hls_read_header(AVFormatContext *s)
         ffio_init_context(&pls->pb, pls->read_buffer, INITIAL_BUFFER_SIZE, 0, pls,
                           read_data, NULL, NULL);
         pls->pb.seekable = 0;
-        ret = av_probe_input_buffer(&pls->pb, &in_fmt, pls->segments[0]->url,
-                                    NULL, 0, 0);
+        /* a prefetch thread may reload the playlist once reading started */
+        av_strlcpy(url, pls->segments[0]->url, sizeof(url));
+        ret = av_probe_input_buffer(&pls->pb, &in_fmt, url, NULL, 0, 0);
         if (ret < 0) {
             /* Free the ctx - it isn't initialized properly at this point,
              * so avformat_close_input shouldn't be called. If
              * avformat_open_input fails below, it frees and zeros the
              * context, so it doesn't need any special treatment like this. */
-            av_log(s, AV_LOG_ERROR, "Error when loading first segment '%s'\n", pls->segments[0]->url);
+            av_log(s, AV_LOG_ERROR, "Error when loading first segment '%s'\n", url);
             avformat_free_context(pls->ctx);
             pls->ctx = NULL;
             goto fail;
@@ -1447,7 +1985,7 @@ static int hls_read_header(AVFormatContext *s)
         if ((ret = ff_copy_whitelists(pls->ctx, s)) < 0)
             goto fail;
 
-        ret = avformat_open_input(&pls->ctx, pls->segments[0]->url, in_fmt, NULL);
+        ret = avformat_open_input(&pls->ctx, url, in_fmt, NULL);
         if (ret < 0)
             goto fail;
 
@@ -1546,6 +2084,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
         if (pls->cur_needed && !pls->needed) {
             pls->needed = 1;
             changed = 1;
+            prefetch_stop(pls);
             pls->cur_seq_no = select_cur_seq_no(c, pls);
             pls->pb.eof_reached = 0;
             if (c->cur_timestamp != AV_NOPTS_VALUE) {
@@ -1559,6 +2098,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             if (pls->input)
                 ffurl_close(pls->input);
             pls->input = NULL;
+            prefetch_stop(pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -1719,12 +2259,14 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
                                int64_t timestamp, int flags)
 {
     HLSContext *c = s->priv_data;
-    struct playlist *seek_pls = NULL;
-    int i, seq_no;
+    struct playlist *seek_pls = NULL, *pls0 = c->variants[0]->playlists[0];
+    int i, seq_no, seekable, found;
     int64_t first_timestamp, seek_timestamp, duration;
 
-    if ((flags & AVSEEK_FLAG_BYTE) ||
-        !(c->variants[0]->playlists[0]->finished || c->variants[0]->playlists[0]->type == PLS_TYPE_EVENT))
+    playlist_lock(pls0);
+    seekable = pls0->finished || pls0->type == PLS_TYPE_EVENT;
+    playlist_unlock(pls0);
+    if ((flags & AVSEEK_FLAG_BYTE) || !seekable)
         return AVERROR(ENOSYS);
 
     first_timestamp = c->first_timestamp == AV_NOPTS_VALUE ?
@@ -1752,9 +2294,17 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     }
     /* check if the timestamp is valid for the playlist with the
      * specified stream index */
-    if (!seek_pls || !find_timestamp_in_playlist(c, seek_pls, seek_timestamp, &seq_no))
+    if (!seek_pls)
+        return AVERROR(EIO);
+    playlist_lock(seek_pls);
+    found = find_timestamp_in_playlist(c, seek_pls, seek_timestamp, &seq_no);
+    playlist_unlock(seek_pls);
+    if (!found)
         return AVERROR(EIO);
 
+    for (i = 0; i < c->n_playlists; i++)
+        prefetch_stop(c->playlists[i]);
+
     /* set segment now so we do not need to search again below */
     seek_pls->cur_seq_no = seq_no;
     seek_pls->seek_stream_index = stream_index - seek_pls->stream_offset;
@@ -1813,6 +2363,12 @@ static int hls_probe(AVProbeData *p)
 static const AVOption hls_options[] = {
     {"live_start_index", "segment index to start live streams at (negative values are from the end)",
         OFFSET(live_start_index), FF_OPT_TYPE_INT, {.i64 = -3}, INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_segments", "number of segments to download ahead in a background thread (0 to disable)",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_max_size", "maximum amount of prefetched data per playlist, in bytes",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 16 << 20}, 0, INT64_MAX, FLAGS},
+    {"http_persistent", "reuse the HTTP connection for prefetched segments",
+        OFFSET(http_persistent), AV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, FLAGS},
     {NULL}
 };
 
@@ -0,0 +1,104 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "avformat.h"
+#include "internal.h"
+
+#define N 1000
+
+static int check_index(AVStream *st, int nb_entries)
+{
+    int i;
+
+    if (st->nb_index_entries != nb_entries) {
+        printf("%d entries instead of %d\n", st->nb_index_entries, nb_entries);
+        return 1;
+    }
+    for (i = 0; i < st->nb_index_entries; i++) {
+        AVIndexEntry *ie = &st->index_entries[i];
+        if (ie->timestamp != i || ie->pos != 100 * i) {
+            printf("entry %d: timestamp %"PRId64" pos %"PRId64"\n",
+                   i, ie->timestamp, ie->pos);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void search(AVStream *st, int64_t ts, int flags)
+{
+    int index = av_index_search_timestamp(st, ts, flags);
+    printf("search %"PRId64" flags %d: %d, %d pending\n",
+           ts, flags, index, st->nb_pending_index_entries);
+}
+
+int main(void)
+{
+    AVFormatContext *s = avformat_alloc_context();
+    AVStream *st;
+    int i, ret = 1;
+
+    if (!s || !(st = avformat_new_stream(s, NULL)))
+        goto end;
+
+    /* even timestamps in order are appended to the index */
+    for (i = 0; i < N; i += 2)
+        if (ff_add_index_entry_deferred(st, 100 * i, i, 0, 0, AVINDEX_KEYFRAME) < 0)
+            goto end;
+    printf("in order: %d entries, %d pending\n",
+           st->nb_index_entries, st->nb_pending_index_entries);
+
+    /* odd ones in reverse order belong in the middle */
+    for (i = N - 1; i > 0; i -= 2)
+        if (ff_add_index_entry_deferred(st, 100 * i, i, 0, 0, AVINDEX_KEYFRAME) < 0)
+            goto end;
+    printf("reverse: %d entries, %d pending\n",
+           st->nb_index_entries, st->nb_pending_index_entries);
+
+    /* existing entries are updated in place */
+    if (ff_add_index_entry_deferred(st, 100 * 10, 10, 0, 0, 0) < 0)
+        goto end;
+    printf("update: %d entries, %d pending\n",
+           st->nb_index_entries, st->nb_pending_index_entries);
+
+    search(st, 501, 0);
+    search(st, 501, AVSEEK_FLAG_BACKWARD);
+    search(st, N, 0);
+    if (check_index(st, N))
+        goto end;
+
+    /* av_add_index_entry() merges the pending entries first */
+    if (!(st = avformat_new_stream(s, NULL)))
+        goto end;
+    for (i = N / 2; i < N; i++)
+        if (ff_add_index_entry_deferred(st, 100 * i, i, 0, 0, AVINDEX_KEYFRAME) < 0)
+            goto end;
+    for (i = N / 2 - 1; i >= 0; i--)
+        if (ff_add_index_entry_deferred(st, 100 * i, i, 0, 0, AVINDEX_KEYFRAME) < 0)
+            goto end;
+    printf("second half first: %d entries, %d pending\n",
+           st->nb_index_entries, st->nb_pending_index_entries);
+    printf("add %d: %d\n", N, av_add_index_entry(st, 100 * N, N, 0, 0, AVINDEX_KEYFRAME));
+    if (check_index(st, N + 1))
+        goto end;
+
+    ret = 0;
+end:
+    avformat_free_context(s);
+    return ret;
+}
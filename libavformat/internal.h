@@ -254,6 +254,34 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
                        unsigned int *index_entries_allocated_size,
                        int64_t pos, int64_t timestamp, int size, int distance, int flags);
 
+/**
+ * Add an index entry which is only used for seeking, without keeping
+ * st->index_entries complete at all times.
+ *
+ * Entries which would have to be inserted in the middle of the index are
+ * collected separately and merged by ff_flush_index_entries(), so that
+ * building an index out of order does not move the whole array around for
+ * every entry. av_index_search_timestamp(), av_add_index_entry(),
+ * ff_reduce_index() and seeking flush the collected entries first, and
+ * they are always merged before avformat_open_input(),
+ * avformat_find_stream_info(), av_read_frame() and the seek functions
+ * return to the caller.
+ *
+ * @return >= 0 on success, a negative value on error
+ */
+int ff_add_index_entry_deferred(AVStream *st, int64_t pos, int64_t timestamp,
+                                int size, int distance, int flags);
+
+/**
+ * Merge the entries collected by ff_add_index_entry_deferred() into
+ * st->index_entries. Demuxer code reading st->index_entries directly
+ * must call this first.
+ *
+ * @return 0 on success, a negative AVERROR on failure, in which case the
+ *         collected entries are kept for the next attempt
+ */
+int ff_flush_index_entries(AVStream *st);
+
 void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance);
 
 /**
@@ -358,6 +386,16 @@ int ff_framehash_write_header(AVFormatContext *s);
  */
 int ff_read_packet(AVFormatContext *s, AVPacket *pkt);
 
+/**
+ * av_get_packet_ref() if AVFMT_FLAG_ZERO_COPY is set in s->flags,
+ * av_get_packet() otherwise. The caller must thus not modify the packet
+ * data in place.
+ *
+ * @param s  media file handle
+ * @param pb IO context to read from, need not be s->pb
+ */
+int ff_get_packet_ref(AVFormatContext *s, AVIOContext *pb, AVPacket *pkt, int size);
+
 /**
  * Interleave a packet per dts in an output media file.
  *
@@ -260,6 +260,14 @@ typedef struct MatroskaLevel1Element {
     int parsed;
 } MatroskaLevel1Element;
 
+/* A block of the Cues element whose CuePoints are in the index. */
+typedef struct MatroskaCuesBlock {
+    int64_t  num;       ///< block number, -1 if unused
+    uint64_t first;     ///< time of the first CuePoint starting in the block
+    uint64_t last;      ///< time of the last CuePoint starting in the block
+    int64_t  last_use;
+} MatroskaCuesBlock;
+
 typedef struct MatroskaDemuxContext {
     const AVClass *class;
     AVFormatContext *ctx;
@@ -312,6 +320,17 @@ typedef struct MatroskaDemuxContext {
 
     /* WebM DASH Manifest live flag/ */
     int is_live;
+
+    /* Lazily parsed Cues: byte range of the element and blocks of it
+     * currently in the index, see matroska_lazy_cues_seek() */
+    int lazy_cues;
+    int cues_cache_size;
+    int64_t cues_start;
+    int64_t cues_end;
+    uint64_t cues_index_scale;
+    MatroskaCuesBlock *cues_blocks;
+    int64_t cues_use_count;
+    uint8_t *cues_buf;
 } MatroskaDemuxContext;
 
 typedef struct MatroskaBlock {
@@ -1559,6 +1578,289 @@ static void matroska_parse_cues(MatroskaDemuxContext *matroska) {
     matroska_add_index_entries(matroska);
 }
 
+#define CUES_BLOCK_SIZE   4096
+/* room for the CuePoints starting near the end of a block */
+#define CUES_BLOCK_MARGIN 4096
+
+/* Read an EBML number from memory, returns its length or 0 if invalid. */
+static int cues_read_num(const uint8_t *p, const uint8_t *end,
+                         int max_size, uint64_t *num)
+{
+    int len, i;
+
+    if (p >= end || !*p)
+        return 0;
+    len = 8 - ff_log2_tab[*p];
+    if (len > max_size || end - p < len)
+        return 0;
+    *num = *p & (0xff >> len);
+    for (i = 1; i < len; i++)
+        *num = (*num << 8) | p[i];
+    return len;
+}
+
+/* Read the ID and the size of an element from memory, returns the size of
+ * its header or 0 if it is invalid or does not fit in the buffer. */
+static int cues_read_elem(const uint8_t *p, const uint8_t *end,
+                          uint32_t *id, uint64_t *size)
+{
+    uint64_t num;
+    int id_len, len;
+
+    if (!(id_len = cues_read_num(p, end, 4, &num)))
+        return 0;
+    *id = AV_RB32(p) >> (8 * (4 - id_len));
+    if (!(len = cues_read_num(p + id_len, end, 8, size)) ||
+        *size > end - p - id_len - len)
+        return 0;
+    return id_len + len;
+}
+
+/**
+ * Parse the CuePoint at p, whose CueTime must come first, and add its
+ * positions to the index if add is set.
+ * @return the size of the CuePoint, 0 if there is no valid one at p
+ */
+static int cues_parse_point(MatroskaDemuxContext *matroska, const uint8_t *p,
+                            const uint8_t *end, int add, uint64_t *time)
+{
+    const uint8_t *q, *elem_end;
+    uint64_t size;
+    uint32_t id;
+    int len, first = 1;
+
+    if (*p != MATROSKA_ID_POINTENTRY ||
+        !(len = cues_read_elem(p, end, &id, &size)))
+        return 0;
+    q        = p + len;
+    elem_end = q + size;
+    while (q < elem_end) {
+        const uint8_t *data;
+        uint64_t val;
+
+        if (!(len = cues_read_elem(q, elem_end, &id, &size)))
+            return 0;
+        data = q + len;
+        q    = data + size;
+        if (first) {
+            if (id != MATROSKA_ID_CUETIME || size > 8)
+                return 0;
+            for (*time = 0; data < q; data++)
+                *time = (*time << 8) | *data;
+            first = 0;
+        } else if (id == MATROSKA_ID_CUETRACKPOSITION && add) {
+            uint64_t track_num = 0, pos = -1;
+            MatroskaTrack *track;
+
+            while (data < q) {
+                if (!(len = cues_read_elem(data, q, &id, &size)) || size > 8)
+                    break;
+                for (val = 0, data += len; size--; data++)
+                    val = (val << 8) | *data;
+                if (id == MATROSKA_ID_CUETRACK)
+                    track_num = val;
+                else if (id == MATROSKA_ID_CUECLUSTERPOSITION)
+                    pos = val;
+            }
+            track = matroska_find_track_by_num(matroska, track_num);
+            if (pos != -1 && track && track->stream)
+                av_add_index_entry(track->stream, pos + matroska->segment_start,
+                                   *time / matroska->cues_index_scale, 0, 0,
+                                   AVINDEX_KEYFRAME);
+        }
+    }
+    return first ? 0 : elem_end - p;
+}
+
+/**
+ * Read the CuePoints starting in the given block of the Cues element,
+ * adding them to the index if add is set.
+ * @return the number of CuePoints, or a negative error code
+ */
+static int matroska_cues_read_block(MatroskaDemuxContext *matroska, int64_t num,
+                                    int add, uint64_t *first, uint64_t *last)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t start   = matroska->cues_start + num * CUES_BLOCK_SIZE;
+    int size        = FFMIN(CUES_BLOCK_SIZE + CUES_BLOCK_MARGIN,
+                            matroska->cues_end - start);
+    const uint8_t *p, *block_end, *end;
+    int len, nb = 0;
+    uint64_t time;
+
+    if (avio_seek(pb, start, SEEK_SET) != start)
+        return AVERROR(EIO);
+    if ((size = avio_read(pb, matroska->cues_buf, size)) <= 0)
+        return size < 0 ? size : AVERROR_EOF;
+    p         = matroska->cues_buf;
+    end       = p + size;
+    block_end = p + FFMIN(size, CUES_BLOCK_SIZE);
+
+    /* The block boundary can fall anywhere, so look for a CuePoint that is
+     * followed by another one or by the end of the Cues. */
+    for (; p < block_end; p++) {
+        if ((len = cues_parse_point(matroska, p, end, 0, &time)) &&
+            (start + (p - matroska->cues_buf) + len == matroska->cues_end ||
+             (p + len < end && p[len] == MATROSKA_ID_POINTENTRY)))
+            break;
+    }
+    while (p < block_end &&
+           (len = cues_parse_point(matroska, p, end, add, &time))) {
+        if (!nb++)
+            *first = time;
+        *last = time;
+        p += len;
+    }
+    return nb;
+}
+
+static int matroska_lazy_cues_init(MatroskaDemuxContext *matroska)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    MatroskaLevel1Element *elem = NULL;
+    uint64_t id, length, first, last;
+    int64_t pos;
+    int i, ret;
+
+    for (i = 0; i < matroska->num_level1_elems; i++)
+        if (matroska->level1_elems[i].id == MATROSKA_ID_CUES &&
+            !matroska->level1_elems[i].parsed)
+            elem = &matroska->level1_elems[i];
+    if (!elem || (matroska->ctx->flags & AVFMT_FLAG_IGNIDX))
+        return AVERROR(ENOSYS);
+
+    pos = elem->pos + matroska->segment_start;
+    if (avio_seek(pb, pos, SEEK_SET) != pos ||
+        ebml_read_num(matroska, pb, 4, &id) != 4 ||
+        (id | 1 << 28) != MATROSKA_ID_CUES ||
+        ebml_read_length(matroska, pb, &length) <= 0 ||
+        length == 0xffffffffffffffULL)
+        return AVERROR_INVALIDDATA;
+    matroska->cues_start = avio_tell(pb);
+    matroska->cues_end   = matroska->cues_start + length;
+
+    matroska->cues_buf    = av_malloc(CUES_BLOCK_SIZE + CUES_BLOCK_MARGIN);
+    matroska->cues_blocks = av_malloc_array(matroska->cues_cache_size,
+                                            sizeof(*matroska->cues_blocks));
+    if (!matroska->cues_buf || !matroska->cues_blocks) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < matroska->cues_cache_size; i++) {
+        matroska->cues_blocks[i].num      = -1;
+        matroska->cues_blocks[i].last_use = 0;
+    }
+
+    if ((ret = matroska_cues_read_block(matroska, 0, 0, &first, &last)) <= 0) {
+        ret = ret ? ret : AVERROR_INVALIDDATA;
+        goto fail;
+    }
+    matroska->cues_index_scale = 1;
+    if (first > 1E14 / matroska->time_scale) {
+        av_log(matroska->ctx, AV_LOG_WARNING, "Working around broken index.\n");
+        matroska->cues_index_scale = matroska->time_scale;
+    }
+    elem->parsed = 1;
+    return 0;
+
+fail:
+    av_freep(&matroska->cues_buf);
+    av_freep(&matroska->cues_blocks);
+    return ret;
+}
+
+/* Make sure the CuePoints of a block are in the index, evicting the least
+ * recently used block if the cache is full. */
+static MatroskaCuesBlock *matroska_cues_find_block(MatroskaDemuxContext *matroska,
+                                                   int64_t num)
+{
+    int i;
+
+    for (i = 0; i < matroska->cues_cache_size; i++)
+        if (matroska->cues_blocks[i].num == num)
+            return &matroska->cues_blocks[i];
+    return NULL;
+}
+
+static MatroskaCuesBlock *matroska_cues_load_block(MatroskaDemuxContext *matroska,
+                                                   int64_t num)
+{
+    MatroskaCuesBlock *block = matroska_cues_find_block(matroska, num);
+    int i, j;
+
+    if (block) {
+        block->last_use = ++matroska->cues_use_count;
+        return block;
+    }
+    block = &matroska->cues_blocks[0];
+    for (i = 1; i < matroska->cues_cache_size; i++)
+        if (matroska->cues_blocks[i].last_use < block->last_use)
+            block = &matroska->cues_blocks[i];
+
+    if (block->num >= 0) {
+        /* Drop the entries of the evicted block from the index; entries
+         * found while reading clusters in that range go with them. */
+        int64_t first = block->first / matroska->cues_index_scale;
+        int64_t last  = block->last  / matroska->cues_index_scale;
+        for (i = 0; i < matroska->ctx->nb_streams; i++) {
+            AVStream *st = matroska->ctx->streams[i];
+            int a = av_index_search_timestamp(st, first, AVSEEK_FLAG_ANY);
+            if (a < 0)
+                continue;
+            for (j = a; j < st->nb_index_entries &&
+                        st->index_entries[j].timestamp <= last; j++)
+                ;
+            memmove(st->index_entries + a, st->index_entries + j,
+                    (st->nb_index_entries - j) * sizeof(*st->index_entries));
+            st->nb_index_entries -= j - a;
+        }
+        block->num = -1;
+    }
+
+    if (matroska_cues_read_block(matroska, num, 1, &block->first, &block->last) <= 0)
+        return NULL;
+    block->num      = num;
+    block->last_use = ++matroska->cues_use_count;
+    return block;
+}
+
+/**
+ * Bring the CuePoints around timestamp into the index. The blocks of the
+ * Cues element are bisected on the time of their first CuePoint, so only
+ * a few small reads are needed per seek.
+ */
+static void matroska_lazy_cues_seek(MatroskaDemuxContext *matroska,
+                                    int64_t timestamp)
+{
+    int64_t pos    = avio_tell(matroska->ctx->pb);
+    int64_t nb     = (matroska->cues_end - matroska->cues_start +
+                      CUES_BLOCK_SIZE - 1) / CUES_BLOCK_SIZE;
+    int64_t lo     = 0, hi = nb - 1;
+    uint64_t first, last;
+    MatroskaCuesBlock *block;
+
+    while (lo < hi) {
+        int64_t mid = (lo + hi + 1) / 2;
+        MatroskaCuesBlock *b = matroska_cues_find_block(matroska, mid);
+        if (b)
+            first = b->first;
+        if ((b || matroska_cues_read_block(matroska, mid, 0, &first, &last) > 0) &&
+            first / matroska->cues_index_scale <= timestamp)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    block = matroska_cues_load_block(matroska, lo);
+    /* also load the next CuePoints, so that the seek does not fall back to
+     * reading the clusters after the last entry */
+    if (block && block->last / matroska->cues_index_scale <= timestamp &&
+        lo + 1 < nb)
+        matroska_cues_load_block(matroska, lo + 1);
+
+    avio_seek(matroska->ctx->pb, pos, SEEK_SET);
+}
+
 static int matroska_aac_profile(char *codec_id)
 {
     static const char *const aac_profiles[] = { "MAIN", "LC", "SSR" };
@@ -2858,8 +3160,8 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, uint8_t *data,
             timecode < track->end_timecode)
             is_keyframe = 0;  /* overlapping subtitles are not key frame */
         if (is_keyframe)
-            av_add_index_entry(st, cluster_pos, timecode, 0, 0,
-                               AVINDEX_KEYFRAME);
+            ff_add_index_entry_deferred(st, cluster_pos, timecode, 0, 0,
+                                        AVINDEX_KEYFRAME);
     }
 
     if (matroska->skip_to_keyframe &&
@@ -3056,8 +3358,11 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     /* Parse the CUES now since we need the index data to seek. */
     if (matroska->cues_parsing_deferred > 0) {
         matroska->cues_parsing_deferred = 0;
-        matroska_parse_cues(matroska);
+        if (!matroska->lazy_cues || matroska_lazy_cues_init(matroska) < 0)
+            matroska_parse_cues(matroska);
     }
+    if (matroska->cues_blocks)
+        matroska_lazy_cues_seek(matroska, timestamp);
 
     if (!st->nb_index_entries)
         goto err;
@@ -3137,6 +3442,8 @@ static int matroska_read_close(AVFormatContext *s)
             av_freep(&tracks[n].audio.buf);
     ebml_free(matroska_cluster, &matroska->current_cluster);
     ebml_free(matroska_segment, matroska);
+    av_freep(&matroska->cues_blocks);
+    av_freep(&matroska->cues_buf);
 
     return 0;
 }
@@ -3420,6 +3727,8 @@ static int webm_dash_manifest_cues(AVFormatContext *s)
 
     // parse the cues
     matroska_parse_cues(matroska);
+    if (ff_flush_index_entries(s->streams[0]) < 0)
+        return -1;
 
     // cues start
     av_dict_set_int(&s->streams[0]->metadata, CUES_START, cues_start, 0);
@@ -3492,6 +3801,19 @@ static int webm_dash_manifest_read_packet(AVFormatContext *s, AVPacket *pkt)
 }
 
 #define OFFSET(x) offsetof(MatroskaDemuxContext, x)
+static const AVOption matroska_options[] = {
+    { "lazy_cues", "parse the index only around the seek targets", OFFSET(lazy_cues), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "cues_cache_size", "number of index blocks kept parsed with lazy_cues", OFFSET(cues_cache_size), AV_OPT_TYPE_INT, {.i64 = 16}, 2, INT_MAX / sizeof(MatroskaCuesBlock), AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 static const AVOption options[] = {
     { "live", "flag indicating that the input is a live file that only has the headers.", OFFSET(is_live), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
@@ -3514,7 +3836,8 @@ AVInputFormat ff_matroska_demuxer = {
     .read_packet    = matroska_read_packet,
     .read_close     = matroska_read_close,
     .read_seek      = matroska_read_seek,
-    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska"
+    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .priv_class     = &matroska_class,
 };
 
 AVInputFormat ff_webm_dash_manifest_demuxer = {
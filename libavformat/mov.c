@@ -4544,7 +4544,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->current_sample -= should_retry(sc->pb, ret64);
             return AVERROR_INVALIDDATA;
         }
-        ret = av_get_packet(sc->pb, pkt, sample->size);
+        /* the DV demuxer and AAX decryption work on the packet data */
+        if (mov->aax_mode || (mov->dv_demux && sc->dv_audio_container))
+            ret = av_get_packet(sc->pb, pkt, sample->size);
+        else
+            ret = ff_get_packet_ref(s, sc->pb, pkt, sample->size);
         if (ret < 0) {
             sc->current_sample -= should_retry(sc->pb, ret);
             return ret;
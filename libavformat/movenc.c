@@ -21,6 +21,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <fcntl.h>
 #include <stdint.h>
 #include <inttypes.h>
 
@@ -37,7 +38,9 @@
 #include "libavcodec/vc1_common.h"
 #include "libavcodec/raw.h"
 #include "internal.h"
+#include "os_support.h"
 #include "libavutil/avstring.h"
+#include "libavutil/internal.h"
 #include "libavutil/intfloat.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/libm.h"
@@ -50,6 +53,13 @@
 #include "rtpenc.h"
 #include "mov_chan.h"
 
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
 static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -68,6 +78,7 @@ static const AVOption options[] = {
     { "delay_moov", "Delay writing the initial moov until the first fragment is cut, or until the first fragment flush", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DELAY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "write_colr", "Write colr atom (Experimental, may be renamed or changed, do not use from scripts)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_WRITE_COLR}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "write_gama", "Write deprecated gama atom", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_WRITE_GAMA}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "faststart_tmpfile", "Like faststart, but write the file with the moov atom at the beginning to a temporary file and rename it over the output", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FASTSTART_TMPFILE}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     FF_RTP_FLAG_OPTS(MOVMuxContext, rtp_flags),
     { "skip_iods", "Skip writing iods atom.", offsetof(MOVMuxContext, iods_skip), AV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "iods_audio_profile", "iods audio profile atom.", offsetof(MOVMuxContext, iods_audio_profile), AV_OPT_TYPE_INT, {.i64 = -1}, -1, 255, AV_OPT_FLAG_ENCODING_PARAM},
@@ -4979,7 +4990,13 @@ static int mov_write_header(AVFormatContext *s)
         mov->flags |= FF_MOV_FLAG_FRAGMENT | FF_MOV_FLAG_EMPTY_MOOV |
                       FF_MOV_FLAG_DEFAULT_BASE_MOOF;
 
-    if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+    if (mov->flags & FF_MOV_FLAG_FASTSTART_TMPFILE)
+        mov->flags |= FF_MOV_FLAG_FASTSTART;
+
+    /* A reserved moov size is only an estimate with faststart; the data is
+     * shifted if the moov atom does not fit into it. */
+    if (mov->flags & FF_MOV_FLAG_FASTSTART &&
+        (mov->reserved_moov_size <= 0 || mov->flags & FF_MOV_FLAG_FRAGMENT)) {
         mov->reserved_moov_size = -1;
     }
 
@@ -5239,8 +5256,6 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
-            mov->reserved_moov_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
 
@@ -5334,13 +5349,14 @@ static int get_sidx_size(AVFormatContext *s)
     return ffio_close_null_buf(buf);
 }
 
-/*
+/**
  * This function gets the moov size if moved to the top of the file: the chunk
  * offset table can switch between stco (32-bit entries) to co64 (64-bit
  * entries) when the moov is moved to the beginning, so the size of the moov
- * would change. It also updates the chunk offset tables.
+ * would change. It also updates the chunk offset tables, moving them past the
+ * moov minus the reserved bytes at the top of the file the moov replaces.
  */
-static int compute_moov_size(AVFormatContext *s)
+static int compute_moov_size(AVFormatContext *s, int reserved)
 {
     int i, moov_size, moov_size2;
     MOVMuxContext *mov = s->priv_data;
@@ -5350,7 +5366,7 @@ static int compute_moov_size(AVFormatContext *s)
         return moov_size;
 
     for (i = 0; i < mov->nb_streams; i++)
-        mov->tracks[i].data_offset += moov_size;
+        mov->tracks[i].data_offset += moov_size - reserved;
 
     moov_size2 = get_moov_size(s);
     if (moov_size2 < 0)
@@ -5382,8 +5398,9 @@ static int compute_sidx_size(AVFormatContext *s)
 
 static int shift_data(AVFormatContext *s)
 {
-    int ret = 0, moov_size;
+    int ret = 0, moov_size, shift_size, buf_size;
     MOVMuxContext *mov = s->priv_data;
+    int reserved = FFMAX(mov->reserved_moov_size, 0);
     int64_t pos, pos_end = avio_tell(s->pb);
     uint8_t *buf, *read_buf[2];
     int read_buf_id = 0;
@@ -5393,15 +5410,19 @@ static int shift_data(AVFormatContext *s)
     if (mov->flags & FF_MOV_FLAG_FRAGMENT)
         moov_size = compute_sidx_size(s);
     else
-        moov_size = compute_moov_size(s);
+        moov_size = compute_moov_size(s, reserved);
     if (moov_size < 0)
         return moov_size;
+    shift_size = moov_size - reserved;
 
-    buf = av_malloc(moov_size * 2);
+    /* Any block size of at least the shift size works, as each block is
+     * only written once the following one has been read. */
+    buf_size = FFMAX(shift_size, 1 << 20);
+    buf = av_malloc(buf_size * 2);
     if (!buf)
         return AVERROR(ENOMEM);
     read_buf[0] = buf;
-    read_buf[1] = buf + moov_size;
+    read_buf[1] = buf + buf_size;
 
     /* Shift the data: the AVIO context of the output can only be used for
      * writing, so we re-open the same output, but for reading. It also avoids
@@ -5420,15 +5441,15 @@ static int shift_data(AVFormatContext *s)
     avio_seek(s->pb, mov->reserved_moov_pos + moov_size, SEEK_SET);
 
     /* start reading at where the new moov will be placed */
-    avio_seek(read_pb, mov->reserved_moov_pos, SEEK_SET);
+    avio_seek(read_pb, mov->reserved_moov_pos + reserved, SEEK_SET);
     pos = avio_tell(read_pb);
 
 #define READ_BLOCK do {                                                             \
-    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], moov_size);  \
+    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], buf_size);   \
     read_buf_id ^= 1;                                                               \
 } while (0)
 
-    /* shift data by chunk of at most moov_size */
+    /* shift data by chunk of at least shift_size */
     READ_BLOCK;
     do {
         int n;
@@ -5446,6 +5467,132 @@ end:
     return ret;
 }
 
+static int copy_file_data(int in, int out, int64_t pos, int64_t size)
+{
+    uint8_t *buf;
+    int ret = 0;
+
+#if HAVE_SENDFILE
+    /* let the kernel copy the data if it can */
+    off_t off = pos;
+    while (size > 0) {
+        ssize_t n = sendfile(out, in, &off, FFMIN(size, 1 << 30));
+        if (n <= 0)
+            break;
+        size -= n;
+    }
+    pos = off;
+    if (!size)
+        return 0;
+#endif
+
+    if (lseek(in, pos, SEEK_SET) < 0)
+        return AVERROR(errno);
+    buf = av_malloc(1 << 20);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    while (size > 0) {
+        int n = read(in, buf, FFMIN(size, 1 << 20)), done;
+        if (n <= 0) {
+            ret = n < 0 ? AVERROR(errno) : AVERROR_EOF;
+            break;
+        }
+        for (done = 0; done < n; ) {
+            int w = write(out, buf + done, n - done);
+            if (w < 0) {
+                ret = AVERROR(errno);
+                goto end;
+            }
+            done += w;
+        }
+        size -= n;
+    }
+end:
+    av_free(buf);
+    return ret;
+}
+
+/**
+ * Write the file with the moov atom in front of the media data to a
+ * temporary file and rename it over the output, instead of shifting the data
+ * within the output. On failure, the output is left untouched.
+ */
+static int write_moov_tmpfile(AVFormatContext *s, int64_t pos_end)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int reserved = FFMAX(mov->reserved_moov_size, 0);
+    const char *filename = s->filename;
+    const char *proto = avio_find_protocol_name(s->filename);
+    char *tmpname = NULL;
+    uint8_t *moov_buf = NULL;
+    AVIOContext *moov_pb;
+    int in = -1, out = -1, moov_size, shift_size, done, ret, i;
+
+    if (!proto || strcmp(proto, "file"))
+        return AVERROR(ENOSYS);
+    av_strstart(filename, "file:", &filename);
+
+    if ((ret = compute_moov_size(s, reserved)) < 0)
+        return ret;
+    shift_size = ret - reserved;
+    if ((ret = avio_open_dyn_buf(&moov_pb)) < 0)
+        goto end;
+    if ((ret = mov_write_moov_tag(moov_pb, mov, s)) < 0) {
+        ffio_free_dyn_buf(&moov_pb);
+        goto end;
+    }
+    moov_size = avio_close_dyn_buf(moov_pb, &moov_buf);
+
+    tmpname = av_asprintf("%s.tmp", filename);
+    if (!tmpname) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    avio_flush(s->pb);
+    in  = avpriv_open(filename, O_RDONLY);
+    out = avpriv_open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (in < 0 || out < 0) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+
+    if ((ret = copy_file_data(in, out, 0, mov->reserved_moov_pos)) < 0)
+        goto end;
+    for (done = 0; done < moov_size; ) {
+        int n = write(out, moov_buf + done, moov_size - done);
+        if (n < 0) {
+            ret = AVERROR(errno);
+            goto end;
+        }
+        done += n;
+    }
+    if ((ret = copy_file_data(in, out, mov->reserved_moov_pos + reserved,
+                              pos_end - mov->reserved_moov_pos - reserved)) < 0)
+        goto end;
+
+    close(in);
+    close(out);
+    in = out = -1;
+    if ((ret = ff_rename(tmpname, filename, s)) < 0)
+        unlink(tmpname);
+
+end:
+    if (in >= 0)
+        close(in);
+    if (out >= 0) {
+        close(out);
+        unlink(tmpname);
+    }
+    if (ret < 0) {
+        /* restore the offsets for the fallback */
+        for (i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset -= shift_size;
+    }
+    av_free(tmpname);
+    av_free(moov_buf);
+    return ret;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -5497,12 +5644,54 @@ static int mov_write_trailer(AVFormatContext *s)
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_moov_pos : moov_pos, SEEK_SET);
 
         if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-            av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
-            res = shift_data(s);
-            if (res == 0) {
-                avio_seek(pb, mov->reserved_moov_pos, SEEK_SET);
+            int moov_size = mov->reserved_moov_size > 0 ? get_moov_size(s) : -1;
+            if (moov_size >= 0 && (moov_size == mov->reserved_moov_size ||
+                                   moov_size + 8 <= mov->reserved_moov_size)) {
                 if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                     goto error;
+                if (moov_size < mov->reserved_moov_size) {
+                    avio_wb32(pb, mov->reserved_moov_size - moov_size);
+                    ffio_wfourcc(pb, "free");
+                    ffio_fill(pb, 0, mov->reserved_moov_size - moov_size - 8);
+                }
+                avio_seek(pb, moov_pos, SEEK_SET);
+            } else {
+                if (moov_size > mov->reserved_moov_size) {
+                    av_log(s, AV_LOG_WARNING, "reserved_moov_size is too small, "
+                           "needed %d, moving the data\n", moov_size);
+                } else if (moov_size >= 0) {
+                    /* The space left after the moov atom is too small for a
+                     * free atom. Turn the whole reserved space into one and
+                     * insert the moov atom in front of it, as without a
+                     * reservation. */
+                    av_log(s, AV_LOG_WARNING, "reserved_moov_size leaves %d bytes "
+                           "after the moov atom, moving the data\n",
+                           mov->reserved_moov_size - moov_size);
+                    avio_wb32(pb, mov->reserved_moov_size);
+                    ffio_wfourcc(pb, "free");
+                    ffio_fill(pb, 0, mov->reserved_moov_size - 8);
+                    mov->reserved_moov_size = 0;
+                }
+                res = AVERROR(ENOSYS);
+                if (mov->flags & FF_MOV_FLAG_FASTSTART_TMPFILE) {
+                    av_log(s, AV_LOG_INFO, "Writing the file with the moov atom at the beginning to a temporary file\n");
+                    res = write_moov_tmpfile(s, moov_pos);
+                    if (res == AVERROR(ENOSYS))
+                        av_log(s, AV_LOG_WARNING, "A temporary file can only be used for local files\n");
+                    else if (res < 0)
+                        av_log(s, AV_LOG_WARNING, "Writing the temporary file failed\n");
+                }
+                if (res < 0) {
+                    av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
+                    /* the data to shift ends where the moov atom would be */
+                    avio_seek(pb, moov_pos, SEEK_SET);
+                    res = shift_data(s);
+                    if (res == 0) {
+                        avio_seek(pb, mov->reserved_moov_pos, SEEK_SET);
+                        if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                            goto error;
+                    }
+                }
             }
         } else if (mov->reserved_moov_size > 0) {
             int64_t size;
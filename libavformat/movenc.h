@@ -211,6 +211,7 @@ typedef struct MOVMuxContext {
 #define FF_MOV_FLAG_DELAY_MOOV            (1 << 13)
 #define FF_MOV_FLAG_WRITE_COLR            (1 << 14)
 #define FF_MOV_FLAG_WRITE_GAMA            (1 << 15)
+#define FF_MOV_FLAG_FASTSTART_TMPFILE     (1 << 16)
 
 int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt);
 
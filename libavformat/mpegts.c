@@ -158,6 +158,16 @@ struct MpegTSContext {
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
     int current_pid;
+
+    /** discard_pid() results, 0 if unknown, 1 + result otherwise */
+    uint8_t discard_cache[NB_PID_MAX];
+    /** set when the program/pid mapping changed and discard_cache is stale */
+    int discard_cache_dirty;
+    /** true if at least one program has .discard=AVDISCARD_ALL */
+    int discard_any;
+    /** .discard == AVDISCARD_ALL of each AVProgram as seen by discard_cache */
+    uint8_t *discard_all;
+    int nb_discard_all;
 };
 
 #define MPEGTS_OPTIONS \
@@ -273,6 +283,7 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
 {
     int i;
 
+    ts->discard_cache_dirty = 1;
     clear_avprogram(ts, programid);
     for (i = 0; i < ts->nb_prg; i++)
         if (ts->prg[i].id == programid) {
@@ -285,6 +296,7 @@ static void clear_programs(MpegTSContext *ts)
 {
     av_freep(&ts->prg);
     ts->nb_prg = 0;
+    ts->discard_cache_dirty = 1;
 }
 
 static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
@@ -299,6 +311,7 @@ static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
     p->nb_pids = 0;
     p->pmt_found = 0;
     ts->nb_prg++;
+    ts->discard_cache_dirty = 1;
 }
 
 static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
@@ -317,6 +330,7 @@ static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
             return;
 
     p->pids[p->nb_pids++] = pid;
+    ts->discard_cache_dirty = 1;
 }
 
 static void set_pmt_found(MpegTSContext *ts, unsigned int programid)
@@ -355,12 +369,16 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
 
     /* If none of the programs have .discard=AVDISCARD_ALL then there's
      * no way we have to discard this packet */
-    for (k = 0; k < ts->stream->nb_programs; k++)
-        if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
-            break;
-    if (k == ts->stream->nb_programs)
+    if (!ts->discard_any)
         return 0;
 
+    if (ts->discard_cache_dirty) {
+        memset(ts->discard_cache, 0, sizeof(ts->discard_cache));
+        ts->discard_cache_dirty = 0;
+    }
+    if (ts->discard_cache[pid])
+        return ts->discard_cache[pid] - 1;
+
     for (i = 0; i < ts->nb_prg; i++) {
         p = &ts->prg[i];
         for (j = 0; j < p->nb_pids; j++) {
@@ -378,9 +396,40 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
         }
     }
 
+    ts->discard_cache[pid] = 1 + (!used && discarded);
     return !used && discarded;
 }
 
+/**
+ * Pick up changes of the caller's programs selection since the last call,
+ * must be called before handling packets from a new demuxing call.
+ */
+static void update_discard_cache(MpegTSContext *ts)
+{
+    AVFormatContext *s = ts->stream;
+    int i;
+
+    if (s->nb_programs != ts->nb_discard_all) {
+        ts->discard_cache_dirty = 1;
+        if (av_reallocp(&ts->discard_all, s->nb_programs) < 0) {
+            ts->nb_discard_all = 0;
+        } else {
+            ts->nb_discard_all = s->nb_programs;
+            memset(ts->discard_all, 0xff, s->nb_programs);
+        }
+    }
+
+    ts->discard_any = 0;
+    for (i = 0; i < s->nb_programs; i++) {
+        int all = s->programs[i]->discard == AVDISCARD_ALL;
+        if (i < ts->nb_discard_all && ts->discard_all[i] != all) {
+            ts->discard_all[i] = all;
+            ts->discard_cache_dirty = 1;
+        }
+        ts->discard_any |= all;
+    }
+}
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -2135,6 +2184,7 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
                 name = getstr8(&p, p_end);
                 if (name) {
                     AVProgram *program = av_new_program(ts->stream, sid);
+                    ts->discard_cache_dirty = 1;
                     if (program) {
                         av_dict_set(&program->metadata, "service_name", name, 0);
                         av_dict_set(&program->metadata, "service_provider",
@@ -2379,6 +2429,31 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Skip the packets already in the IO buffer that handle_packet() would
+ * ignore, i.e. those of discarded or unknown pids, without reading them
+ * one by one.
+ * @return the number of skipped packets
+ */
+static int skip_ignored_packets(MpegTSContext *ts, int64_t max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    uint8_t *p = pb->buf_ptr;
+    int nb_skipped = 0;
+
+    while (nb_skipped < max_packets &&
+           pb->buf_end - p >= ts->raw_packet_size && p[0] == 0x47) {
+        int pid = AV_RB16(p + 1) & 0x1fff;
+        if (!(pid && discard_pid(ts, pid)) &&
+            (ts->pids[pid] || (ts->auto_guess && p[1] & 0x40)))
+            break;
+        p += ts->raw_packet_size;
+        nb_skipped++;
+    }
+    pb->buf_ptr = p;
+    return nb_skipped;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
@@ -2407,10 +2482,14 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    update_discard_cache(ts);
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
     for (;;) {
+        int skipped;
+
         packet_num++;
         if (nb_packets != 0 && packet_num >= nb_packets ||
             ts->stop_parse > 1) {
@@ -2420,6 +2499,13 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        skipped = skip_ignored_packets(ts, nb_packets ? nb_packets - packet_num
+                                                      : INT_MAX);
+        if (skipped) {
+            packet_num += skipped - 1;
+            continue;
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -2682,6 +2768,7 @@ static void mpegts_free(MpegTSContext *ts)
     int i;
 
     clear_programs(ts);
+    av_freep(&ts->discard_all);
 
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
@@ -2791,6 +2878,7 @@ int avpriv_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
 
     len1 = len;
     ts->pkt = pkt;
+    update_discard_cache(ts);
     for (;;) {
         ts->stop_parse = 0;
         if (len < TS_PACKET_SIZE)
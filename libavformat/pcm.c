@@ -34,7 +34,7 @@ int ff_pcm_read_packet(AVFormatContext *s, AVPacket *pkt)
     if (size <= 0)
         return AVERROR(EINVAL);
 
-    ret= av_get_packet(s->pb, pkt, size);
+    ret= ff_get_packet_ref(s, s->pb, pkt, size);
 
     pkt->flags &= ~AV_PKT_FLAG_CORRUPT;
     pkt->stream_index = 0;
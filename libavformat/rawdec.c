@@ -30,6 +30,9 @@
 #include "libavutil/avassert.h"
 #include "libavutil/intreadwrite.h"
 
+/* Such packets are too small compared to the IO buffer for
+ * av_get_packet_ref(), and are merged into frames by the parsers anyway,
+ * so they are read with a copy. */
 #define RAW_PACKET_SIZE 1024
 
 int ff_raw_read_partial_packet(AVFormatContext *s, AVPacket *pkt)
@@ -20,13 +20,26 @@
  */
 
 
+#include "config.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#include "libavutil/threadmessage.h"
 #include "avformat.h"
 
 #define MAX_SLAVES 16
 
+enum OnFull {
+    ON_FULL_BLOCK,
+    ON_FULL_DROP,
+    ON_FULL_DISCONNECT,
+};
+
 typedef struct {
     AVFormatContext *avf;
     AVBitStreamFilterContext **bsfs; ///< bitstream filters per stream
@@ -34,6 +47,18 @@ typedef struct {
     /** map from input to output streams indexes,
      * disabled output streams are set to -1 */
     int *stream_map;
+
+    int queue_size;         ///< packets queued for the slave thread, 0 to write synchronously
+    enum OnFull on_full;    ///< what to do with a packet when the queue is full
+    uint8_t *skip_to_key;   ///< per output stream, drop packets until the next keyframe
+    int disconnected;
+    AVThreadMessageQueue *queue;
+#if HAVE_PTHREADS
+    pthread_t thread;
+    int thread_started;
+    int thread_ret;
+    volatile int abort_request;
+#endif
 } TeeSlave;
 
 typedef struct TeeContext {
@@ -48,6 +73,12 @@ static const char *const slave_opt_close = "]";
 static const char *const slave_opt_delim = ":]"; /* must have the close too */
 static const char *const slave_bsfs_spec_sep = "/";
 
+static const char *const on_full_names[] = {
+    [ON_FULL_BLOCK]      = "block",
+    [ON_FULL_DROP]       = "drop",
+    [ON_FULL_DISCONNECT] = "disconnect",
+};
+
 static const AVClass tee_muxer_class = {
     .class_name = "Tee muxer",
     .item_name  = av_default_item_name,
@@ -132,6 +163,47 @@ end:
     return ret;
 }
 
+#if HAVE_PTHREADS
+static int slave_interrupt_cb(void *opaque)
+{
+    TeeSlave *tee_slave = opaque;
+    return tee_slave->abort_request;
+}
+#endif
+
+static int parse_queue_options(void *log, TeeSlave *tee_slave,
+                               const char *queue_size, const char *on_full)
+{
+    int i;
+
+    if (queue_size) {
+        char *end;
+        long size = strtol(queue_size, &end, 10);
+        if (*end || size < 0 || size > INT_MAX / sizeof(AVPacket)) {
+            av_log(log, AV_LOG_ERROR, "Invalid queue size '%s'\n", queue_size);
+            return AVERROR(EINVAL);
+        }
+        tee_slave->queue_size = size;
+    }
+    if (on_full) {
+        for (i = 0; i < FF_ARRAY_ELEMS(on_full_names); i++)
+            if (!strcmp(on_full, on_full_names[i]))
+                break;
+        if (i == FF_ARRAY_ELEMS(on_full_names)) {
+            av_log(log, AV_LOG_ERROR, "Invalid onfull value '%s'\n", on_full);
+            return AVERROR(EINVAL);
+        }
+        tee_slave->on_full = i;
+    }
+#if !HAVE_PTHREADS
+    if (tee_slave->queue_size) {
+        av_log(log, AV_LOG_ERROR, "Slave threads are not supported in this build\n");
+        return AVERROR(ENOSYS);
+    }
+#endif
+    return 0;
+}
+
 static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 {
     int i, ret;
@@ -139,6 +211,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     AVDictionaryEntry *entry;
     char *filename;
     char *format = NULL, *select = NULL;
+    char *queue_size = NULL, *on_full = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
     int stream_count;
@@ -156,11 +229,23 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 
     STEAL_OPTION("f", format);
     STEAL_OPTION("select", select);
+    STEAL_OPTION("queue_size", queue_size);
+    STEAL_OPTION("onfull", on_full);
+
+    if ((ret = parse_queue_options(avf, tee_slave, queue_size, on_full)) < 0)
+        goto end;
 
     ret = avformat_alloc_output_context2(&avf2, NULL, format, filename);
     if (ret < 0)
         goto end;
     av_dict_copy(&avf2->metadata, avf->metadata, 0);
+#if HAVE_PTHREADS
+    if (tee_slave->queue_size) {
+        /* lets a disconnected slave give up on blocking I/O */
+        avf2->interrupt_callback.callback = slave_interrupt_cb;
+        avf2->interrupt_callback.opaque   = tee_slave;
+    }
+#endif
 
     tee_slave->stream_map = av_calloc(avf->nb_streams, sizeof(*tee_slave->stream_map));
     if (!tee_slave->stream_map) {
@@ -206,7 +291,8 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     }
 
     if (!(avf2->oformat->flags & AVFMT_NOFILE)) {
-        if ((ret = avio_open(&avf2->pb, filename, AVIO_FLAG_WRITE)) < 0) {
+        if ((ret = avio_open2(&avf2->pb, filename, AVIO_FLAG_WRITE,
+                              &avf2->interrupt_callback, NULL)) < 0) {
             av_log(avf, AV_LOG_ERROR, "Slave '%s': error opening: %s\n",
                    slave, av_err2str(ret));
             goto end;
@@ -278,13 +364,47 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
         goto end;
     }
 
+    if (tee_slave->queue_size) {
+        ret = av_thread_message_queue_alloc(&tee_slave->queue, tee_slave->queue_size,
+                                            sizeof(AVPacket));
+        if (ret < 0)
+            goto end;
+        if (tee_slave->on_full == ON_FULL_DROP) {
+            tee_slave->skip_to_key = av_mallocz(avf2->nb_streams);
+            if (!tee_slave->skip_to_key) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+        }
+    }
+
 end:
     av_free(format);
     av_free(select);
+    av_free(queue_size);
+    av_free(on_full);
     av_dict_free(&options);
     return ret;
 }
 
+static void stop_slave_thread(TeeSlave *tee_slave)
+{
+    AVPacket pkt;
+
+    if (!tee_slave->queue)
+        return;
+#if HAVE_PTHREADS
+    if (tee_slave->thread_started) {
+        av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EOF);
+        pthread_join(tee_slave->thread, NULL);
+        tee_slave->thread_started = 0;
+    }
+#endif
+    while (av_thread_message_queue_recv(tee_slave->queue, &pkt,
+                                        AV_THREAD_MESSAGE_NONBLOCK) >= 0)
+        av_packet_unref(&pkt);
+}
+
 static void close_slaves(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -292,6 +412,9 @@ static void close_slaves(AVFormatContext *avf)
     unsigned i, j;
 
     for (i = 0; i < tee->nb_slaves; i++) {
+        stop_slave_thread(&tee->slaves[i]);
+        av_thread_message_queue_free(&tee->slaves[i].queue);
+        av_freep(&tee->slaves[i].skip_to_key);
         avf2 = tee->slaves[i].avf;
 
         for (j = 0; j < avf2->nb_streams; j++) {
@@ -333,8 +456,110 @@ static void log_slave(TeeSlave *slave, void *log_ctx, int log_level)
         }
         av_log(log_ctx, log_level, "\n");
     }
+    if (slave->queue_size)
+        av_log(log_ctx, log_level, "    queue_size:%d onfull:%s\n",
+               slave->queue_size, on_full_names[slave->on_full]);
 }
 
+static int filter_packet(void *log_ctx, AVPacket *pkt,
+                         AVFormatContext *fmt_ctx, AVBitStreamFilterContext *bsf_ctx);
+
+static int write_slave_packet(TeeSlave *tee_slave, AVPacket *pkt)
+{
+    AVFormatContext *avf2 = tee_slave->avf;
+
+    filter_packet(avf2, pkt, avf2, tee_slave->bsfs[pkt->stream_index]);
+    return av_interleaved_write_frame(avf2, pkt);
+}
+
+#if HAVE_PTHREADS
+static void *slave_thread(void *arg)
+{
+    TeeSlave *tee_slave = arg;
+    AVPacket pkt;
+    int ret = 0;
+
+    while (!tee_slave->abort_request) {
+        if ((ret = av_thread_message_queue_recv(tee_slave->queue, &pkt, 0)) < 0)
+            break;
+        if ((ret = write_slave_packet(tee_slave, &pkt)) < 0) {
+            /* the next send on the queue will report the error */
+            av_thread_message_queue_set_err_send(tee_slave->queue, ret);
+            break;
+        }
+    }
+    tee_slave->thread_ret = ret == AVERROR_EOF ? 0 : ret;
+    return NULL;
+}
+
+static int start_slave_thread(void *log_ctx, TeeSlave *tee_slave)
+{
+    int ret = pthread_create(&tee_slave->thread, NULL, slave_thread, tee_slave);
+    if (ret) {
+        av_log(log_ctx, AV_LOG_ERROR, "Slave '%s': pthread_create failed: %s\n",
+               tee_slave->avf->filename, av_err2str(AVERROR(ret)));
+        return AVERROR(ret);
+    }
+    tee_slave->thread_started = 1;
+    return 0;
+}
+
+static void disconnect_slave(void *log_ctx, TeeSlave *tee_slave, const char *reason)
+{
+    av_log(log_ctx, AV_LOG_ERROR, "Slave '%s': %s, disconnecting\n",
+           tee_slave->avf->filename, reason);
+    tee_slave->disconnected  = 1;
+    tee_slave->abort_request = 1;
+    av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EXIT);
+}
+
+/**
+ * Hand a packet over to the slave thread, applying the overflow policy
+ * of the slave if its queue is full. Takes ownership of the packet.
+ */
+static int queue_slave_packet(void *log_ctx, TeeSlave *tee_slave, AVPacket *pkt)
+{
+    int key = pkt->flags & AV_PKT_FLAG_KEY;
+    int ret, flags = 0;
+
+    if (tee_slave->on_full == ON_FULL_DROP) {
+        /* a stream with a dropped packet resumes on its next keyframe */
+        if (key)
+            tee_slave->skip_to_key[pkt->stream_index] = 0;
+        else if (tee_slave->skip_to_key[pkt->stream_index])
+            goto discard;
+        flags = AV_THREAD_MESSAGE_NONBLOCK;
+    } else if (tee_slave->on_full == ON_FULL_DISCONNECT) {
+        flags = AV_THREAD_MESSAGE_NONBLOCK;
+    }
+
+    ret = av_thread_message_queue_send(tee_slave->queue, pkt, flags);
+    if (ret == AVERROR(EAGAIN)) {
+        if (tee_slave->on_full == ON_FULL_DROP) {
+            av_log(log_ctx, AV_LOG_VERBOSE, "Slave '%s': queue full, dropping "
+                   "stream %d until the next keyframe\n",
+                   tee_slave->avf->filename, pkt->stream_index);
+            tee_slave->skip_to_key[pkt->stream_index] = 1;
+        } else {
+            disconnect_slave(log_ctx, tee_slave, "queue full");
+        }
+        goto discard;
+    } else if (ret < 0) {
+        if (tee_slave->on_full == ON_FULL_DISCONNECT) {
+            disconnect_slave(log_ctx, tee_slave, av_err2str(ret));
+            ret = 0;
+        }
+        av_packet_unref(pkt);
+        return ret;
+    }
+    return 0;
+
+discard:
+    av_packet_unref(pkt);
+    return 0;
+}
+#endif
+
 static int tee_write_header(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -367,6 +592,13 @@ static int tee_write_header(AVFormatContext *avf)
 
     tee->nb_slaves = nb_slaves;
 
+#if HAVE_PTHREADS
+    for (i = 0; i < nb_slaves; i++)
+        if (tee->slaves[i].queue_size &&
+            (ret = start_slave_thread(avf, &tee->slaves[i])) < 0)
+            goto fail;
+#endif
+
     for (i = 0; i < avf->nb_streams; i++) {
         int j, mapped = 0;
         for (j = 0; j < tee->nb_slaves; j++)
@@ -431,8 +663,18 @@ static int tee_write_trailer(AVFormatContext *avf)
     unsigned i;
 
     for (i = 0; i < tee->nb_slaves; i++) {
-        avf2 = tee->slaves[i].avf;
-        if ((ret = av_write_trailer(avf2)) < 0)
+        TeeSlave *tee_slave = &tee->slaves[i];
+        avf2 = tee_slave->avf;
+        stop_slave_thread(tee_slave);
+#if HAVE_PTHREADS
+        if (tee_slave->thread_ret < 0 && !tee_slave->disconnected) {
+            if (tee_slave->on_full == ON_FULL_DISCONNECT)
+                disconnect_slave(avf, tee_slave, av_err2str(tee_slave->thread_ret));
+            else if (!ret_all)
+                ret_all = tee_slave->thread_ret;
+        }
+#endif
+        if (!tee_slave->disconnected && (ret = av_write_trailer(avf2)) < 0)
             if (!ret_all)
                 ret_all = ret;
         if (!(avf2->oformat->flags & AVFMT_NOFILE)) {
@@ -459,7 +701,7 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
         avf2 = tee->slaves[i].avf;
         s = pkt->stream_index;
         s2 = tee->slaves[i].stream_map[s];
-        if (s2 < 0)
+        if (s2 < 0 || tee->slaves[i].disconnected)
             continue;
 
         if ((ret = av_copy_packet(&pkt2, pkt)) < 0 ||
@@ -475,8 +717,13 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
         pkt2.duration = av_rescale_q(pkt->duration, tb, tb2);
         pkt2.stream_index = s2;
 
-        filter_packet(avf2, &pkt2, avf2, tee->slaves[i].bsfs[s2]);
-        if ((ret = av_interleaved_write_frame(avf2, &pkt2)) < 0)
+#if HAVE_PTHREADS
+        if (tee->slaves[i].queue)
+            ret = queue_slave_packet(avf, &tee->slaves[i], &pkt2);
+        else
+#endif
+            ret = write_slave_packet(&tee->slaves[i], &pkt2);
+        if (ret < 0)
             if (!ret_all)
                 ret_all = ret;
     }
@@ -24,6 +24,10 @@
 
 #include "config.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/dict.h"
@@ -248,6 +252,50 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+int av_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    AVBufferRef *buf;
+    int64_t pos;
+
+    if (size <= 0)
+        return av_get_packet(s, pkt, size);
+
+    pos = avio_tell(s);
+    buf = ffio_read_ref(s, size);
+    if (!buf)
+        return av_get_packet(s, pkt, size);
+
+    av_init_packet(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
+int ff_get_packet_ref(AVFormatContext *s, AVIOContext *pb, AVPacket *pkt, int size)
+{
+    if (!(s->flags & AVFMT_FLAG_ZERO_COPY))
+        return av_get_packet(pb, pkt, size);
+    return av_get_packet_ref(pb, pkt, size);
+}
+
+/* Give a packet which may reference the IO buffer its own copy of the data,
+ * with zeroed padding. */
+static int copy_packet_data_padded(AVPacket *pkt)
+{
+    AVBufferRef *buf = av_buffer_alloc(pkt->size + AV_INPUT_BUFFER_PADDING_SIZE);
+
+    if (!buf)
+        return AVERROR(ENOMEM);
+    memcpy(buf->data, pkt->data, pkt->size);
+    memset(buf->data + pkt->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    av_buffer_unref(&pkt->buf);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    return 0;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -399,6 +447,18 @@ int avformat_queue_attached_pictures(AVFormatContext *s)
     return 0;
 }
 
+/* Merge the index entries collected by ff_add_index_entry_deferred(), so
+ * that st->index_entries is complete whenever the caller gets control. */
+static int flush_index_entries(AVFormatContext *s)
+{
+    int i, ret;
+
+    for (i = 0; i < s->nb_streams; i++)
+        if ((ret = ff_flush_index_entries(s->streams[i])) < 0)
+            return ret;
+    return 0;
+}
+
 int avformat_open_input(AVFormatContext **ps, const char *filename,
                         AVInputFormat *fmt, AVDictionary **options)
 {
@@ -480,6 +540,9 @@ int avformat_open_input(AVFormatContext **ps, const char *filename,
     }
     ff_id3v2_free_extra_meta(&id3v2_extra_meta);
 
+    if ((ret = flush_index_entries(s)) < 0)
+        goto fail;
+
     if ((ret = avformat_queue_attached_pictures(s)) < 0)
         goto fail;
 
@@ -1380,11 +1443,18 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
             if ((s->iformat->flags & AVFMT_GENERIC_INDEX) &&
                 (pkt->flags & AV_PKT_FLAG_KEY) && pkt->dts != AV_NOPTS_VALUE) {
                 ff_reduce_index(s, st->index);
-                av_add_index_entry(st, pkt->pos, pkt->dts,
-                                   0, 0, AVINDEX_KEYFRAME);
+                ff_add_index_entry_deferred(st, pkt->pos, pkt->dts,
+                                            0, 0, AVINDEX_KEYFRAME);
             }
             got_packet = 1;
         } else if (st->discard < AVDISCARD_ALL) {
+            /* parsers read the padding, which is not zeroed in packets
+             * referencing the IO buffer */
+            if (s->flags & AVFMT_FLAG_ZERO_COPY && cur_pkt.buf &&
+                (ret = copy_packet_data_padded(&cur_pkt)) < 0) {
+                av_free_packet(&cur_pkt);
+                return ret;
+            }
             if ((ret = parse_packet(s, &cur_pkt, cur_pkt.stream_index)) < 0)
                 return ret;
         } else {
@@ -1476,7 +1546,7 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
 {
     const int genpts = s->flags & AVFMT_FLAG_GENPTS;
     int eof = 0;
-    int ret;
+    int ret, err;
     AVStream *st;
 
     if (!genpts) {
@@ -1485,7 +1555,7 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
                                         &s->internal->packet_buffer_end, pkt)
               : read_frame_internal(s, pkt);
         if (ret < 0)
-            return ret;
+            goto end;
         goto return_packet;
     }
 
@@ -1541,12 +1611,14 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
                 eof = 1;
                 continue;
             } else
-                return ret;
+                goto end;
         }
 
         if (av_dup_packet(add_to_pktbuf(&s->internal->packet_buffer, pkt,
-                                        &s->internal->packet_buffer_end)) < 0)
-            return AVERROR(ENOMEM);
+                                        &s->internal->packet_buffer_end)) < 0) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
     }
 
 return_packet:
@@ -1554,7 +1626,7 @@ return_packet:
     st = s->streams[pkt->stream_index];
     if ((s->iformat->flags & AVFMT_GENERIC_INDEX) && pkt->flags & AV_PKT_FLAG_KEY) {
         ff_reduce_index(s, st->index);
-        av_add_index_entry(st, pkt->pos, pkt->dts, 0, 0, AVINDEX_KEYFRAME);
+        ff_add_index_entry_deferred(st, pkt->pos, pkt->dts, 0, 0, AVINDEX_KEYFRAME);
     }
 
     if (is_relative(pkt->dts))
@@ -1562,6 +1634,12 @@ return_packet:
     if (is_relative(pkt->pts))
         pkt->pts -= RELATIVE_TS_BASE;
 
+end:
+    if ((err = flush_index_entries(s)) < 0) {
+        if (ret >= 0)
+            av_free_packet(pkt);
+        ret = err;
+    }
     return ret;
 }
 
@@ -1672,6 +1750,8 @@ void ff_reduce_index(AVFormatContext *s, int stream_index)
     AVStream *st             = s->streams[stream_index];
     unsigned int max_entries = s->max_index_size / sizeof(AVIndexEntry);
 
+    ff_flush_index_entries(st);
+
     if ((unsigned) st->nb_index_entries >= max_entries) {
         int i;
         for (i = 0; 2 * i < st->nb_index_entries; i++)
@@ -1742,12 +1822,78 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
 int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
                        int size, int distance, int flags)
 {
+    int ret = ff_flush_index_entries(st);
+    if (ret < 0)
+        return ret;
+
     timestamp = wrap_timestamp(st, timestamp);
     return ff_add_index_entry(&st->index_entries, &st->nb_index_entries,
                               &st->index_entries_allocated_size, pos,
                               timestamp, size, distance, flags);
 }
 
+int ff_add_index_entry_deferred(AVStream *st, int64_t pos, int64_t timestamp,
+                                int size, int distance, int flags)
+{
+    int n = st->nb_index_entries, index, ret;
+    int64_t ts;
+
+    timestamp = wrap_timestamp(st, timestamp);
+    ts        = is_relative(timestamp) ? timestamp - RELATIVE_TS_BASE : timestamp;
+
+    if (timestamp != AV_NOPTS_VALUE && n &&
+        ts < st->index_entries[n - 1].timestamp) {
+        index = ff_index_search_timestamp(st->index_entries, n, ts,
+                                          AVSEEK_FLAG_ANY);
+        if (st->index_entries[index].timestamp != ts) {
+            ret = ff_add_index_entry(&st->pending_index_entries,
+                                     &st->nb_pending_index_entries,
+                                     &st->pending_index_entries_allocated_size,
+                                     pos, timestamp, size, distance, flags);
+            /* Keeping about sqrt(n) entries aside balances the cost of
+             * inserting into them against the cost of merging. */
+            if (ret >= 0 && (int64_t)st->nb_pending_index_entries *
+                            st->nb_pending_index_entries > n)
+                ret = ff_flush_index_entries(st);
+            return ret;
+        }
+    }
+
+    return ff_add_index_entry(&st->index_entries, &st->nb_index_entries,
+                              &st->index_entries_allocated_size, pos,
+                              timestamp, size, distance, flags);
+}
+
+int ff_flush_index_entries(AVStream *st)
+{
+    AVIndexEntry *pending = st->pending_index_entries, *entries;
+    int i = st->nb_index_entries, j = st->nb_pending_index_entries, k;
+
+    if (!j)
+        return 0;
+
+    if ((unsigned) i + j >= UINT_MAX / sizeof(AVIndexEntry))
+        return AVERROR(ENOMEM);
+    entries = av_fast_realloc(st->index_entries,
+                              &st->index_entries_allocated_size,
+                              (i + j) * sizeof(AVIndexEntry));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    st->index_entries            = entries;
+    st->nb_index_entries        += j;
+    st->nb_pending_index_entries = 0;
+
+    /* Merge from the end, the timestamps of both arrays are distinct. */
+    for (k = i + j - 1; j > 0; k--) {
+        if (i > 0 && entries[i - 1].timestamp > pending[j - 1].timestamp)
+            entries[k] = entries[--i];
+        else
+            entries[k] = pending[--j];
+    }
+
+    return 0;
+}
+
 int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
                               int64_t wanted_timestamp, int flags)
 {
@@ -1799,6 +1945,9 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
     if (proto && !(strcmp(proto, "file") && strcmp(proto, "pipe") && strcmp(proto, "cache")))
         return;
 
+    if (flush_index_entries(s) < 0)
+        return;
+
     for (ist1 = 0; ist1 < s->nb_streams; ist1++) {
         AVStream *st1 = s->streams[ist1];
         for (ist2 = 0; ist2 < s->nb_streams; ist2++) {
@@ -1840,6 +1989,10 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
 
 int av_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
 {
+    int ret = ff_flush_index_entries(st);
+    if (ret < 0)
+        return ret;
+
     return ff_index_search_timestamp(st->index_entries, st->nb_index_entries,
                                      wanted_timestamp, flags);
 }
@@ -2155,6 +2308,9 @@ static int seek_frame_internal(AVFormatContext *s, int stream_index,
     int ret;
     AVStream *st;
 
+    if ((ret = flush_index_entries(s)) < 0)
+        return ret;
+
     if (flags & AVSEEK_FLAG_BYTE) {
         if (s->iformat->flags & AVFMT_NO_BYTE_SEEK)
             return -1;
@@ -2196,7 +2352,7 @@ static int seek_frame_internal(AVFormatContext *s, int stream_index,
 int av_seek_frame(AVFormatContext *s, int stream_index,
                   int64_t timestamp, int flags)
 {
-    int ret;
+    int ret, err;
 
     if (s->iformat->read_seek2 && !s->iformat->read_seek) {
         int64_t min_ts = INT64_MIN, max_ts = INT64_MAX;
@@ -2210,6 +2366,10 @@ int av_seek_frame(AVFormatContext *s, int stream_index,
 
     ret = seek_frame_internal(s, stream_index, timestamp, flags);
 
+    /* seeking may have read packets and collected index entries */
+    if ((err = flush_index_entries(s)) < 0)
+        return err;
+
     if (ret >= 0)
         ret = avformat_queue_attached_pictures(s);
 
@@ -2219,6 +2379,8 @@ int av_seek_frame(AVFormatContext *s, int stream_index,
 int avformat_seek_file(AVFormatContext *s, int stream_index, int64_t min_ts,
                        int64_t ts, int64_t max_ts, int flags)
 {
+    int ret, err;
+
     if (min_ts > ts || max_ts < ts)
         return -1;
     if (stream_index < -1 || stream_index >= (int)s->nb_streams)
@@ -2228,8 +2390,10 @@ int avformat_seek_file(AVFormatContext *s, int stream_index, int64_t min_ts,
         flags |= AVSEEK_FLAG_ANY;
     flags &= ~AVSEEK_FLAG_BACKWARD;
 
+    if ((ret = flush_index_entries(s)) < 0)
+        return ret;
+
     if (s->iformat->read_seek2) {
-        int ret;
         ff_read_frame_flush(s);
 
         if (stream_index == -1 && s->nb_streams == 1) {
@@ -2246,6 +2410,9 @@ int avformat_seek_file(AVFormatContext *s, int stream_index, int64_t min_ts,
         ret = s->iformat->read_seek2(s, stream_index, min_ts,
                                      ts, max_ts, flags);
 
+        if ((err = flush_index_entries(s)) < 0)
+            return err;
+
         if (ret >= 0)
             ret = avformat_queue_attached_pictures(s);
         return ret;
@@ -2259,7 +2426,7 @@ int avformat_seek_file(AVFormatContext *s, int stream_index, int64_t min_ts,
     // Note the old API has somewhat different semantics.
     if (s->iformat->read_seek || 1) {
         int dir = (ts - (uint64_t)min_ts > (uint64_t)max_ts - ts ? AVSEEK_FLAG_BACKWARD : 0);
-        int ret = av_seek_frame(s, stream_index, ts, flags | dir);
+        ret = av_seek_frame(s, stream_index, ts, flags | dir);
         if (ret<0 && ts != min_ts && max_ts != ts) {
             ret = av_seek_frame(s, stream_index, dir ? max_ts : min_ts, flags | dir);
             if (ret >= 0)
@@ -2671,18 +2838,13 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     return 1;
 }
 
-/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
-static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
-                            AVDictionary **options)
+/* Open the decoder of st for probing if it was not tried yet,
+ * returns a negative error if no decoder could be opened */
+static int open_probe_decoder(AVFormatContext *s, AVStream *st,
+                              AVDictionary **options)
 {
     const AVCodec *codec;
-    int got_picture = 1, ret = 0;
-    AVFrame *frame = av_frame_alloc();
-    AVSubtitle subtitle;
-    AVPacket pkt = *avpkt;
-
-    if (!frame)
-        return AVERROR(ENOMEM);
+    int ret;
 
     if (!avcodec_is_open(st->codec) &&
         st->info->found_decoder <= 0 &&
@@ -2693,8 +2855,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
 
         if (!codec) {
             st->info->found_decoder = -st->codec->codec_id;
-            ret                     = -1;
-            goto fail;
+            return -1;
         }
 
         /* Force thread count to 1 since the H.264 decoder will not extract
@@ -2707,16 +2868,29 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
             av_dict_free(&thread_opt);
         if (ret < 0) {
             st->info->found_decoder = -st->codec->codec_id;
-            goto fail;
+            return ret;
         }
         st->info->found_decoder = 1;
     } else if (!st->info->found_decoder)
         st->info->found_decoder = 1;
 
-    if (st->info->found_decoder < 0) {
-        ret = -1;
-        goto fail;
-    }
+    return st->info->found_decoder < 0 ? -1 : 0;
+}
+
+/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
+static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
+                            AVDictionary **options)
+{
+    int got_picture = 1, ret = 0;
+    AVFrame *frame;
+    AVSubtitle subtitle;
+    AVPacket pkt = *avpkt;
+
+    if ((ret = open_probe_decoder(s, st, options)) < 0)
+        return ret;
+
+    if (!(frame = av_frame_alloc()))
+        return AVERROR(ENOMEM);
 
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
            ret >= 0 &&
@@ -2752,7 +2926,6 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
     if (!pkt.data && !got_picture)
         ret = -1;
 
-fail:
     av_frame_free(&frame);
     return ret;
 }
@@ -3078,9 +3251,240 @@ void ff_rfps_calculate(AVFormatContext *ic)
     }
 }
 
+#if HAVE_PTHREADS
+/* Decoding of the probed packets on worker threads, see probe_threads.
+ * The packets are still read and accounted for on the calling thread, but
+ * their decoding is deferred and done in batches, one stream at a time per
+ * thread so that each decoder sees its packets in order. The calling thread
+ * takes part in the batch and waits for it to complete before reading
+ * again, so that the demuxer, the parsers and the decoders never access a
+ * codec context concurrently. */
+
+#define PROBE_BATCH_PER_THREAD 4
+
+typedef struct ProbeJob {
+    AVPacket *pkt;
+    int nb_frames;  ///< codec_info_nb_frames of the stream when the packet was read
+} ProbeJob;
+
+typedef struct ProbeStream {
+    ProbeJob *jobs;
+    int nb_jobs;
+    unsigned int jobs_size;
+} ProbeStream;
+
+typedef struct ProbeThreads {
+    AVFormatContext *ic;
+    AVDictionary **options;
+    int orig_nb_streams;
+    ProbeStream *streams;
+    int nb_streams;
+    int nb_jobs;
+
+    pthread_t *threads;
+    int nb_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    int batch_size;     ///< number of streams in the running batch
+    int next_stream;    ///< next stream of the batch to decode
+    int nb_done;        ///< streams of the batch decoded so far
+    int exit;
+} ProbeThreads;
+
+static void probe_decode_stream(ProbeThreads *pt, int index)
+{
+    AVStream *st       = pt->ic->streams[index];
+    ProbeStream *ps    = &pt->streams[index];
+    int nb_frames      = st->codec_info_nb_frames;
+    AVDictionary **opt = pt->options && index < pt->orig_nb_streams ?
+                         &pt->options[index] : NULL;
+    int i;
+
+    for (i = 0; i < ps->nb_jobs; i++) {
+        int64_t t = av_gettime_relative();
+        /* decode as if the packet had just been read */
+        st->codec_info_nb_frames = ps->jobs[i].nb_frames;
+        try_decode_frame(pt->ic, st, ps->jobs[i].pkt, opt);
+        st->info->probe_decode_time += av_gettime_relative() - t;
+    }
+    st->codec_info_nb_frames = nb_frames;
+    ps->nb_jobs = 0;
+}
+
+/* Called with the mutex locked and a stream left in the batch. */
+static void probe_run_next(ProbeThreads *pt)
+{
+    int index = pt->next_stream++;
+
+    if (pt->streams[index].nb_jobs) {
+        pthread_mutex_unlock(&pt->mutex);
+        probe_decode_stream(pt, index);
+        pthread_mutex_lock(&pt->mutex);
+    }
+    if (++pt->nb_done == pt->batch_size)
+        pthread_cond_signal(&pt->done_cond);
+}
+
+static void *probe_worker(void *arg)
+{
+    ProbeThreads *pt = arg;
+
+    pthread_mutex_lock(&pt->mutex);
+    while (!pt->exit) {
+        if (pt->next_stream < pt->batch_size)
+            probe_run_next(pt);
+        else
+            pthread_cond_wait(&pt->work_cond, &pt->mutex);
+    }
+    pthread_mutex_unlock(&pt->mutex);
+    return NULL;
+}
+
+static void probe_threads_flush(ProbeThreads *pt)
+{
+    if (!pt->nb_jobs)
+        return;
+
+    pthread_mutex_lock(&pt->mutex);
+    pt->batch_size  = pt->nb_streams;
+    pt->next_stream = 0;
+    pt->nb_done     = 0;
+    pthread_cond_broadcast(&pt->work_cond);
+    while (pt->next_stream < pt->batch_size)
+        probe_run_next(pt);
+    while (pt->nb_done < pt->batch_size)
+        pthread_cond_wait(&pt->done_cond, &pt->mutex);
+    pt->batch_size = pt->next_stream = 0;
+    pthread_mutex_unlock(&pt->mutex);
+    pt->nb_jobs = 0;
+}
+
+/* Whether every stream still lacking parameters has a packet to decode, so
+ * that waiting for more packets would only read more than needed. */
+static int probe_threads_all_pending(ProbeThreads *pt)
+{
+    int i;
+
+    for (i = 0; i < pt->ic->nb_streams; i++) {
+        AVStream *st = pt->ic->streams[i];
+        if (st->info->found_decoder >= 0 && !has_codec_parameters(st, NULL) &&
+            (i >= pt->nb_streams || !pt->streams[i].nb_jobs))
+            return 0;
+    }
+    return 1;
+}
+
+static int probe_threads_add(ProbeThreads *pt, AVStream *st, AVPacket *pkt)
+{
+    ProbeStream *ps;
+    ProbeJob *jobs;
+
+    /* Opening a decoder is not thread safe without a lock manager, so it
+     * is done here rather than on a worker. On failure, decoding the
+     * packet later fails right away, as without probe threads. */
+    open_probe_decoder(pt->ic, st,
+                       pt->options && st->index < pt->orig_nb_streams ?
+                       &pt->options[st->index] : NULL);
+
+    if (st->index >= pt->nb_streams) {
+        ProbeStream *streams = av_realloc_array(pt->streams, st->index + 1,
+                                                sizeof(*streams));
+        if (!streams)
+            return AVERROR(ENOMEM);
+        memset(streams + pt->nb_streams, 0,
+               (st->index + 1 - pt->nb_streams) * sizeof(*streams));
+        pt->streams    = streams;
+        pt->nb_streams = st->index + 1;
+    }
+    ps   = &pt->streams[st->index];
+    jobs = av_fast_realloc(ps->jobs, &ps->jobs_size,
+                           (ps->nb_jobs + 1) * sizeof(*ps->jobs));
+    if (!jobs)
+        return AVERROR(ENOMEM);
+    ps->jobs = jobs;
+    ps->jobs[ps->nb_jobs].pkt       = pkt;
+    ps->jobs[ps->nb_jobs].nb_frames = st->codec_info_nb_frames;
+    ps->nb_jobs++;
+
+    if (++pt->nb_jobs >= PROBE_BATCH_PER_THREAD * (pt->nb_threads + 1) ||
+        probe_threads_all_pending(pt))
+        probe_threads_flush(pt);
+    return 0;
+}
+
+static void probe_threads_uninit(ProbeThreads *pt)
+{
+    int i;
+
+    if (!pt->threads)
+        return;
+
+    pthread_mutex_lock(&pt->mutex);
+    pt->exit = 1;
+    pthread_cond_broadcast(&pt->work_cond);
+    pthread_mutex_unlock(&pt->mutex);
+    for (i = 0; i < pt->nb_threads; i++)
+        pthread_join(pt->threads[i], NULL);
+    pt->nb_threads = 0;
+
+    pthread_cond_destroy(&pt->done_cond);
+    pthread_cond_destroy(&pt->work_cond);
+    pthread_mutex_destroy(&pt->mutex);
+    for (i = 0; i < pt->nb_streams; i++)
+        av_freep(&pt->streams[i].jobs);
+    av_freep(&pt->streams);
+    av_freep(&pt->threads);
+}
+
+static void probe_threads_init(ProbeThreads *pt, AVFormatContext *ic,
+                               AVDictionary **options, int orig_nb_streams)
+{
+    int i, ret;
+
+    pt->ic              = ic;
+    pt->options         = options;
+    pt->orig_nb_streams = orig_nb_streams;
+
+    if (!(pt->threads = av_calloc(ic->probe_threads - 1, sizeof(*pt->threads))))
+        return;
+    if ((ret = pthread_mutex_init(&pt->mutex, NULL))) {
+        av_freep(&pt->threads);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&pt->work_cond, NULL))) {
+        pthread_mutex_destroy(&pt->mutex);
+        av_freep(&pt->threads);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&pt->done_cond, NULL))) {
+        pthread_cond_destroy(&pt->work_cond);
+        pthread_mutex_destroy(&pt->mutex);
+        av_freep(&pt->threads);
+        goto fail;
+    }
+
+    for (i = 0; i < ic->probe_threads - 1; i++) {
+        if ((ret = pthread_create(&pt->threads[i], NULL, probe_worker, pt))) {
+            av_log(ic, AV_LOG_WARNING, "pthread_create failed: %s\n",
+                   av_err2str(AVERROR(ret)));
+            break;
+        }
+        pt->nb_threads++;
+    }
+    /* without any worker, decode on the calling thread as usual */
+    if (!pt->nb_threads)
+        probe_threads_uninit(pt);
+    return;
+fail:
+    av_log(ic, AV_LOG_WARNING, "pthread init failed: %s\n",
+           av_err2str(AVERROR(ret)));
+}
+#endif
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
-    int i, count, ret = 0, j;
+    int i, count, ret = 0, j, err;
     int64_t read_size;
     AVStream *st;
     AVPacket pkt1, *pkt;
@@ -3092,6 +3496,9 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t max_stream_analyze_duration;
     int64_t max_subtitle_analyze_duration;
     int64_t probesize = ic->probesize2;
+#if HAVE_PTHREADS
+    ProbeThreads probe_threads = { 0 };
+#endif
 
     if (!max_analyze_duration)
         max_analyze_duration = ic->max_analyze_duration;
@@ -3178,6 +3585,11 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         ic->streams[i]->info->fps_last_dts  = AV_NOPTS_VALUE;
     }
 
+#if HAVE_PTHREADS
+    if (ic->probe_threads > 1 && !(ic->flags & AVFMT_FLAG_NOBUFFER))
+        probe_threads_init(&probe_threads, ic, options, orig_nb_streams);
+#endif
+
     count     = 0;
     read_size = 0;
     for (;;) {
@@ -3282,6 +3694,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         st = ic->streams[pkt->stream_index];
         if (!(st->disposition & AV_DISPOSITION_ATTACHED_PIC))
             read_size += pkt->size;
+        st->info->probe_bytes += pkt->size;
 
         if (pkt->dts != AV_NOPTS_VALUE && st->codec_info_nb_frames > 1) {
             /* check for non-increasing dts */
@@ -3361,8 +3774,10 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         if (st->parser && st->parser->parser->split && !st->codec->extradata) {
             int i = st->parser->parser->split(st->codec, pkt->data, pkt->size);
             if (i > 0 && i < FF_MAX_EXTRADATA_SIZE) {
-                if (ff_alloc_extradata(st->codec, i))
-                    return AVERROR(ENOMEM);
+                if (ff_alloc_extradata(st->codec, i)) {
+                    ret = AVERROR(ENOMEM);
+                    goto find_stream_info_err;
+                }
                 memcpy(st->codec->extradata, pkt->data,
                        st->codec->extradata_size);
             }
@@ -3377,8 +3792,18 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+#if HAVE_PTHREADS
+        if (probe_threads.nb_threads) {
+            if ((ret = probe_threads_add(&probe_threads, st, pkt)) < 0)
+                goto find_stream_info_err;
+        } else
+#endif
+        {
+            int64_t t = av_gettime_relative();
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
+            st->info->probe_decode_time += av_gettime_relative() - t;
+        }
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt);
@@ -3387,6 +3812,11 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         count++;
     }
 
+#if HAVE_PTHREADS
+    probe_threads_flush(&probe_threads);
+    probe_threads_uninit(&probe_threads);
+#endif
+
     if (flush_codecs) {
         AVPacket empty_pkt = { 0 };
         int err = 0;
@@ -3527,12 +3957,21 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     compute_chapters_end(ic);
 
 find_stream_info_err:
+    if ((err = flush_index_entries(ic)) < 0)
+        ret = err;
+#if HAVE_PTHREADS
+    probe_threads_uninit(&probe_threads);
+#endif
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (ic->streams[i]->codec->codec_type != AVMEDIA_TYPE_AUDIO)
             ic->streams[i]->codec->thread_count = 0;
-        if (st->info)
+        if (st->info) {
+            av_log(ic, AV_LOG_DEBUG, "Stream #%d: %d packets, %"PRId64" bytes "
+                   "probed, %"PRId64" us decoding\n", i, st->codec_info_nb_frames,
+                   st->info->probe_bytes, st->info->probe_decode_time);
             av_freep(&st->info->duration_error);
+        }
         av_freep(&ic->streams[i]->info);
     }
     if (ic->pb)
@@ -3660,6 +4099,7 @@ void ff_free_stream(AVFormatContext *s, AVStream *st) {
     av_dict_free(&st->metadata);
     av_freep(&st->probe_data.buf);
     av_freep(&st->index_entries);
+    av_freep(&st->pending_index_entries);
     av_freep(&st->codec->extradata);
     av_freep(&st->codec->subtitle_header);
     av_freep(&st->codec);
@@ -583,7 +583,7 @@ smv_out:
         size = (size / st->codec->block_align) * st->codec->block_align;
     }
     size = FFMIN(size, left);
-    ret  = av_get_packet(s->pb, pkt, size);
+    ret  = ff_get_packet_ref(s, s->pb, pkt, size);
     if (ret < 0)
         return ret;
     pkt->stream_index = 0;
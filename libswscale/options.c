@@ -78,6 +78,10 @@ static const AVOption swscale_options[] = {
     { "gamma",           "gamma correct scaling", OFFSET(gamma_flag),        AV_OPT_TYPE_INT,    { .i64  = 0                  }, 0,       INT_MAX,        VE, "gamma" },
     { "true",            "enable",                        0,                 AV_OPT_TYPE_CONST,  { .i64  = 1                  }, INT_MIN, INT_MAX,        VE, "gamma" },
     { "false",           "disable",                       0,                 AV_OPT_TYPE_CONST,  { .i64  = 0                  }, INT_MIN, INT_MAX,        VE, "gamma" },
+    { "threads",         "number of threads",             OFFSET(nb_threads), AV_OPT_TYPE_INT,   { .i64  = 1                  }, 0,       MAX_SLICE_CONTEXTS, VE, "threads" },
+    { "auto",            "automatic",                     0,                 AV_OPT_TYPE_CONST,  { .i64  = 0                  }, INT_MIN, INT_MAX,        VE, "threads" },
+    { "band_start",      "first destination line to output",                        OFFSET(band_start), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VE },
+    { "band_end",        "destination line following the last one to output, 0 for the last line", OFFSET(band_end), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VE },
 
     { NULL }
 };
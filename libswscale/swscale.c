@@ -324,6 +324,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     const int srcW                   = c->srcW;
     const int dstW                   = c->dstW;
     const int dstH                   = c->dstH;
+    const int bandEnd                = c->band_end ? c->band_end : dstH;
     const int chrDstW                = c->chrDstW;
     const int chrSrcW                = c->chrSrcW;
     const int lumXInc                = c->lumXInc;
@@ -429,7 +430,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     if (srcSliceY == 0) {
         lumBufIndex  = -1;
         chrBufIndex  = -1;
-        dstY         = 0;
+        dstY         = c->band_start;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
@@ -439,7 +440,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     }
     lastDstY = dstY;
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < bandEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         uint8_t *dest[4]  = {
             dst[0] + dstStride[0] * dstY,
@@ -766,6 +767,11 @@ SwsFunc ff_getSwsFunc(SwsContext *c)
     return swscale;
 }
 
+int ff_sws_is_band_scaler(SwsContext *c)
+{
+    return c->swscale == swscale;
+}
+
 static void reset_ptr(const uint8_t *src[], enum AVPixelFormat format)
 {
     if (!isALPHA(format))
@@ -1152,3 +1158,34 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     return ret;
 }
 
+
+static int scale_band(SwsContext *c, void *arg, int jobnr, int nb_jobs)
+{
+    AVFrame **frames = arg;
+    const AVFrame *src = frames[1];
+    AVFrame *dst = frames[0];
+
+    return sws_scale(c->slice_ctx[jobnr], (const uint8_t * const *)src->data,
+                     src->linesize, 0, c->srcH, dst->data, dst->linesize);
+}
+
+int attribute_align_arg sws_scale_frame(struct SwsContext *c, AVFrame *dst,
+                                        const AVFrame *src)
+{
+    AVFrame *frames[2] = { dst, (AVFrame *)src };
+    int rets[MAX_SLICE_CONTEXTS];
+    int i, ret = 0;
+
+    if (!c->nb_slice_ctx)
+        return sws_scale(c, (const uint8_t * const *)src->data, src->linesize,
+                         0, c->srcH, dst->data, dst->linesize);
+
+    ff_sws_thread_execute(c, scale_band, frames, rets, c->nb_slice_ctx);
+
+    for (i = 0; i < c->nb_slice_ctx; i++) {
+        if (rets[i] < 0)
+            return rets[i];
+        ret += rets[i];
+    }
+    return ret;
+}
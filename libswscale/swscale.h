@@ -30,6 +30,7 @@
 #include <stdint.h>
 
 #include "libavutil/avutil.h"
+#include "libavutil/frame.h"
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
 #include "version.h"
@@ -224,6 +225,23 @@ int sws_scale(struct SwsContext *c, const uint8_t *const srcSlice[],
               const int srcStride[], int srcSliceY, int srcSliceH,
               uint8_t *const dst[], const int dstStride[]);
 
+/**
+ * Scale the whole picture in src and put the result in dst.
+ *
+ * If the context was initialized with the "threads" option set to a value
+ * other than 1, the destination picture is split in horizontal bands which
+ * are scaled concurrently. The output is identical to the one of a single
+ * sws_scale() call on the whole picture.
+ *
+ * @param c   the scaling context previously created with
+ *            sws_getContext() or sws_init_context()
+ * @param dst the destination frame, its planes must be allocated for the
+ *            destination dimensions and format of c
+ * @param src the source frame, with the source dimensions and format of c
+ * @return    the height of the output picture or a negative AVERROR code
+ */
+int sws_scale_frame(struct SwsContext *c, AVFrame *dst, const AVFrame *src);
+
 /**
  * @param dstRange flag indicating the while-black range of the output (1=jpeg / 0=mpeg)
  * @param srcRange flag indicating the while-black range of the input (1=jpeg / 0=mpeg)
@@ -43,6 +43,9 @@
 
 #define MAX_FILTER_SIZE SWS_MAX_FILTER_SIZE
 
+#define MAX_SLICE_CONTEXTS 64
+#define MIN_BAND_HEIGHT    16
+
 #define DITHER1XBPP
 
 #if HAVE_BIGENDIAN
@@ -319,6 +322,17 @@ typedef struct SwsContext {
     uint16_t *gamma;
     uint16_t *inv_gamma;
 
+    /* The slice_* fields allow splitting the output picture into horizontal
+     * bands which are scaled concurrently by sws_scale_frame(). Each band is
+     * handled by its own context, so that it has its own line ring buffers.
+     */
+    int nb_threads;               ///< Number of threads requested by the user, 0 for automatic.
+    struct SwsContext **slice_ctx;
+    int nb_slice_ctx;
+    void *thread;                 ///< Worker pool running the bands, see pthread.c.
+    int band_start;               ///< First destination line output by this context.
+    int band_end;                 ///< Destination line following the last one output by this context, 0 for dstH.
+
     uint32_t pal_yuv[256];
     uint32_t pal_rgb[256];
 
@@ -863,6 +877,30 @@ void ff_get_unscaled_swscale_arm(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+/**
+ * Return 1 if the scaler of c is the generic vertical scaler loop, which
+ * can output any band of destination lines independently.
+ */
+int ff_sws_is_band_scaler(SwsContext *c);
+
+typedef int (sws_action_func)(SwsContext *c, void *arg, int jobnr, int nb_jobs);
+
+/**
+ * Start nb_threads worker threads for c.
+ *
+ * @return the number of threads started, 1 if no threads are available
+ *         or a negative AVERROR code
+ */
+int ff_sws_thread_init(SwsContext *c, int nb_threads);
+void ff_sws_thread_free(SwsContext *c);
+
+/**
+ * Run func nb_jobs times on the worker threads of c and wait for all jobs
+ * to finish. The return value of job i is stored in rets[i].
+ */
+void ff_sws_thread_execute(SwsContext *c, sws_action_func *func, void *arg,
+                           int *rets, int nb_jobs);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
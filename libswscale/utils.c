@@ -829,7 +829,12 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
 {
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
-    int need_reinit = 0;
+    int i, need_reinit = 0;
+
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange, table,
+                                 dstRange, brightness, contrast, saturation);
+
     memmove(c->srcColorspaceTable, inv_table, sizeof(int) * 4);
     memmove(c->dstColorspaceTable, table, sizeof(int) * 4);
 
@@ -979,8 +984,8 @@ static uint16_t * alloc_gamma_tbl(double e)
     return tbl;
 }
 
-av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
-                             SwsFilter *dstFilter)
+static av_cold int context_init(SwsContext *c, SwsFilter *srcFilter,
+                                SwsFilter *dstFilter)
 {
     int i, j;
     int usesVFilter, usesHFilter;
@@ -1632,6 +1637,135 @@ fail: // FIXME replace things by appropriate error codes
     return -1;
 }
 
+#if !HAVE_THREADS
+int ff_sws_thread_init(SwsContext *c, int nb_threads)
+{
+    return 1;
+}
+
+void ff_sws_thread_free(SwsContext *c)
+{
+}
+
+void ff_sws_thread_execute(SwsContext *c, sws_action_func *func, void *arg,
+                           int *rets, int nb_jobs)
+{
+    int i;
+
+    for (i = 0; i < nb_jobs; i++)
+        rets[i] = func(c, arg, i, nb_jobs);
+}
+#endif
+
+/**
+ * Every band is scaled from the whole source picture by a context of its
+ * own, which only works if no state is carried from one output line to
+ * the next one and the source is not modified in place.
+ */
+static int supports_bands(SwsContext *c)
+{
+    return ff_sws_is_band_scaler(c) && !c->cascaded_context[0] &&
+           !c->is_internal_gamma && c->dither != SWS_DITHER_ED &&
+           !c->srcXYZ && !c->dstXYZ;
+}
+
+static av_cold int init_slice_contexts(SwsContext *c, SwsContext *tmpl,
+                                       SwsFilter *srcFilter,
+                                       SwsFilter *dstFilter)
+{
+    int *inv_table, *table, srcRange, dstRange, brightness, contrast, saturation;
+    int i, ret, nb_bands;
+    int align = 1 << c->chrDstVSubSample;
+
+    if (!supports_bands(c) || c->band_start || c->band_end)
+        return 0;
+
+    nb_bands = c->nb_threads ? c->nb_threads : av_cpu_count();
+    nb_bands = FFMIN3(nb_bands, MAX_SLICE_CONTEXTS, c->dstH / MIN_BAND_HEIGHT);
+    if (nb_bands <= 1)
+        return 0;
+
+    ret = ff_sws_thread_init(c, nb_bands);
+    if (ret <= 1)
+        return FFMIN(ret, 0);
+
+    c->slice_ctx = av_mallocz_array(nb_bands, sizeof(*c->slice_ctx));
+    if (!c->slice_ctx)
+        return AVERROR(ENOMEM);
+
+    sws_getColorspaceDetails(c, &inv_table, &srcRange, &table, &dstRange,
+                             &brightness, &contrast, &saturation);
+
+    for (i = 0; i < nb_bands; i++) {
+        SwsContext *s = sws_alloc_context();
+        if (!s)
+            return AVERROR(ENOMEM);
+        c->slice_ctx[c->nb_slice_ctx++] = s;
+
+        ret = av_opt_copy(s, tmpl);
+        if (ret < 0)
+            return ret;
+        s->nb_threads = 1;
+        s->band_start = ((int64_t)c->dstH *  i      / nb_bands) & ~(align - 1);
+        s->band_end   = ((int64_t)c->dstH * (i + 1) / nb_bands) & ~(align - 1);
+        if (i == nb_bands - 1)
+            s->band_end = 0;
+
+        ret = context_init(s, srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+        sws_setColorspaceDetails(s, inv_table, srcRange, table, dstRange,
+                                 brightness, contrast, saturation);
+    }
+
+    return 0;
+}
+
+av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
+                             SwsFilter *dstFilter)
+{
+    SwsContext *tmpl = NULL;
+    int ret;
+
+    /* context_init() adjusts some of the user settings, keep a copy of them
+     * for setting up the band contexts */
+    if (c->nb_threads != 1) {
+        tmpl = sws_alloc_context();
+        if (!tmpl)
+            return AVERROR(ENOMEM);
+        ret = av_opt_copy(tmpl, c);
+        if (ret < 0)
+            goto end;
+    }
+
+    ret = context_init(c, srcFilter, dstFilter);
+    if (ret < 0)
+        goto end;
+
+    if (c->band_start || c->band_end) {
+        int align = 1 << c->chrDstVSubSample;
+
+        if (c->band_start & (align - 1) || c->band_end & (align - 1) ||
+            c->band_start >= c->dstH || c->band_end > c->dstH ||
+            (c->band_end && c->band_end <= c->band_start)) {
+            av_log(c, AV_LOG_ERROR, "Invalid destination band %d-%d\n",
+                   c->band_start, c->band_end);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        /* the whole picture is output by scalers not supporting bands */
+        if (!supports_bands(c))
+            c->band_start = c->band_end = 0;
+    }
+
+    if (tmpl)
+        ret = init_slice_contexts(c, tmpl, srcFilter, dstFilter);
+
+end:
+    sws_freeContext(tmpl);
+    return ret;
+}
+
 SwsContext *sws_getContext(int srcW, int srcH, enum AVPixelFormat srcFormat,
                            int dstW, int dstH, enum AVPixelFormat dstFormat,
                            int flags, SwsFilter *srcFilter,
@@ -2035,6 +2169,11 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
+    ff_sws_thread_free(c);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+
     if (c->lumPixBuf) {
         for (i = 0; i < c->vLumBufSize; i++)
             av_freep(&c->lumPixBuf[i]);
@@ -2119,6 +2258,7 @@ struct SwsContext *sws_getCachedContext(struct SwsContext *context, int srcW,
                                              SWS_PARAM_DEFAULT };
     int64_t src_h_chr_pos = -513, dst_h_chr_pos = -513,
             src_v_chr_pos = -513, dst_v_chr_pos = -513;
+    int64_t nb_threads = 1;
 
     if (!param)
         param = default_param;
@@ -2138,6 +2278,7 @@ struct SwsContext *sws_getCachedContext(struct SwsContext *context, int srcW,
         av_opt_get_int(context, "src_v_chr_pos", 0, &src_v_chr_pos);
         av_opt_get_int(context, "dst_h_chr_pos", 0, &dst_h_chr_pos);
         av_opt_get_int(context, "dst_v_chr_pos", 0, &dst_v_chr_pos);
+        av_opt_get_int(context, "threads",       0, &nb_threads);
         sws_freeContext(context);
         context = NULL;
     }
@@ -2159,6 +2300,7 @@ struct SwsContext *sws_getCachedContext(struct SwsContext *context, int srcW,
         av_opt_set_int(context, "src_v_chr_pos", src_v_chr_pos, 0);
         av_opt_set_int(context, "dst_h_chr_pos", dst_h_chr_pos, 0);
         av_opt_set_int(context, "dst_v_chr_pos", dst_v_chr_pos, 0);
+        av_opt_set_int(context, "threads",       nb_threads,    0);
 
         if (sws_init_context(context, srcFilter, dstFilter) < 0) {
             sws_freeContext(context);
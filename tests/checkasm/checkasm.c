@@ -69,6 +69,9 @@ static const struct {
 #endif
 #if CONFIG_H264QPEL
     { "h264qpel", checkasm_check_h264qpel },
+#endif
+#if CONFIG_OVERLAY_FILTER
+    { "vf_overlay", checkasm_check_vf_overlay },
 #endif
     { NULL }
 };
@@ -0,0 +1,130 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/overlay.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+
+#define WIDTH 256
+
+/* alpha values of 0 and 255 take their own paths in the C code */
+static uint8_t rnd_alpha(void)
+{
+    uint32_t r = rnd();
+
+    switch (r & 7) {
+    case 0:  return 0;
+    case 1:  return 255;
+    default: return r >> 8;
+    }
+}
+
+#define randomize_buffers(buf0, buf1, size)         \
+    do {                                            \
+        int i;                                      \
+        for (i = 0; i < size; i++)                  \
+            buf0[i] = buf1[i] = rnd();              \
+    } while (0)
+
+#define randomize_buffer(buf, size)                 \
+    do {                                            \
+        int i;                                      \
+        for (i = 0; i < size; i++)                  \
+            buf[i] = rnd();                         \
+    } while (0)
+
+static void check_blend_row(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, dst0, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, src,  [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, a,    [WIDTH * 4]);
+    OverlayDSPContext dsp;
+    int i, w;
+
+    ff_overlay_init(&dsp, -1);
+
+    if (check_func(dsp.blend_row, "blend_row")) {
+        for (w = OVERLAY_DSP_BLOCK; w <= WIDTH; w += OVERLAY_DSP_BLOCK) {
+            randomize_buffers(dst0, dst1, WIDTH);
+            randomize_buffer(src, WIDTH);
+            for (i = 0; i < WIDTH; i++)
+                a[i] = rnd_alpha();
+            call_ref(dst0, src, a, w);
+            call_new(dst1, src, a, w);
+            if (memcmp(dst0, dst1, WIDTH))
+                fail();
+        }
+        bench_new(dst1, src, a, WIDTH);
+    }
+
+    if (check_func(dsp.blend_row_420, "blend_row_420")) {
+        for (w = OVERLAY_DSP_BLOCK; w <= WIDTH; w += OVERLAY_DSP_BLOCK) {
+            randomize_buffers(dst0, dst1, WIDTH);
+            randomize_buffer(src, WIDTH);
+            for (i = 0; i < WIDTH * 4; i++)
+                a[i] = rnd_alpha();
+            call_ref(dst0, src, a, (ptrdiff_t)WIDTH * 2, w);
+            call_new(dst1, src, a, (ptrdiff_t)WIDTH * 2, w);
+            if (memcmp(dst0, dst1, WIDTH))
+                fail();
+        }
+        bench_new(dst1, src, a, (ptrdiff_t)WIDTH * 2, WIDTH);
+    }
+
+    report("blend_row");
+}
+
+static void check_blend_row_rgba(int alpha_pos)
+{
+    LOCAL_ALIGNED_32(uint8_t, dst0, [WIDTH * 4]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [WIDTH * 4]);
+    LOCAL_ALIGNED_32(uint8_t, src,  [WIDTH * 4]);
+    OverlayDSPContext dsp;
+    int i, w;
+
+    ff_overlay_init(&dsp, alpha_pos);
+
+    if (check_func(dsp.blend_row_rgba, "blend_row_rgba_a%d", alpha_pos)) {
+        for (w = OVERLAY_DSP_BLOCK; w <= WIDTH; w += OVERLAY_DSP_BLOCK) {
+            randomize_buffers(dst0, dst1, WIDTH * 4);
+            randomize_buffer(src, WIDTH * 4);
+            for (i = 0; i < WIDTH; i++) {
+                src[4 * i + alpha_pos]  = rnd_alpha();
+                dst0[4 * i + alpha_pos] =
+                dst1[4 * i + alpha_pos] = rnd_alpha();
+            }
+            call_ref(dst0, src, w);
+            call_new(dst1, src, w);
+            if (memcmp(dst0, dst1, WIDTH * 4))
+                fail();
+        }
+        bench_new(dst1, src, WIDTH);
+    }
+}
+
+void checkasm_check_vf_overlay(void)
+{
+    check_blend_row();
+
+    check_blend_row_rgba(0);
+    check_blend_row_rgba(3);
+    report("blend_row_rgba");
+}
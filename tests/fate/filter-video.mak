@@ -102,6 +102,11 @@ fate-filter-gradfun: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf gradfun
 FATE_FILTER_VSYNTH-$(CONFIG_HQDN3D_FILTER) += fate-filter-hqdn3d
 fate-filter-hqdn3d: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf hqdn3d
 
+# planes of at least 512 lines, where bands=1 splits them
+FATE_FILTER_VSYNTH-$(call ALLYES, TILE_FILTER HQDN3D_FILTER) += fate-filter-hqdn3d-tall fate-filter-hqdn3d-bands
+fate-filter-hqdn3d-tall: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf tile=1x2,hqdn3d
+fate-filter-hqdn3d-bands: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf tile=1x2,hqdn3d=bands=1
+
 FATE_FILTER_VSYNTH-$(CONFIG_INTERLACE_FILTER) += fate-filter-interlace
 fate-filter-interlace: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf interlace
 
@@ -2,6 +2,10 @@ FATE_LIBAVFORMAT-$(HAVE_PTHREADS) += fate-async
 fate-async: libavformat/async-test$(EXESUF)
 fate-async: CMD = run libavformat/async-test
 
+FATE_LIBAVFORMAT-yes += fate-index
+fate-index: libavformat/index-test$(EXESUF)
+fate-index: CMD = run libavformat/index-test
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/noproxy-test$(EXESUF)
 fate-noproxy: CMD = run libavformat/noproxy-test
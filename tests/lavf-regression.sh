@@ -121,6 +121,8 @@ fi
 if [ -n "$do_mov" ] ; then
 mov_common_opt="-acodec pcm_alaw -vcodec mpeg4 -threads 1"
 do_lavf mov "" "-movflags +rtphint $mov_common_opt"
+# the moov atom leaves 4 bytes of the reserved space, too few for a free atom
+do_lavf mov "" "-movflags +faststart -moov_size 1735 $mov_common_opt"
 do_lavf_timecode mov "-movflags +faststart $mov_common_opt"
 fi
 
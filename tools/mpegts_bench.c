@@ -0,0 +1,320 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Benchmark of the MPEG-TS demuxer on a synthetic multi-program transport
+ * stream, built with:
+ * make tools/mpegts_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavformat/avformat.h"
+#include "libavutil/avassert.h"
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#define TS_PACKET_SIZE 188
+#define PES_SIZE       (32 * 1024)
+
+typedef struct Stream {
+    int pid;
+    int cc;
+    int64_t pts;
+} Stream;
+
+typedef struct Buffer {
+    uint8_t *data;
+    size_t size, pos;
+} Buffer;
+
+static uint8_t *put_packet(uint8_t *p, int pid, int is_start, int *cc)
+{
+    p[0] = 0x47;
+    p[1] = (is_start ? 0x40 : 0) | pid >> 8;
+    p[2] = pid;
+    p[3] = 0x10 | *cc;
+    *cc = (*cc + 1) & 15;
+    return p + 4;
+}
+
+static uint8_t *put_section(uint8_t *p, int pid, int *cc,
+                            const uint8_t *section, int len)
+{
+    uint8_t *q = put_packet(p, pid, 1, cc);
+
+    av_assert0(len + 5 <= TS_PACKET_SIZE);
+    *q++ = 0; /* pointer field */
+    memcpy(q, section, len);
+    memset(q + len, 0xff, TS_PACKET_SIZE - 5 - len);
+    return p + TS_PACKET_SIZE;
+}
+
+static int finish_section(uint8_t *section, int len)
+{
+    AV_WB16(section + 1, 0xb000 | (len + 4 - 3));
+    AV_WL32(section + len, av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, section, len));
+    return len + 4;
+}
+
+static uint8_t *put_pat(uint8_t *p, int nb_programs, int *cc)
+{
+    uint8_t section[1024], *q = section;
+    int i;
+
+    *q++ = 0x00;                /* table_id */
+    q   += 2;                   /* section_length */
+    AV_WB16(q, 1); q += 2;      /* transport_stream_id */
+    *q++ = 0xc1;
+    *q++ = 0;
+    *q++ = 0;
+    for (i = 0; i < nb_programs; i++) {
+        AV_WB16(q, i + 1);            q += 2;
+        AV_WB16(q, 0xe000 | (0x100 + i)); q += 2;
+    }
+    return put_section(p, 0, cc, section, finish_section(section, q - section));
+}
+
+static uint8_t *put_pmt(uint8_t *p, int program, const Stream *st, int *cc)
+{
+    static const uint8_t stream_types[2] = { 0x1b, 0x0f }; /* H.264, AAC */
+    uint8_t section[1024], *q = section;
+    int i;
+
+    *q++ = 0x02;
+    q   += 2;
+    AV_WB16(q, program + 1); q += 2;
+    *q++ = 0xc1;
+    *q++ = 0;
+    *q++ = 0;
+    AV_WB16(q, 0xe000 | st[0].pid); q += 2; /* PCR PID */
+    AV_WB16(q, 0xf000);             q += 2;
+    for (i = 0; i < 2; i++) {
+        *q++ = stream_types[i];
+        AV_WB16(q, 0xe000 | st[i].pid); q += 2;
+        AV_WB16(q, 0xf000);             q += 2;
+    }
+    return put_section(p, 0x100 + program, cc, section,
+                       finish_section(section, q - section));
+}
+
+static uint8_t *put_pes(uint8_t *p, Stream *st, int stream_id)
+{
+    int left = PES_SIZE, first = 1;
+
+    while (left > 0) {
+        uint8_t *q = put_packet(p, st->pid, first, &st->cc);
+        uint8_t *end = p + TS_PACKET_SIZE;
+
+        if (first) {
+            int64_t pts = st->pts;
+            q[0] = 0; q[1] = 0; q[2] = 1; q[3] = stream_id;
+            AV_WB16(q + 4, 0);
+            q[6] = 0x80; q[7] = 0x80; q[8] = 5;
+            q[9]  = 0x21 | ((pts >> 29) & 0x0e);
+            AV_WB16(q + 10, (((pts >> 15) & 0x7fff) << 1) | 1);
+            AV_WB16(q + 12, ((pts & 0x7fff) << 1) | 1);
+            q += 14;
+            st->pts += 3600;
+            first = 0;
+        }
+        if (end - q > left) {
+            /* stuff the last packet with an adaptation field */
+            int stuffing = end - q - left;
+            memmove(p + 4 + stuffing, p + 4, q - p - 4);
+            p[3] |= 0x20;
+            p[4] = stuffing - 1;
+            if (stuffing > 1) {
+                p[5] = 0;
+                memset(p + 6, 0xff, stuffing - 2);
+            }
+            q += stuffing;
+        }
+        left -= end - q;
+        memset(q, 0, end - q);
+        p = end;
+    }
+    return p;
+}
+
+static int make_stream(Buffer *buf, int nb_programs, size_t size)
+{
+    Stream *st = av_calloc(nb_programs * 2, sizeof(*st));
+    int *pmt_cc = av_calloc(nb_programs, sizeof(*pmt_cc));
+    int pat_cc = 0, i;
+    uint8_t *p, *end;
+
+    /* room for one more round of PES packets beyond size */
+    buf->size = size + (nb_programs * 2 * (PES_SIZE / 150 + 2) + nb_programs + 1) * TS_PACKET_SIZE;
+    buf->data = av_malloc(buf->size);
+    if (!st || !pmt_cc || !buf->data)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_programs * 2; i++)
+        st[i].pid = 0x200 + i;
+
+    p   = buf->data;
+    end = buf->data + size;
+    while (p < end) {
+        p = put_pat(p, nb_programs, &pat_cc);
+        for (i = 0; i < nb_programs; i++)
+            p = put_pmt(p, i, &st[2 * i], &pmt_cc[i]);
+        for (i = 0; i < nb_programs; i++) {
+            p = put_pes(p, &st[2 * i],     0xe0);
+            p = put_pes(p, &st[2 * i + 1], 0xc0);
+        }
+    }
+    buf->size = p - buf->data;
+
+    av_free(st);
+    av_free(pmt_cc);
+    return 0;
+}
+
+static int read_buffer(void *opaque, uint8_t *dst, int size)
+{
+    Buffer *buf = opaque;
+
+    size = FFMIN(size, buf->size - buf->pos);
+    if (!size)
+        return AVERROR_EOF;
+    memcpy(dst, buf->data + buf->pos, size);
+    buf->pos += size;
+    return size;
+}
+
+static int64_t seek_buffer(void *opaque, int64_t offset, int whence)
+{
+    Buffer *buf = opaque;
+
+    if (whence == AVSEEK_SIZE)
+        return buf->size;
+    if (whence == SEEK_CUR)
+        offset += buf->pos;
+    else if (whence == SEEK_END)
+        offset += buf->size;
+    if (offset < 0 || offset > buf->size)
+        return AVERROR(EINVAL);
+    buf->pos = offset;
+    return offset;
+}
+
+static int run(Buffer *buf, int keep_program, int64_t *packets, int64_t *bytes,
+               int64_t *time)
+{
+    AVFormatContext *s = avformat_alloc_context();
+    AVIOContext *pb;
+    uint8_t *iobuf = av_malloc(32768);
+    AVPacket pkt;
+    int i, ret;
+
+    if (!s || !iobuf)
+        return AVERROR(ENOMEM);
+    buf->pos = 0;
+    pb = avio_alloc_context(iobuf, 32768, 0, buf, read_buffer, NULL, seek_buffer);
+    if (!pb)
+        return AVERROR(ENOMEM);
+    s->pb     = pb;
+    s->flags |= AVFMT_FLAG_NOPARSE | AVFMT_FLAG_NOFILLIN;
+
+    ret = avformat_open_input(&s, NULL, av_find_input_format("mpegts"), NULL);
+    if (ret < 0)
+        return ret;
+
+    /* the payload is not decodable, so the codec parameters stay
+     * incomplete; only the programs and streams are of interest here */
+    avformat_find_stream_info(s, NULL);
+
+    if (keep_program > 0) {
+        for (i = 0; i < s->nb_programs; i++)
+            if (s->programs[i]->id != keep_program)
+                s->programs[i]->discard = AVDISCARD_ALL;
+        for (i = 0; i < s->nb_streams; i++)
+            s->streams[i]->discard = AVDISCARD_ALL;
+        for (i = 0; i < s->nb_programs; i++) {
+            AVProgram *prg = s->programs[i];
+            int j;
+            if (prg->id != keep_program)
+                continue;
+            for (j = 0; j < prg->nb_stream_indexes; j++)
+                s->streams[prg->stream_index[j]]->discard = AVDISCARD_DEFAULT;
+        }
+    }
+
+    *packets = *bytes = 0;
+    *time = av_gettime_relative();
+    av_init_packet(&pkt);
+    while ((ret = av_read_frame(s, &pkt)) >= 0) {
+        (*packets)++;
+        *bytes += pkt.size;
+        av_free_packet(&pkt);
+    }
+    *time = av_gettime_relative() - *time;
+
+    avformat_close_input(&s);
+    av_freep(&pb->buffer);
+    av_freep(&pb);
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_programs = 16, keep_program = 0, runs = 3, i, ret;
+    size_t size = 256 << 20;
+    Buffer buf = { 0 };
+
+    if (argc > 1 && !strcmp(argv[1], "-h")) {
+        printf("usage: %s [programs [keep_program [MiB [runs]]]]\n"
+               "Demux a synthetic transport stream with the given number of\n"
+               "programs (default %d), each carrying an H.264 and an AAC\n"
+               "stream. If keep_program is not 0, all other programs are\n"
+               "discarded.\n", argv[0], nb_programs);
+        return 0;
+    }
+    if (argc > 1) nb_programs  = av_clip(atoi(argv[1]), 1, 40);
+    if (argc > 2) keep_program = atoi(argv[2]);
+    if (argc > 3) size         = (size_t)FFMAX(atoi(argv[3]), 1) << 20;
+    if (argc > 4) runs         = FFMAX(atoi(argv[4]), 1);
+
+    av_register_all();
+    av_log_set_level(AV_LOG_QUIET);
+
+    if ((ret = make_stream(&buf, nb_programs, size)) < 0) {
+        fprintf(stderr, "Could not create the stream\n");
+        return 1;
+    }
+
+    for (i = 0; i < runs; i++) {
+        int64_t packets, bytes, t;
+
+        if ((ret = run(&buf, keep_program, &packets, &bytes, &t)) < 0) {
+            fprintf(stderr, "Demuxing failed: %s\n", av_err2str(ret));
+            return 1;
+        }
+        printf("%d programs, keep %d: %"PRId64" packets, %"PRId64" payload bytes, "
+               "%.1f MB/s\n", nb_programs, keep_program, packets, bytes,
+               buf.size / (double)FFMAX(t, 1));
+    }
+
+    av_free(buf.data);
+    return 0;
+}